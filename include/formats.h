@@ -12,6 +12,25 @@
  * - BMP (24-bit uncompressed)
  * - PNG (lossless)
  * - JPEG (lossy, with careful handling)
+ *
+ * Every handler works both on FILE streams and on images already in
+ * memory. The buffer entry points never touch the filesystem: BMP runs
+ * on the in-memory pixel engine, PNG and JPEG run their stream code
+ * over the caller's buffers. Together with the core they are built as
+ * libsteg.a and libsteg.so ("make lib").
+ *
+ * Formats are identified by content: the first FORMAT_SNIFF_SIZE bytes
+ * are read once and every handler's sniff function looks at them, so
+ * stdin and files without a telling extension work too. The extension
+ * is only a fallback for naming an unsupported file.
+ *
+ * Handlers live in a registry built on first use: the built-in BMP,
+ * PNG and JPEG handlers, then those of the plugins listed in
+ * FORMAT_PLUGIN_ENV. A hash table maps each extension to its handler
+ * and handlers are bucketed by the first byte of their magic, so a
+ * lookup costs the same however many formats are registered. Further
+ * handlers can be registered, or loaded from shared objects, at
+ * startup before other threads look formats up.
  */
 
 #ifndef FORMATS_H
@@ -21,17 +40,54 @@
 #include <stdint.h>
 #include <stddef.h>
 
+/** @brief Bytes read from the start of an image to identify its format */
+#define FORMAT_SNIFF_SIZE 64
+
+/** @brief Longest extension the registry indexes, dot included */
+#define FORMAT_MAX_EXTENSION 15
+
+/** @brief Symbol a format plugin exports (a format_plugin_func) */
+#define FORMAT_PLUGIN_ENTRY "steg_format_plugin"
+
+/** @brief Plugin interface version passed to FORMAT_PLUGIN_ENTRY */
+#define FORMAT_PLUGIN_VERSION 1
+
+/** @brief Environment variable with a colon-separated list of plugins to load */
+#define FORMAT_PLUGIN_ENV "STEG_FORMAT_PLUGINS"
+
 // Format handler function pointer types
 typedef int (*format_validate_func)(FILE* file);
 typedef long (*format_get_capacity_func)(FILE* file);
 typedef int (*format_embed_func)(FILE* input, FILE* output, const char* message);
 typedef int (*format_extract_func)(FILE* input, char* message, size_t max_len);
 
+// Recognise the format from the first bytes of a file (up to FORMAT_SNIFF_SIZE)
+typedef int (*format_sniff_func)(const unsigned char* prefix, size_t length);
+
+// Buffer counterparts: the image is the complete file contents in memory
+typedef int (*format_validate_buffer_func)(const unsigned char* image, size_t image_size);
+typedef long (*format_get_capacity_buffer_func)(const unsigned char* image, size_t image_size);
+typedef int (*format_embed_buffer_func)(const unsigned char* image, size_t image_size, const char* message,
+                                        unsigned char* output, size_t output_capacity, size_t* output_size);
+typedef int (*format_extract_buffer_func)(const unsigned char* image, size_t image_size, char* message,
+                                          size_t max_len);
+
 /**
  * @brief Format handler structure
  * 
  * Defines the interface for image format handlers.
  * Each supported format must implement these functions.
+ *
+ * embed_buffer writes the stego image to a caller-provided buffer,
+ * which may be the image itself for an in-place embed. The output is
+ * never larger than the input, so image_size bytes always suffice;
+ * output_size receives the bytes written. extract_buffer fills a
+ * caller-provided, NUL-terminated message buffer.
+ *
+ * sniff checks the same header fields validate does, so an image it
+ * accepts needs no further validate call. magic, when set, is the
+ * fixed signature every image of the format starts with; sniff is
+ * then only asked about prefixes that begin with it.
  */
 typedef struct {
     const char* name;                    ///< Format name (e.g., "BMP", "PNG", "JPEG")
@@ -40,13 +96,115 @@ typedef struct {
     format_get_capacity_func get_capacity; ///< Calculate message capacity
     format_embed_func embed;             ///< Embed message in image
     format_extract_func extract;         ///< Extract message from image
+    format_validate_buffer_func validate_buffer;       ///< Validate an image in memory
+    format_get_capacity_buffer_func get_capacity_buffer; ///< Capacity of an image in memory (-1 if invalid)
+    format_embed_buffer_func embed_buffer;             ///< Embed into a caller-provided buffer
+    format_extract_buffer_func extract_buffer;         ///< Extract into a caller-provided buffer
+    format_sniff_func sniff;                           ///< Recognise and validate the first bytes
+    const unsigned char* magic;                        ///< Leading signature bytes (may be NULL)
+    size_t magic_length;                               ///< Length of magic (at most FORMAT_SNIFF_SIZE)
 } format_handler_t;
 
+/**
+ * @brief Entry point of a format plugin
+ *
+ * @param version FORMAT_PLUGIN_VERSION of the loading program
+ * @return NULL-terminated array of handlers that stay valid for the
+ *         life of the process, or NULL if the plugin was built for
+ *         another version
+ */
+typedef format_handler_t** (*format_plugin_func)(int version);
+
 // Format handler functions
 format_handler_t* get_format_handler(const char* filename);
 const char* get_supported_formats(void);
 int is_format_supported(const char* filename);
 
+/**
+ * @brief Add a handler to the registry
+ *
+ * @param handler Handler with every FILE and buffer function set; it
+ *        must stay valid for the life of the process
+ * @return STEG_SUCCESS, STEG_INVALID_ARGUMENT if a function is missing
+ *         or a handler of that name is registered, or STEG_MEMORY_ERROR
+ *
+ * Extensions a registered handler already claims stay with it.
+ * Registration may run while other threads look formats up: they keep
+ * seeing the handlers registered before it until it completes.
+ */
+int register_format_handler(format_handler_t* handler);
+
+/**
+ * @brief Load a shared object and register the handlers it provides
+ *
+ * @param path Path of the plugin, as given to dlopen()
+ * @return STEG_SUCCESS, STEG_FILE_ERROR if it cannot be loaded, or
+ *         STEG_INVALID_ARGUMENT if it has no FORMAT_PLUGIN_ENTRY, was
+ *         built for another version or a handler is rejected
+ *
+ * The plugin's handlers are added together or not at all; a plugin that
+ * was added stays loaded for the life of the process.
+ */
+int load_format_plugin(const char* path);
+
+/**
+ * @brief Identify the format of an image from its first bytes
+ *
+ * @param prefix Start of the image
+ * @param length Bytes available at prefix (FORMAT_SNIFF_SIZE is enough)
+ * @return Handler whose signature and header checks match, or NULL
+ */
+format_handler_t* sniff_format_handler(const unsigned char* prefix, size_t length);
+
+/**
+ * @brief Identify the format of an open image stream
+ *
+ * @param file Seekable stream; its first FORMAT_SNIFF_SIZE bytes are
+ *        read once and the stream is rewound
+ * @return Handler of the image, or NULL if no signature matches
+ */
+format_handler_t* probe_format_handler(FILE* file);
+
+/**
+ * @brief Identify the format of an image file by content
+ *
+ * @param filename Image path
+ * @param sniffed Receives 1 if the content identified the handler and
+ *        its sniff function validated it, 0 if only its magic matched
+ *        or it fell back to the extension (may be NULL)
+ * @return Handler of the image, or NULL if neither the content nor the
+ *         extension is supported
+ */
+format_handler_t* detect_format_handler(const char* filename, int* sniffed);
+
+/**
+ * @brief Embed a message into an in-memory image, allocating the output
+ *
+ * @param handler Handler of the image's format
+ * @param image Complete image file contents
+ * @param image_size Size of the image in bytes
+ * @param message Text message to embed
+ * @param output Receives the stego image (malloc'd, freed by the caller)
+ * @param output_size Receives the size of the stego image
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int format_embed_alloc(const format_handler_t* handler, const unsigned char* image, size_t image_size,
+                       const char* message, unsigned char** output, size_t* output_size);
+
+/**
+ * @brief Extract a message from an in-memory image, allocating the result
+ *
+ * @param handler Handler of the image's format
+ * @param image Complete image file contents
+ * @param image_size Size of the image in bytes
+ * @param message Receives the NUL-terminated message (malloc'd, freed by
+ *        the caller)
+ * @param length Receives the message length, without the NUL
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int format_extract_alloc(const format_handler_t* handler, const unsigned char* image, size_t image_size,
+                         char** message, size_t* length);
+
 // Individual format handlers
 extern format_handler_t bmp_handler;
 extern format_handler_t png_handler;
@@ -8,8 +8,16 @@
  * This header file contains all declarations, constants, and structures
  * for the LSB (Least Significant Bit) steganography tool.
  * 
- * The tool supports hiding and extracting ASCII text messages in 24-bit BMP images
- * by modifying the least significant bit of each pixel byte.
+ * The tool supports hiding and extracting ASCII text messages in 24-bit and
+ * 32-bit BMP images by modifying the least significant bit of each colour
+ * channel byte. The alpha (or unused) byte of 32-bit pixels is never touched.
+ * 
+ * The engine settings (block size, bits per channel, threads, pipeline
+ * depth and the I/O backend in steg_io.h) are process-wide. Set them
+ * before other threads call into the library: each call reads them as
+ * it starts, and changing one while another thread is mid-call is a
+ * data race. A steg_ctx_t copies them when it is created, so threads
+ * that need different settings should each use their own context.
  */
 
 #ifndef STEG_H
@@ -27,12 +35,57 @@
 /** @brief Size of BMP file header in bytes */
 #define BMP_HEADER_SIZE 54
 
-/** @brief Maximum length of message that can be embedded/extracted */
-#define MAX_MESSAGE_LENGTH 4096
+/** @brief Smallest BITMAPINFOHEADER size; V4 (108) and V5 (124) extend it */
+#define BMP_INFO_HEADER_SIZE 40
+
+/** @brief Header bytes needed to parse the layout: headers plus R, G, B and A masks */
+#define BMP_LAYOUT_HEADER_SIZE 70
+
+/** @brief Uncompressed pixels (BI_RGB) */
+#define BMP_BI_RGB 0
+
+/** @brief Uncompressed pixels with explicit channel masks (BI_BITFIELDS) */
+#define BMP_BI_BITFIELDS 3
 
 /** @brief BMP file signature ("BM" in little-endian) */
 #define BMP_SIGNATURE 0x4D42
 
+/** @brief Default block size for buffered pixel I/O (1 MiB) */
+#define STEG_DEFAULT_BLOCK_SIZE (1024 * 1024)
+
+/** @brief Smallest accepted block size for buffered pixel I/O */
+#define STEG_MIN_BLOCK_SIZE 64
+
+/** @brief Largest accepted block size for buffered pixel I/O (256 MiB) */
+#define STEG_MAX_BLOCK_SIZE (256 * 1024 * 1024)
+
+/** @brief Largest accepted thread count for pixel work */
+#define STEG_MAX_THREADS 256
+
+/** @brief Default number of strip buffers in the read/embed/write pipeline */
+#define STEG_DEFAULT_PIPELINE_DEPTH 4
+
+/** @brief Largest accepted number of strip buffers in the pipeline */
+#define STEG_MAX_PIPELINE_DEPTH 64
+
+/** @brief Largest number of payload bits stored per pixel byte */
+#define STEG_MAX_BITS_PER_CHANNEL 4
+
+/** @brief Magic bytes opening every payload header */
+#define STEG_PAYLOAD_MAGIC "STEG"
+
+/** @brief Current payload header layout version */
+#define STEG_PAYLOAD_VERSION 1
+
+/** @brief Serialised payload header size in bytes */
+#define STEG_PAYLOAD_HEADER_SIZE 16
+
+/** @brief Pixel bytes occupied by the payload header (always 1 bit per byte) */
+#define STEG_PAYLOAD_HEADER_PIXELS (STEG_PAYLOAD_HEADER_SIZE * 8)
+
+/** @brief Payload length passed to embed_payload_stream() when it is not known */
+#define STEG_LENGTH_UNKNOWN ((size_t)-1)
+
 // ============================================================================
 // ERROR CODES
 // ============================================================================
@@ -43,7 +96,7 @@
 /** @brief File I/O operation failed */
 #define STEG_FILE_ERROR -1
 
-/** @brief Invalid BMP format (must be 24-bit uncompressed) */
+/** @brief Invalid BMP format (must be 24-bit or 32-bit uncompressed) */
 #define STEG_INVALID_BMP -2
 
 /** @brief Image too small to hold the message */
@@ -52,6 +105,12 @@
 /** @brief Memory allocation failed */
 #define STEG_MEMORY_ERROR -4
 
+/** @brief Invalid argument or option value */
+#define STEG_INVALID_ARGUMENT -5
+
+/** @brief Image carries no (or an unsupported) payload header */
+#define STEG_NO_PAYLOAD_HEADER -6
+
 // ============================================================================
 // BMP FILE STRUCTURES
 // ============================================================================
@@ -77,12 +136,12 @@ typedef struct {
  * dimensions, color depth, and compression settings.
  */
 typedef struct {
-    uint32_t header_size;    /**< Size of info header (40 bytes) */
+    uint32_t header_size;    /**< Size of info header (40, or 108/124 for V4/V5) */
     int32_t width;          /**< Image width in pixels */
     int32_t height;         /**< Image height in pixels */
     uint16_t planes;        /**< Number of color planes (must be 1) */
-    uint16_t bits_per_pixel; /**< Bits per pixel (must be 24) */
-    uint32_t compression;   /**< Compression type (0 = uncompressed) */
+    uint16_t bits_per_pixel; /**< Bits per pixel (24 or 32) */
+    uint32_t compression;   /**< Compression type (BI_RGB, or BI_BITFIELDS at 32 bpp) */
     uint32_t image_size;    /**< Size of pixel data in bytes */
     int32_t x_pixels_per_m; /**< Horizontal resolution (pixels/meter) */
     int32_t y_pixels_per_m; /**< Vertical resolution (pixels/meter) */
@@ -90,10 +149,42 @@ typedef struct {
     uint32_t important_colors; /**< Important colors (0 = all) */
 } __attribute__((packed)) bmp_info_header_t;
 
+/**
+ * @brief Payload header stored ahead of the hidden data
+ * 
+ * Serialised as the 4-byte STEG_PAYLOAD_MAGIC followed by version,
+ * bits_per_channel, flags (16-bit big-endian) and length (64-bit
+ * big-endian), 16 bytes in total. It is always embedded at 1 bit per
+ * pixel byte in the first STEG_PAYLOAD_HEADER_PIXELS pixel bytes, so
+ * a reader can recover the depth and length before touching the
+ * payload itself.
+ */
+typedef struct {
+    uint8_t version;          /**< Header layout version (STEG_PAYLOAD_VERSION) */
+    uint8_t bits_per_channel; /**< Depth the payload was embedded at */
+    uint16_t flags;           /**< Reserved, must be 0 */
+    uint64_t length;          /**< Payload length in bytes */
+} steg_payload_header_t;
+
 // ============================================================================
 // CORE STEGANOGRAPHY FUNCTIONS
 // ============================================================================
 
+/**
+ * @brief Embed a binary payload into a BMP image using LSB steganography
+ * 
+ * @param payload Bytes to embed
+ * @param length Number of bytes at payload
+ * @param input Input BMP file stream
+ * @param output Output BMP file stream
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Writes a payload header recording the length and the current depth,
+ * followed by the payload at steg_get_bits_per_channel() bits per
+ * pixel byte. No terminator is stored, so the payload may contain NULs.
+ */
+int embed_payload(const unsigned char* payload, size_t length, FILE* input, FILE* output);
+
 /**
  * @brief Embed a message into a BMP image using LSB steganography
  * 
@@ -102,12 +193,96 @@ typedef struct {
  * @param output Output BMP file stream
  * @return Error code (STEG_SUCCESS on success)
  * 
- * This function hides the given message in the least significant bits
- * of the pixel data. Each character requires 8 pixel bytes (1 bit per byte).
- * The message is automatically null-terminated.
+ * Equivalent to embed_payload() with the message's strlen().
  */
 int embed_message(const char* message, FILE* input, FILE* output);
 
+/**
+ * @brief Stream a payload from a file into a BMP image
+ * 
+ * @param payload Stream the payload is read from (file, pipe or stdin)
+ * @param length Payload length in bytes, or STEG_LENGTH_UNKNOWN
+ * @param input Input BMP file stream
+ * @param output Output BMP file stream
+ * @param embedded Receives the number of payload bytes embedded (may be NULL)
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Reads the payload one block's worth at a time, so memory use depends
+ * on the block size only. With STEG_LENGTH_UNKNOWN the payload is read
+ * until end of file and the payload header is rewritten afterwards,
+ * which requires a seekable output. Payloads that outgrow the image
+ * fail with STEG_INSUFFICIENT_CAPACITY.
+ */
+int embed_payload_stream(FILE* payload, size_t length, FILE* input, FILE* output, size_t* embedded);
+
+/**
+ * @brief Embed a binary payload into a BMP image by patching it in place
+ * 
+ * @param payload Bytes to embed
+ * @param length Number of bytes at payload
+ * @param image BMP file stream opened for update ("r+b")
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Produces the same result as embed_payload() but only reads and
+ * rewrites the pixel bytes that carry the payload header and payload.
+ * Intended for an output file that was first created as a clone of
+ * the input (see steg_clone_file()).
+ */
+int embed_payload_patch(const unsigned char* payload, size_t length, FILE* image);
+
+/**
+ * @brief Embed a message into a BMP image by patching it in place
+ * 
+ * @param message The ASCII text message to embed
+ * @param image BMP file stream opened for update ("r+b")
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Equivalent to embed_payload_patch() with the message's strlen().
+ */
+int embed_message_patch(const char* message, FILE* image);
+
+/**
+ * @brief Read the payload header of a BMP image
+ * 
+ * @param input Input BMP file stream
+ * @param header Receives the decoded header
+ * @return Error code (STEG_SUCCESS, or STEG_NO_PAYLOAD_HEADER for images
+ *         without one)
+ * 
+ * Only the pixel rows that hold the header are read.
+ */
+int read_payload_header(FILE* input, steg_payload_header_t* header);
+
+/**
+ * @brief Extract a binary payload from a BMP image
+ * 
+ * @param buffer Output buffer for the payload
+ * @param max_len Maximum number of bytes to store
+ * @param length Receives the number of bytes stored
+ * @param input Input BMP file stream
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Reads exactly the pixel bytes named by the payload header, at the
+ * depth recorded there. Images without a header (legacy layout) are
+ * decoded at the current depth up to the first NUL terminator.
+ * Payloads longer than max_len are truncated.
+ */
+int extract_payload(unsigned char* buffer, size_t max_len, size_t* length, FILE* input);
+
+/**
+ * @brief Stream an extracted payload into a file
+ * 
+ * @param input Input BMP file stream
+ * @param sink Stream the payload is written to (file, pipe or stdout)
+ * @param length Receives the number of bytes written (may be NULL)
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Decodes one block at a time, so memory use depends on the block size
+ * only. Images without a payload header are decoded up to the first
+ * NUL terminator.
+ */
+int extract_payload_stream(FILE* input, FILE* sink, size_t* length);
+
 /**
  * @brief Extract a hidden message from a BMP image
  * 
@@ -116,19 +291,71 @@ int embed_message(const char* message, FILE* input, FILE* output);
  * @param input Input BMP file stream
  * @return Error code (STEG_SUCCESS on success)
  * 
- * This function reads the least significant bits of pixel data
- * and reconstructs the hidden message. Extraction stops at the
- * first null terminator encountered.
+ * Calls extract_payload() with room for max_len - 1 bytes and
+ * null-terminates the result.
  */
 int extract_message(char* buffer, size_t max_len, FILE* input);
 
+/**
+ * @brief Embed a binary payload into a BMP image held in memory
+ * 
+ * @param payload Bytes to embed
+ * @param length Number of bytes at payload
+ * @param image Complete BMP file contents, modified in place
+ * @param image_size Size of the image in bytes
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Memory counterpart of embed_payload().
+ */
+int embed_payload_buffer(const unsigned char* payload, size_t length, unsigned char* image, size_t image_size);
+
+/**
+ * @brief Extract a binary payload from a BMP image held in memory
+ * 
+ * @param buffer Output buffer for the payload
+ * @param max_len Maximum number of bytes to store
+ * @param length Receives the number of bytes stored
+ * @param image Complete BMP file contents
+ * @param image_size Size of the image in bytes
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Memory counterpart of extract_payload().
+ */
+int extract_payload_buffer(unsigned char* buffer, size_t max_len, size_t* length,
+                           const unsigned char* image, size_t image_size);
+
+/**
+ * @brief Embed a message into a BMP image held in memory
+ * 
+ * @param message The ASCII text message to embed
+ * @param image Complete BMP file contents, modified in place
+ * @param image_size Size of the image in bytes
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Memory counterpart of embed_message(), used by the mmap backend.
+ */
+int embed_message_buffer(const char* message, unsigned char* image, size_t image_size);
+
+/**
+ * @brief Extract a hidden message from a BMP image held in memory
+ * 
+ * @param buffer Output buffer to store the extracted message
+ * @param max_len Maximum length of the buffer
+ * @param image Complete BMP file contents
+ * @param image_size Size of the image in bytes
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Memory counterpart of extract_message(), used by the mmap backend.
+ */
+int extract_message_buffer(char* buffer, size_t max_len, const unsigned char* image, size_t image_size);
+
 /**
  * @brief Read and validate BMP file header
  * 
  * @param file Input file stream
- * @return Error code (STEG_SUCCESS if valid 24-bit BMP)
+ * @return Error code (STEG_SUCCESS if valid 24-bit or 32-bit BMP)
  * 
- * Validates that the file is a proper 24-bit uncompressed BMP image.
+ * Validates that the file is a proper uncompressed 24-bit or 32-bit BMP image.
  */
 int read_bmp_header(FILE* file);
 
@@ -139,10 +366,128 @@ int read_bmp_header(FILE* file);
  * @param output Destination file stream
  * @return Error code (STEG_SUCCESS on success)
  * 
- * Copies the 54-byte BMP header from input to output file.
+ * Copies everything before the pixel array from input to output:
+ * the 54-byte BMP header plus any extended info header, palette or
+ * gap up to data_offset.
  */
 int write_bmp_header(FILE* input, FILE* output);
 
+/**
+ * @brief Set the block size used for buffered pixel I/O
+ * 
+ * @param block_size Block size in bytes
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Pixel data is read, modified and written in blocks of this size.
+ * The value is rounded down to a multiple of 8 so that every block
+ * holds whole characters. Returns STEG_INVALID_ARGUMENT when the size
+ * is outside [STEG_MIN_BLOCK_SIZE, STEG_MAX_BLOCK_SIZE].
+ */
+int steg_set_block_size(size_t block_size);
+
+/**
+ * @brief Get the block size used for buffered pixel I/O
+ * 
+ * @return Current block size in bytes
+ */
+size_t steg_get_block_size(void);
+
+/**
+ * @brief Set the number of payload bits stored in each pixel byte
+ * 
+ * @param bits Bits per channel (1-STEG_MAX_BITS_PER_CHANNEL)
+ * @return Error code (STEG_SUCCESS, or STEG_INVALID_ARGUMENT)
+ * 
+ * The default of 1 is the classic LSB layout. Higher depths multiply
+ * capacity and touch proportionally fewer pixel bytes per payload
+ * byte, at the cost of more visible changes. Extraction must use the
+ * same depth as embedding.
+ */
+int steg_set_bits_per_channel(int bits);
+
+/**
+ * @brief Get the number of payload bits stored in each pixel byte
+ * 
+ * @return Bits per channel
+ */
+int steg_get_bits_per_channel(void);
+
+/**
+ * @brief Set the number of threads the engine splits pixel work across
+ * 
+ * @param threads Thread count (1-STEG_MAX_THREADS), or 0 for one per
+ *        online CPU
+ * @return Error code (STEG_SUCCESS, or STEG_INVALID_ARGUMENT)
+ * 
+ * With more than one thread each strip holds one block per thread and
+ * is cut into stripes that embed or extract their own slice of the
+ * payload in parallel. Output is byte-identical to a single thread.
+ */
+int steg_set_threads(int threads);
+
+/**
+ * @brief Get the number of threads the engine splits pixel work across
+ * 
+ * @return Thread count (1 when single-threaded)
+ */
+int steg_get_threads(void);
+
+/**
+ * @brief Set the number of strip buffers in the embedding pipeline
+ * 
+ * @param depth Buffers (2-STEG_MAX_PIPELINE_DEPTH), or 0 or 1 to embed
+ *        serially
+ * @return Error code (STEG_SUCCESS, or STEG_INVALID_ARGUMENT)
+ * 
+ * When a BMP embed writes to a separate output and spans more than one
+ * strip, a reader thread loads strips ahead and a writer thread stores
+ * them behind the thread running the kernels, so disk reads, embedding
+ * and disk writes overlap. Each buffer holds one strip.
+ */
+int steg_set_pipeline_depth(int depth);
+
+/**
+ * @brief Get the number of strip buffers in the embedding pipeline
+ * 
+ * @return Buffer count (below 2 when embedding serially)
+ */
+int steg_get_pipeline_depth(void);
+
+/**
+ * @brief Message capacity of a pixel array at the current depth
+ * 
+ * @param pixel_bytes Number of pixel bytes available for embedding
+ * @return Number of payload bytes that fit after the payload header
+ */
+size_t steg_capacity_for(size_t pixel_bytes);
+
+/**
+ * @brief Message capacity of a pixel array at a given depth
+ * 
+ * @param pixel_bytes Number of pixel bytes available for embedding
+ * @param bits Bits per channel (1-STEG_MAX_BITS_PER_CHANNEL)
+ * @return Number of payload bytes that fit after the payload header
+ */
+size_t steg_capacity_at(size_t pixel_bytes, int bits);
+
+/**
+ * @brief Serialise a payload header into STEG_PAYLOAD_HEADER_SIZE bytes
+ * 
+ * @param header Header to serialise
+ * @param out Destination buffer of STEG_PAYLOAD_HEADER_SIZE bytes
+ */
+void steg_encode_payload_header(const steg_payload_header_t* header, unsigned char* out);
+
+/**
+ * @brief Parse a serialised payload header
+ * 
+ * @param in STEG_PAYLOAD_HEADER_SIZE bytes decoded from the image
+ * @param header Receives the parsed header
+ * @return STEG_SUCCESS, or STEG_NO_PAYLOAD_HEADER if the magic, version
+ *         or depth is not recognised
+ */
+int steg_decode_payload_header(const unsigned char* in, steg_payload_header_t* header);
+
 // ============================================================================
 // UTILITY FUNCTIONS
 // ============================================================================
@@ -153,11 +498,23 @@ int write_bmp_header(FILE* input, FILE* output);
  * @param file Input file stream
  * @return Error code (STEG_SUCCESS if valid)
  * 
- * Checks that the file is a 24-bit uncompressed BMP image.
+ * Checks that the file is a 24-bit or 32-bit uncompressed BMP image
+ * (BITMAPINFOHEADER, V4 or V5).
  * This function reads both file and info headers.
  */
 int validate_bmp_format(FILE* file);
 
+/**
+ * @brief Validate BMP format of an image held in memory
+ * 
+ * @param data Start of the BMP file contents
+ * @param size Number of bytes available at data
+ * @return Error code (STEG_SUCCESS if valid)
+ * 
+ * Same checks as validate_bmp_format(), parsed directly from memory.
+ */
+int validate_bmp_buffer(const unsigned char* data, size_t size);
+
 /**
  * @brief Calculate maximum message capacity
  * 
@@ -165,7 +522,9 @@ int validate_bmp_format(FILE* file);
  * @return Maximum number of characters that can be embedded
  * 
  * Calculates how many characters can be hidden in the image
- * based on available pixel data (file_size - header_size) / 8.
+ * based on its pixel rows, excluding row padding and any data
+ * outside the pixel array: (pixel_bytes - STEG_PAYLOAD_HEADER_PIXELS)
+ * * bits_per_channel / 8.
  */
 size_t calculate_message_capacity(FILE* file);
 
@@ -0,0 +1,93 @@
+/**
+ * @file steg_batch_io.h
+ * @brief LSB Steganography Tool - Whole-File I/O for Batch Mode
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * Loads and stores many small files at once. With thousands of small
+ * covers the per-file open, read, write and close calls cost more than
+ * the embedding itself, so batch mode can load a window of images and
+ * payloads in one go, process them in memory and store the results in
+ * one go.
+ *
+ * The io_uring backend keeps many opens, size queries, reads, writes
+ * and closes in flight on a single ring, driven by raw system calls.
+ * The pread backend runs open/pread/pwrite/close per file on the
+ * thread pool and is used wherever io_uring is not available.
+ */
+
+#ifndef STEG_BATCH_IO_H
+#define STEG_BATCH_IO_H
+
+#include <stddef.h>
+
+/** @brief Each job opens and streams its own files with stdio (default) */
+#define STEG_BATCH_IO_STDIO 0
+
+/** @brief Whole files loaded and stored with open/pread/pwrite on the thread pool */
+#define STEG_BATCH_IO_PREAD 1
+
+/** @brief Whole files loaded and stored through io_uring, many operations in flight */
+#define STEG_BATCH_IO_URING 2
+
+/**
+ * @brief One file to load or store
+ */
+typedef struct {
+    const char* path;    /**< File to load or store */
+    unsigned char* data; /**< Loaded contents (malloc'd, freed by the caller) or data to store */
+    size_t size;         /**< Bytes loaded, or to store */
+    int result;          /**< STEG_SUCCESS or STEG_FILE_ERROR */
+} steg_file_t;
+
+/**
+ * @brief Look up a batch I/O backend by name
+ *
+ * @param name "stdio", "pread" or "uring"
+ * @return One of the STEG_BATCH_IO_* values, or -1 if the name is unknown
+ */
+int steg_parse_batch_io(const char* name);
+
+/**
+ * @brief Get a printable name for a batch I/O backend
+ *
+ * @param backend One of the STEG_BATCH_IO_* values
+ * @return Static string such as "io_uring"
+ */
+const char* steg_batch_io_name(int backend);
+
+/**
+ * @brief Backend that will actually serve a request for backend
+ *
+ * @param backend One of the STEG_BATCH_IO_* values
+ * @return backend, or STEG_BATCH_IO_PREAD when io_uring was asked for
+ *         but the kernel lacks it (or the needed operations)
+ */
+int steg_batch_io_resolve(int backend);
+
+/**
+ * @brief Load whole files into memory
+ *
+ * @param files Files to load; data and size are filled in
+ * @param count Number of files
+ * @param max_size Largest file to load; bigger files only get their
+ *        size filled in and keep data NULL
+ * @param backend STEG_BATCH_IO_PREAD or STEG_BATCH_IO_URING
+ * @return Error code (STEG_SUCCESS once every file has its result);
+ *         on failure files that did not finish fail with data NULL
+ */
+int steg_load_files(steg_file_t* files, size_t count, size_t max_size, int backend);
+
+/**
+ * @brief Create or truncate files and store data in them
+ *
+ * @param files Files to store
+ * @param count Number of files
+ * @param backend STEG_BATCH_IO_PREAD or STEG_BATCH_IO_URING
+ * @return Error code (STEG_SUCCESS once every file has its result);
+ *         on failure files that did not finish fail
+ */
+int steg_store_files(steg_file_t* files, size_t count, int backend);
+
+#endif // STEG_BATCH_IO_H
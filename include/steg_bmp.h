@@ -0,0 +1,321 @@
+/**
+ * @file steg_bmp.h
+ * @brief LSB Steganography Tool - Row-Aware BMP Pixel Engine
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * Parses the BMP headers once into a pixel layout and walks the pixel
+ * array in strips of whole rows. Row padding and any data between the
+ * headers and data_offset are never touched: the engine sees only the
+ * "logical" pixel bytes, i.e. the rows concatenated without padding.
+ *
+ * Strips are read from a stdio stream, a file descriptor (pread) or
+ * an image held in memory. Rows without padding are handed to the
+ * kernels in place; padded rows are gathered into a contiguous buffer
+ * and scattered back on store.
+ *
+ * 32-bit images (BI_RGB or BI_BITFIELDS, any info header version) are
+ * packed to their three colour channels per pixel on load and unpacked
+ * on store, so the logical bytes never include alpha.
+ */
+
+#ifndef STEG_BMP_H
+#define STEG_BMP_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "steg.h"
+#include "steg_kernels.h"
+#include "thread_pool.h"
+
+// ============================================================================
+// PIXEL LAYOUT
+// ============================================================================
+
+/**
+ * @brief Location and shape of a BMP pixel array
+ */
+typedef struct {
+    uint32_t data_offset;    /**< File offset of the first pixel row */
+    uint16_t bits_per_pixel; /**< Bits per pixel from the info header */
+    uint16_t pixel_size;     /**< Bytes per pixel in the file (3 or 4) */
+    int alpha_index;         /**< Byte of a 4-byte pixel that is not a colour channel */
+    size_t width;            /**< Pixels per row */
+    size_t row_bytes;        /**< Colour channel bytes per row (3 per pixel) */
+    size_t row_stride;       /**< Bytes per row in the file, padded to 4 */
+    size_t rows;             /**< Rows actually present in the file */
+} steg_bmp_layout_t;
+
+/**
+ * @brief Parse the pixel layout from the BMP headers
+ *
+ * @param headers Start of the BMP file (at least BMP_HEADER_SIZE bytes;
+ *        BMP_LAYOUT_HEADER_SIZE when the image uses BI_BITFIELDS)
+ * @param size Number of bytes available at headers
+ * @param file_size Total size of the BMP file
+ * @param layout Receives the layout
+ * @return Error code (STEG_SUCCESS, STEG_INVALID_BMP or STEG_FILE_ERROR)
+ *
+ * Validates the headers first. BI_BITFIELDS masks must each select
+ * one whole byte of the pixel. Rows that the file is too short to
+ * hold are not counted; the last row may omit its padding.
+ */
+int steg_bmp_parse_layout(const unsigned char* headers, size_t size, uint64_t file_size,
+                          steg_bmp_layout_t* layout);
+
+/**
+ * @brief Read and parse the pixel layout of a BMP stream
+ *
+ * @param file BMP file stream
+ * @param layout Receives the layout
+ * @return Error code (STEG_SUCCESS on success)
+ *
+ * The stream position is preserved.
+ */
+int steg_bmp_read_layout(FILE* file, steg_bmp_layout_t* layout);
+
+/**
+ * @brief Number of logical pixel bytes (colour channels, no padding) in the image
+ */
+size_t steg_bmp_pixel_bytes(const steg_bmp_layout_t* layout);
+
+// ============================================================================
+// ENGINE SETTINGS
+// ============================================================================
+
+/**
+ * @brief Settings a strip cursor runs with
+ *
+ * Cursors opened with only a block size take them from the process
+ * (steg_engine_defaults()) when they are opened; a steg_ctx_t passes
+ * the copy it took when it was created.
+ */
+typedef struct {
+    const lsb_kernel_t* kernel; /**< Kernel the payload is embedded and extracted with */
+    steg_thread_pool_t* pool;   /**< Pool large strips are split across, NULL for one thread */
+    int bits;                   /**< Payload bits per channel when embedding, and for legacy images */
+    int pipeline_depth;         /**< Strip buffers in the embedding pipeline, below 2 for serial */
+} steg_engine_t;
+
+/**
+ * @brief Fill engine settings from the process-wide ones
+ *
+ * @param engine Receives lsb_active_kernel(), steg_thread_pool_shared(),
+ *        steg_get_bits_per_channel() and steg_get_pipeline_depth()
+ */
+void steg_engine_defaults(steg_engine_t* engine);
+
+// ============================================================================
+// STRIP CURSOR
+// ============================================================================
+
+/** @brief Strips are read with fread() and stored with fwrite() */
+#define STEG_STRIPS_STREAM 0
+
+/** @brief Strips are read with pread() and stored with pwrite() */
+#define STEG_STRIPS_FD 1
+
+/** @brief Strips point into an image held in memory */
+#define STEG_STRIPS_MEMORY 2
+
+/** @brief Whole pixels that hold the payload header */
+#define STEG_HEADER_PIXEL_COUNT ((STEG_PAYLOAD_HEADER_PIXELS + 2) / 3)
+
+/**
+ * @brief Cursor over the pixel array in strips of whole rows
+ *
+ * Full strips always hold a multiple of 8 logical bytes, so kernel
+ * groups never straddle two strips; only the last strip of the image
+ * can end mid-group.
+ */
+typedef struct {
+    steg_bmp_layout_t layout;
+    int kind;               /**< One of the STEG_STRIPS_* values */
+    FILE* file;             /**< Stream source */
+    FILE* out;              /**< Stream destination, NULL to write back in place */
+    long out_base;          /**< Output offset of the start of the BMP file */
+    int fd;                 /**< Descriptor source */
+    int out_fd;             /**< Descriptor destination */
+    unsigned char* image;   /**< Memory source */
+    steg_engine_t engine;   /**< Kernel and pool the cursor runs with */
+    size_t strip_rows;      /**< Rows in a full strip */
+    size_t next_row;        /**< First row of the next strip */
+    size_t start;           /**< Logical offset of the current strip */
+    size_t rows;            /**< Rows in the current strip */
+    size_t length;          /**< Logical bytes in the current strip */
+    size_t raw_length;      /**< File bytes in the current strip */
+    unsigned char* raw;     /**< Current strip as stored in the file */
+    unsigned char* pixels;  /**< Current strip without padding */
+    unsigned char* buffer;  /**< Owned strip storage */
+    unsigned char prefix[STEG_HEADER_PIXEL_COUNT * 4]; /**< Payload header pixels as last stored */
+    int error;              /**< Error code of the last failed operation */
+} steg_strips_t;
+
+/**
+ * @brief Open a strip cursor over a stdio stream
+ *
+ * @param strips Cursor to initialise
+ * @param layout Pixel layout of the image
+ * @param input Stream the pixel rows are read from
+ * @param output Stream the rows are written to (positioned at
+ *        data_offset), or NULL to write them back into input
+ * @param block_size Approximate bytes per strip
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int steg_strips_open_stream(steg_strips_t* strips, const steg_bmp_layout_t* layout,
+                            FILE* input, FILE* output, size_t block_size);
+
+/**
+ * @brief Open a strip cursor over file descriptors
+ *
+ * @param strips Cursor to initialise
+ * @param layout Pixel layout of the image
+ * @param fd Descriptor the pixel rows are read from
+ * @param out_fd Descriptor the rows are written to (-1 for read-only use)
+ * @param out_base Output offset corresponding to input offset 0
+ * @param block_size Approximate bytes per strip
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int steg_strips_open_fd(steg_strips_t* strips, const steg_bmp_layout_t* layout,
+                        int fd, int out_fd, off_t out_base, size_t block_size);
+
+/**
+ * @brief Open a strip cursor over an image held in memory
+ *
+ * @param strips Cursor to initialise
+ * @param layout Pixel layout of the image
+ * @param image Complete BMP file contents (modified in place on store)
+ * @param block_size Approximate bytes per strip
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int steg_strips_open_memory(steg_strips_t* strips, const steg_bmp_layout_t* layout,
+                            unsigned char* image, size_t block_size);
+
+/**
+ * @brief Scratch bytes a memory strip cursor needs for gathered rows
+ *
+ * @param layout Pixel layout of the image
+ * @param block_size Approximate bytes per strip
+ * @param engine Settings the cursor will run with
+ * @return Bytes steg_strips_open_memory_scratch() expects (0 when rows
+ *         have no padding and are used in place)
+ */
+size_t steg_strips_memory_scratch(const steg_bmp_layout_t* layout, size_t block_size,
+                                  const steg_engine_t* engine);
+
+/**
+ * @brief Open a strip cursor over an image held in memory, in caller scratch
+ *
+ * @param strips Cursor to initialise
+ * @param layout Pixel layout of the image
+ * @param image Complete BMP file contents (modified in place on store)
+ * @param block_size Approximate bytes per strip
+ * @param engine Settings to run with, as given to steg_strips_memory_scratch()
+ * @param scratch steg_strips_memory_scratch() bytes the cursor uses
+ *        instead of allocating, or NULL to allocate
+ * @return Error code (STEG_SUCCESS on success)
+ *
+ * Closing the cursor leaves the scratch to its owner.
+ */
+int steg_strips_open_memory_scratch(steg_strips_t* strips, const steg_bmp_layout_t* layout,
+                                    unsigned char* image, size_t block_size, const steg_engine_t* engine,
+                                    unsigned char* scratch);
+
+/**
+ * @brief Load the next strip
+ *
+ * @param strips Cursor
+ * @param needed Logical bytes the caller still needs; fewer rows than
+ *        a full strip are read when they cover it
+ * @return Logical bytes in the strip (at strips->pixels), or 0 at the
+ *         end of the pixel array or on error (strips->error is set)
+ */
+size_t steg_strips_next(steg_strips_t* strips, size_t needed);
+
+/**
+ * @brief Write the current strip back (or to the output)
+ *
+ * @param strips Cursor
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int steg_strips_store(steg_strips_t* strips);
+
+/**
+ * @brief Restart the cursor at the first row
+ */
+void steg_strips_rewind(steg_strips_t* strips);
+
+/**
+ * @brief File offset just past the last row loaded
+ */
+long steg_strips_end_offset(const steg_strips_t* strips);
+
+/**
+ * @brief Release the cursor's buffers
+ */
+void steg_strips_close(steg_strips_t* strips);
+
+// ============================================================================
+// ENGINE
+// ============================================================================
+
+/**
+ * @brief Embed the payload header and payload through a strip cursor
+ *
+ * @param strips Cursor positioned at the first row
+ * @param payload Payload bytes, or NULL to read them from payload_file
+ * @param payload_file Stream the payload is read from when payload is NULL
+ * @param length Payload length, or STEG_LENGTH_UNKNOWN with payload_file
+ * @param embedded Receives the number of payload bytes embedded (may be NULL)
+ * @return Error code (STEG_SUCCESS on success)
+ *
+ * Only the strips that carry the header or payload are loaded and
+ * stored. With an unknown length the header is written with length 0;
+ * call steg_strips_patch_header() once the output is complete.
+ *
+ * Stream and descriptor cursors with a separate destination run the
+ * strips through the read/embed/write pipeline (steg_pipeline.h) when
+ * more than one strip is needed and the pipeline depth is at least 2.
+ */
+int steg_embed_strips(steg_strips_t* strips, const unsigned char* payload, FILE* payload_file,
+                      size_t length, size_t* embedded);
+
+/**
+ * @brief Rewrite the payload header with its final length
+ *
+ * @param strips Cursor used by steg_embed_strips()
+ * @param length Final payload length
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int steg_strips_patch_header(steg_strips_t* strips, size_t length);
+
+/**
+ * @brief Extract the payload through a strip cursor
+ *
+ * @param strips Cursor positioned at the first row
+ * @param buffer Destination buffer, or NULL to write to sink
+ * @param sink Stream the payload is written to when buffer is NULL
+ * @param max_len Maximum number of bytes to extract
+ * @param length Receives the number of bytes extracted
+ * @return Error code (STEG_SUCCESS on success)
+ *
+ * Follows the payload header when present; images without one are
+ * decoded at the cursor's depth up to the first NUL terminator.
+ */
+int steg_extract_strips(steg_strips_t* strips, unsigned char* buffer, FILE* sink,
+                        size_t max_len, size_t* length);
+
+/**
+ * @brief Read the payload header through a strip cursor
+ *
+ * @param strips Cursor; rewound afterwards
+ * @param encoded Receives the STEG_PAYLOAD_HEADER_SIZE header bytes
+ * @return Error code (STEG_SUCCESS, or STEG_FILE_ERROR if the image is
+ *         too small to hold a header)
+ */
+int steg_strips_read_header(steg_strips_t* strips, unsigned char* encoded);
+
+#endif // STEG_BMP_H
@@ -0,0 +1,149 @@
+/**
+ * @file steg_ctx.h
+ * @brief LSB Steganography Tool - Reusable Steganography Context
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * A context carries everything a long-running process needs to embed
+ * and extract image after image without going back to the heap: an
+ * arena that every call takes its scratch buffers and results from,
+ * and the engine settings (kernel, thread pool, block size and bits
+ * per channel), copied from the process-wide ones when the context is
+ * created. Later calls to the steg_set_*() functions do not reach a
+ * context that already exists.
+ *
+ * The arena grows while the first, largest images go through it and
+ * is coalesced into a single block when a call starts, so once it has
+ * seen the largest image a BMP embed or extract allocates nothing.
+ * Each BMP call parses the headers exactly once. PNG and JPEG calls
+ * run the handlers' buffer entry points, whose memory streams are
+ * still allocated by stdio.
+ *
+ * A context is not thread-safe; give each thread its own. Its results
+ * stay valid until the next call on the same context.
+ */
+
+#ifndef STEG_CTX_H
+#define STEG_CTX_H
+
+#include <stddef.h>
+#include "formats.h"
+#include "steg_kernels.h"
+#include "thread_pool.h"
+
+/** @brief Arena size of a context created with arena_size 0 */
+#define STEG_CTX_DEFAULT_ARENA (1024 * 1024)
+
+/**
+ * @brief Opaque steganography context
+ */
+typedef struct steg_ctx steg_ctx_t;
+
+/**
+ * @brief Counters of a context
+ */
+typedef struct {
+    unsigned long long calls;       /**< Capacity, embed and extract calls made */
+    unsigned long long allocations; /**< Arena blocks taken from the heap, creation included */
+    size_t arena_size;              /**< Bytes the arena holds */
+    size_t arena_peak;              /**< Most arena bytes one call has used */
+} steg_ctx_stats_t;
+
+/**
+ * @brief Create a context
+ *
+ * @param arena_size Initial arena size in bytes (0 for
+ *        STEG_CTX_DEFAULT_ARENA); it grows as needed
+ * @return New context, or NULL on failure
+ *
+ * Takes the LSB kernel, the shared thread pool for the current
+ * steg_set_threads() value, the block size and the bits per channel,
+ * so configure the engine first.
+ */
+steg_ctx_t* steg_ctx_create(size_t arena_size);
+
+/**
+ * @brief Free a context and its arena
+ */
+void steg_ctx_destroy(steg_ctx_t* ctx);
+
+/**
+ * @brief Take bytes from the arena
+ *
+ * @param ctx Context
+ * @param size Number of bytes
+ * @return 64-byte aligned memory valid until the next call or reset,
+ *         or NULL on failure
+ */
+void* steg_ctx_alloc(steg_ctx_t* ctx, size_t size);
+
+/**
+ * @brief Release everything taken from the arena
+ *
+ * Every call starts with a reset. An arena that had to grow is
+ * coalesced into one block big enough for all of it.
+ */
+void steg_ctx_reset(steg_ctx_t* ctx);
+
+/**
+ * @brief LSB kernel resolved when the context was created
+ */
+const lsb_kernel_t* steg_ctx_kernel(const steg_ctx_t* ctx);
+
+/**
+ * @brief Thread pool resolved when the context was created (NULL with one thread)
+ */
+steg_thread_pool_t* steg_ctx_pool(const steg_ctx_t* ctx);
+
+/**
+ * @brief Message capacity of an image in memory
+ *
+ * @param ctx Context
+ * @param handler Handler of the image's format
+ * @param image Complete image file contents
+ * @param image_size Size of the image in bytes
+ * @param capacity Receives the capacity in bytes
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int steg_ctx_capacity(steg_ctx_t* ctx, const format_handler_t* handler, const unsigned char* image,
+                      size_t image_size, size_t* capacity);
+
+/**
+ * @brief Embed a payload into an image in memory
+ *
+ * @param ctx Context
+ * @param handler Handler of the image's format
+ * @param image Complete image file contents
+ * @param image_size Size of the image in bytes
+ * @param payload Payload bytes; PNG and JPEG only take text without NULs
+ * @param length Payload length
+ * @param output Stego image destination, which may be image itself
+ * @param output_capacity Size of output (image_size always suffices)
+ * @param output_size Receives the size of the stego image
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int steg_ctx_embed(steg_ctx_t* ctx, const format_handler_t* handler, const unsigned char* image,
+                   size_t image_size, const unsigned char* payload, size_t length,
+                   unsigned char* output, size_t output_capacity, size_t* output_size);
+
+/**
+ * @brief Extract a payload from an image in memory
+ *
+ * @param ctx Context
+ * @param handler Handler of the image's format
+ * @param image Complete image file contents
+ * @param image_size Size of the image in bytes
+ * @param payload Receives the payload, NUL-terminated, in the arena
+ * @param length Receives the payload length
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int steg_ctx_extract(steg_ctx_t* ctx, const format_handler_t* handler, const unsigned char* image,
+                     size_t image_size, const unsigned char** payload, size_t* length);
+
+/**
+ * @brief Read the counters of a context
+ */
+void steg_ctx_stats(const steg_ctx_t* ctx, steg_ctx_stats_t* stats);
+
+#endif // STEG_CTX_H
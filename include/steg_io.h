@@ -0,0 +1,251 @@
+/**
+ * @file steg_io.h
+ * @brief LSB Steganography Tool - I/O Helpers
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ * 
+ * Low-level I/O helpers used by the steganography engine: selectable
+ * I/O backends for BMP images and kernel-side copies of unmodified
+ * image data that avoid streaming it through user space.
+ */
+
+#ifndef STEG_IO_H
+#define STEG_IO_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// ============================================================================
+// PASSTHROUGH COPY
+// ============================================================================
+
+/** @brief Tail was copied in the kernel with copy_file_range() */
+#define STEG_COPY_RANGE 1
+
+/** @brief Tail was copied in the kernel with sendfile() */
+#define STEG_COPY_SENDFILE 2
+
+/** @brief Tail was copied through a user-space buffer */
+#define STEG_COPY_BUFFERED 3
+
+/** @brief File was cloned as a copy-on-write reflink (FICLONE) */
+#define STEG_COPY_REFLINK 4
+
+/**
+ * @brief Copy the rest of the input stream to the output stream
+ * 
+ * @param input Source stream, positioned at the first byte to copy
+ * @param output Destination stream, positioned where the data goes
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Both streams are flushed and the copy is handed to the kernel with
+ * copy_file_range(), falling back to sendfile() and finally to a
+ * buffered fread/fwrite loop when the file systems or stream types do
+ * not support it. Both streams are left positioned at their end.
+ */
+int steg_copy_remaining(FILE* input, FILE* output);
+
+/**
+ * @brief Copy part of one file to the current position of another
+ * 
+ * @param in_fd Source file, read at explicit offsets
+ * @param out_fd Destination, written at and advancing its file position
+ * @param offset First source byte to copy
+ * @param count Number of bytes to copy
+ * @return Error code (STEG_SUCCESS once all count bytes are copied)
+ * 
+ * File descriptor counterpart of steg_copy_remaining(), with the same
+ * copy_file_range(), sendfile() and buffered fallbacks.
+ */
+int steg_copy_range(int in_fd, int out_fd, off_t offset, off_t count);
+
+/**
+ * @brief Create dst as a copy of src, sharing extents where possible
+ * 
+ * @param src Path of the source file
+ * @param dst Path of the destination file (created or truncated)
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Tries an FICLONE reflink first (btrfs, XFS, ...), which makes the
+ * copy O(1) in I/O; otherwise falls back to the same kernel copy path
+ * as steg_copy_remaining(). If src and dst are the same file nothing
+ * is copied.
+ */
+int steg_clone_file(const char* src, const char* dst);
+
+/**
+ * @brief Get the method used by the last copy or clone on the calling thread
+ * 
+ * @return One of the STEG_COPY_* values, or 0 if nothing has been
+ *         copied yet
+ */
+int steg_last_copy_method(void);
+
+/**
+ * @brief Get a printable name for a STEG_COPY_* method
+ * 
+ * @param method Copy method
+ * @return Static string such as "reflink" or "copy_file_range"
+ */
+const char* steg_copy_method_name(int method);
+
+// ============================================================================
+// I/O BACKENDS
+// ============================================================================
+
+/**
+ * @brief Write all of size bytes to fd at offset, retrying short writes
+ * 
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int steg_pwrite_all(int fd, const unsigned char* data, size_t size, off_t offset);
+
+/**
+ * @brief Read up to size bytes from fd at offset, retrying short reads
+ * 
+ * @return Number of bytes read (less than size only at end of file),
+ *         or -1 on error
+ */
+ssize_t steg_pread_all(int fd, unsigned char* data, size_t size, off_t offset);
+
+/** @brief Buffered stdio streams (default) */
+#define STEG_IO_STDIO 0
+
+/** @brief Memory-mapped input, output written from the mapping */
+#define STEG_IO_MMAP 1
+
+/** @brief Positional pread()/pwrite() on the underlying descriptors */
+#define STEG_IO_PREAD 2
+
+/**
+ * @brief Select the I/O backend used by the BMP handler
+ * 
+ * @param backend One of the STEG_IO_* values
+ * @return Error code (STEG_SUCCESS, or STEG_INVALID_ARGUMENT)
+ * 
+ * Process-wide like the settings in steg.h: select it before other
+ * threads call into the library.
+ */
+int steg_set_io_backend(int backend);
+
+/**
+ * @brief Get the I/O backend used by the BMP handler
+ * 
+ * @return One of the STEG_IO_* values
+ */
+int steg_get_io_backend(void);
+
+/**
+ * @brief Look up an I/O backend by name
+ * 
+ * @param name "stdio", "mmap" or "pread"
+ * @return One of the STEG_IO_* values, or -1 if the name is unknown
+ */
+int steg_parse_io_backend(const char* name);
+
+/**
+ * @brief Get a printable name for an I/O backend
+ * 
+ * @param backend One of the STEG_IO_* values
+ * @return Static string such as "mmap"
+ */
+const char* steg_io_backend_name(int backend);
+
+/**
+ * @brief Prefault mappings made by the mmap backend (MAP_POPULATE)
+ * 
+ * @param enabled Non-zero to populate mappings up front
+ */
+void steg_set_mmap_populate(int enabled);
+
+/**
+ * @brief Embed a binary payload into a BMP image with the selected backend
+ * 
+ * @param payload Bytes to embed
+ * @param length Number of bytes at payload
+ * @param input Input BMP file stream
+ * @param output Output BMP file stream
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Dispatches to embed_payload(), embed_payload_mmap() or
+ * embed_payload_pread() according to steg_get_io_backend(). The
+ * payload may contain NULs.
+ */
+int embed_payload_io(const unsigned char* payload, size_t length, FILE* input, FILE* output);
+
+/**
+ * @brief Embed a binary payload into a BMP image using a memory mapping
+ * 
+ * @param payload Bytes to embed
+ * @param length Number of bytes at payload
+ * @param input Input BMP file stream (must be a regular file)
+ * @param output Output BMP file stream
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * The input is mapped privately, the header is parsed from the
+ * mapping and the kernel patches the mapped pixel array; only the
+ * touched pages are copied. The output is written from the mapping.
+ */
+int embed_payload_mmap(const unsigned char* payload, size_t length, FILE* input, FILE* output);
+
+/**
+ * @brief Embed a message into a BMP image using a memory mapping
+ * 
+ * @param message The ASCII text message to embed
+ * @param input Input BMP file stream (must be a regular file)
+ * @param output Output BMP file stream
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Equivalent to embed_payload_mmap() with the message's strlen().
+ */
+int embed_message_mmap(const char* message, FILE* input, FILE* output);
+
+/**
+ * @brief Extract a hidden message from a memory-mapped BMP image
+ * 
+ * @param buffer Output buffer to store the extracted message
+ * @param max_len Maximum length of the buffer
+ * @param input Input BMP file stream (must be a regular file)
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int extract_message_mmap(char* buffer, size_t max_len, FILE* input);
+
+/**
+ * @brief Embed a binary payload into a BMP image with pread()/pwrite()
+ * 
+ * @param payload Bytes to embed
+ * @param length Number of bytes at payload
+ * @param input Input BMP file stream
+ * @param output Output BMP file stream
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Copies the whole image in block-sized positional reads and writes,
+ * bypassing stdio buffering.
+ */
+int embed_payload_pread(const unsigned char* payload, size_t length, FILE* input, FILE* output);
+
+/**
+ * @brief Embed a message into a BMP image with pread()/pwrite()
+ * 
+ * @param message The ASCII text message to embed
+ * @param input Input BMP file stream
+ * @param output Output BMP file stream
+ * @return Error code (STEG_SUCCESS on success)
+ * 
+ * Equivalent to embed_payload_pread() with the message's strlen().
+ */
+int embed_message_pread(const char* message, FILE* input, FILE* output);
+
+/**
+ * @brief Extract a hidden message from a BMP image with pread()
+ * 
+ * @param buffer Output buffer to store the extracted message
+ * @param max_len Maximum length of the buffer
+ * @param input Input BMP file stream
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int extract_message_pread(char* buffer, size_t max_len, FILE* input);
+
+#endif // STEG_IO_H
@@ -0,0 +1,250 @@
+/**
+ * @file steg_kernels.h
+ * @brief LSB Steganography Tool - Bit Embedding Kernels
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ * 
+ * In-memory kernels that move payload bits into and out of the least
+ * significant bits of pixel bytes. All I/O backends run these over
+ * blocks of pixel data they have already read or mapped.
+ * 
+ * The kernel is selected at startup from the CPU features (scalar,
+ * SSE2, AVX2, AVX-512). Set STEG_KERNEL=scalar|sse2|avx2|avx512 to
+ * force a path for benchmarking.
+ */
+
+#ifndef STEG_KERNELS_H
+#define STEG_KERNELS_H
+
+#include <stddef.h>
+
+/** @brief Payload bytes decoded between terminator checks in lsb_extract_string() */
+#define LSB_STRING_STEP 64
+
+/** @brief Largest supported number of payload bits per pixel byte */
+#define LSB_MAX_BITS 4
+
+/**
+ * @brief One implementation of the embed/extract kernel pair
+ */
+typedef struct {
+    const char* name;   ///< Kernel name ("scalar", "sse2", "avx2", "avx512")
+    void (*embed)(unsigned char* pixels, const unsigned char* payload, size_t payload_len);
+    void (*extract)(const unsigned char* pixels, unsigned char* payload, size_t payload_len);
+    size_t (*find_nul)(const unsigned char* data, size_t len); ///< Index of first NUL, or len
+    void (*pack)(const unsigned char* pixels, unsigned char* channels, size_t count, int skip);
+    void (*unpack)(const unsigned char* channels, unsigned char* pixels, size_t count, int skip);
+} lsb_kernel_t;
+
+/**
+ * @brief Get the kernel selected for this process
+ * 
+ * @return Active kernel (never NULL)
+ */
+const lsb_kernel_t* lsb_active_kernel(void);
+
+/**
+ * @brief Force a kernel by name
+ * 
+ * @param name Kernel name, e.g. "avx2"
+ * @return 0 on success, -1 if unknown or not supported by this CPU
+ */
+int lsb_set_kernel(const char* name);
+
+/**
+ * @brief Embed payload bytes into pixel LSBs
+ * 
+ * @param pixels Pixel bytes, 8 per payload byte, modified in place
+ * @param payload Payload bytes to embed
+ * @param payload_len Number of payload bytes
+ * 
+ * Each payload byte is spread over 8 consecutive pixel bytes, most
+ * significant bit first. Runs the kernel selected at startup.
+ */
+void lsb_embed_block(unsigned char* pixels, const unsigned char* payload, size_t payload_len);
+
+/**
+ * @brief Portable reference implementation of lsb_embed_block()
+ */
+void lsb_embed_block_scalar(unsigned char* pixels, const unsigned char* payload, size_t payload_len);
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * @brief SSE2 lsb_embed_block(): 2 payload bytes per 16-byte vector
+ */
+void lsb_embed_block_sse2(unsigned char* pixels, const unsigned char* payload, size_t payload_len);
+
+/**
+ * @brief AVX2 lsb_embed_block(): 4 payload bytes per 32-byte vector
+ * 
+ * Only call on CPUs that support AVX2.
+ */
+void lsb_embed_block_avx2(unsigned char* pixels, const unsigned char* payload, size_t payload_len);
+
+/**
+ * @brief AVX-512 lsb_embed_block(): 8 payload bytes per 64-byte vector
+ * 
+ * Only call on CPUs that support AVX512F and AVX512BW.
+ */
+void lsb_embed_block_avx512(unsigned char* pixels, const unsigned char* payload, size_t payload_len);
+#endif
+
+/**
+ * @brief Extract payload bytes from pixel LSBs
+ * 
+ * @param pixels Pixel bytes, 8 per payload byte
+ * @param payload Output buffer for payload_len bytes
+ * @param payload_len Number of payload bytes to rebuild
+ * 
+ * Runs the kernel selected at startup.
+ */
+void lsb_extract_block(const unsigned char* pixels, unsigned char* payload, size_t payload_len);
+
+/**
+ * @brief Portable reference implementation of lsb_extract_block()
+ */
+void lsb_extract_block_scalar(const unsigned char* pixels, unsigned char* payload, size_t payload_len);
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * @brief SSE2 lsb_extract_block(): pmovmskb gathers 16 LSBs per step
+ */
+void lsb_extract_block_sse2(const unsigned char* pixels, unsigned char* payload, size_t payload_len);
+
+/**
+ * @brief AVX2 lsb_extract_block(): pmovmskb gathers 32 LSBs per step
+ * 
+ * Only call on CPUs that support AVX2.
+ */
+void lsb_extract_block_avx2(const unsigned char* pixels, unsigned char* payload, size_t payload_len);
+
+/**
+ * @brief AVX-512 lsb_extract_block(): 64 LSBs per step into a mask register
+ * 
+ * Only call on CPUs that support AVX512F and AVX512BW.
+ */
+void lsb_extract_block_avx512(const unsigned char* pixels, unsigned char* payload, size_t payload_len);
+#endif
+
+/**
+ * @brief Pack 4-byte pixels into their colour channel bytes
+ * 
+ * @param pixels count pixels of 4 bytes each (e.g. BGRA)
+ * @param channels Output buffer for count * 3 bytes
+ * @param count Number of pixels
+ * @param skip Byte of each pixel to drop (the alpha or unused byte, 0-3)
+ * 
+ * Lets 32-bpp images run through the same byte-stream kernels as
+ * 24-bit ones while alpha is never part of the stream. Runs the
+ * kernel selected at startup.
+ */
+void lsb_pack_channels(const unsigned char* pixels, unsigned char* channels, size_t count, int skip);
+
+/**
+ * @brief Write colour channel bytes back into 4-byte pixels
+ * 
+ * @param channels count * 3 channel bytes from lsb_pack_channels()
+ * @param pixels count pixels of 4 bytes each, updated in place
+ * @param count Number of pixels
+ * @param skip Byte of each pixel that is left untouched (0-3)
+ * 
+ * Inverse of lsb_pack_channels(). The skipped byte is masked out with
+ * a fixed vector mask, so alpha survives bit for bit.
+ */
+void lsb_unpack_channels(const unsigned char* channels, unsigned char* pixels, size_t count, int skip);
+
+/**
+ * @brief Portable reference implementations of the channel pack/unpack pair
+ */
+void lsb_pack_channels_scalar(const unsigned char* pixels, unsigned char* channels, size_t count, int skip);
+void lsb_unpack_channels_scalar(const unsigned char* channels, unsigned char* pixels, size_t count, int skip);
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * @brief AVX2 channel pack/unpack: 8 pixels per step (vpshufb + dword permute)
+ * 
+ * Only call on CPUs that support AVX2.
+ */
+void lsb_pack_channels_avx2(const unsigned char* pixels, unsigned char* channels, size_t count, int skip);
+void lsb_unpack_channels_avx2(const unsigned char* channels, unsigned char* pixels, size_t count, int skip);
+
+/**
+ * @brief AVX-512 channel pack/unpack: 16 pixels per step, masked stores
+ * 
+ * Only call on CPUs that support AVX512F and AVX512BW.
+ */
+void lsb_pack_channels_avx512(const unsigned char* pixels, unsigned char* channels, size_t count, int skip);
+void lsb_unpack_channels_avx512(const unsigned char* channels, unsigned char* pixels, size_t count, int skip);
+#endif
+
+/**
+ * @brief Pixel bytes needed to carry a payload
+ * 
+ * @param payload_len Number of payload bytes
+ * @param bits Payload bits per pixel byte (1-LSB_MAX_BITS)
+ * @return Number of pixel bytes, rounded up
+ */
+size_t lsb_pixels_for(size_t payload_len, int bits);
+
+/**
+ * @brief Payload bytes that fit completely in a run of pixel bytes
+ * 
+ * @param pixel_bytes Number of pixel bytes
+ * @param bits Payload bits per pixel byte (1-LSB_MAX_BITS)
+ * @return Number of whole payload bytes
+ */
+size_t lsb_payload_for(size_t pixel_bytes, int bits);
+
+/**
+ * @brief Embed payload bytes using the low bits of each pixel byte
+ * 
+ * @param kernel Kernel for the 1-bit layout, e.g. lsb_active_kernel()
+ * @param pixels Pixel bytes, modified in place
+ * @param payload Payload bytes to embed
+ * @param payload_len Number of payload bytes
+ * @param bits Payload bits per pixel byte (1-LSB_MAX_BITS)
+ * 
+ * The payload is treated as one bit stream, most significant bit
+ * first; pixel byte k carries stream bits [k * bits, (k + 1) * bits)
+ * in its low bits, earliest bit highest. bits = 1 is the classic
+ * layout and runs the SIMD kernel; 2-4 run kernels specialised per
+ * depth at compile time. pixels must start on a group boundary, i.e.
+ * at a multiple of 8 pixel bytes (bits payload bytes) into the stream.
+ */
+void lsb_embed(const lsb_kernel_t* kernel, unsigned char* pixels, const unsigned char* payload, size_t payload_len,
+               int bits);
+
+/**
+ * @brief Extract payload bytes from the low bits of each pixel byte
+ * 
+ * @param kernel Kernel for the 1-bit layout
+ * @param pixels Pixel bytes
+ * @param payload Output buffer for payload_len bytes
+ * @param payload_len Number of payload bytes to rebuild
+ * @param bits Payload bits per pixel byte (1-LSB_MAX_BITS)
+ * 
+ * Inverse of lsb_embed(), with the same alignment rule.
+ */
+void lsb_extract(const lsb_kernel_t* kernel, const unsigned char* pixels, unsigned char* payload,
+                 size_t payload_len, int bits);
+
+/**
+ * @brief Extract a NUL-terminated payload from pixel low bits
+ * 
+ * @param kernel Kernel for the 1-bit layout and the terminator search
+ * @param pixels Pixel bytes
+ * @param payload Output buffer for up to payload_len bytes
+ * @param payload_len Maximum number of payload bytes to rebuild
+ * @param bits Payload bits per pixel byte (1-LSB_MAX_BITS)
+ * @return Index of the terminator, or payload_len if none was found
+ * 
+ * Decodes about LSB_STRING_STEP bytes at a time and checks each step
+ * for the terminator with a vector compare, so short messages stop
+ * early. Bytes after the terminator within the last step may be
+ * written.
+ */
+size_t lsb_extract_string(const lsb_kernel_t* kernel, const unsigned char* pixels, unsigned char* payload,
+                          size_t payload_len, int bits);
+
+#endif // STEG_KERNELS_H
@@ -0,0 +1,91 @@
+/**
+ * @file steg_multipart.h
+ * @brief LSB Steganography Tool - Streaming multipart/form-data Parser
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * Splits a multipart/form-data request body into its parts while it is
+ * still arriving. The body is fed in chunks of any size, and each part's
+ * data is handed on as soon as it cannot be the start of the next
+ * boundary, so an upload is never buffered twice: the caller decides
+ * where the bytes of each part go.
+ */
+
+#ifndef STEG_MULTIPART_H
+#define STEG_MULTIPART_H
+
+#include <stddef.h>
+
+/** @brief Longest boundary RFC 2046 allows */
+#define STEG_MULTIPART_MAX_BOUNDARY 70
+
+/** @brief Largest block of headers accepted for one part */
+#define STEG_MULTIPART_MAX_HEADERS 2048
+
+/** @brief Longest field name or file name kept for a part */
+#define STEG_MULTIPART_MAX_NAME 256
+
+/**
+ * @brief Callbacks of a multipart parser
+ *
+ * Each returns STEG_SUCCESS to go on or an error code that aborts the
+ * parse and is returned by steg_multipart_feed().
+ */
+typedef struct {
+    /** A part begins; filename is "" for a plain form field */
+    int (*part_begin)(void* ctx, const char* name, const char* filename);
+    /** More bytes of the current part */
+    int (*part_data)(void* ctx, const unsigned char* data, size_t length);
+    /** The current part is complete */
+    int (*part_end)(void* ctx);
+} steg_multipart_callbacks_t;
+
+/**
+ * @brief Parser state; fill it with steg_multipart_init()
+ */
+typedef struct {
+    steg_multipart_callbacks_t callbacks;
+    void* ctx;
+    char delimiter[STEG_MULTIPART_MAX_BOUNDARY + 5]; /**< CRLF, "--" and the boundary */
+    size_t delimiter_length;
+    size_t matched;                                  /**< Delimiter bytes seen at the end of the input so far */
+    int state;
+    char headers[STEG_MULTIPART_MAX_HEADERS];        /**< Headers of the part being read */
+    size_t headers_length;
+} steg_multipart_t;
+
+/**
+ * @brief Set up a parser for a request body
+ *
+ * @param parser Parser to set up
+ * @param content_type Content-Type header of the request, which carries
+ *        the boundary
+ * @param callbacks Where the parts go
+ * @param ctx Passed to every callback
+ * @return STEG_SUCCESS, or STEG_INVALID_ARGUMENT if the content type is
+ *         not multipart/form-data with a valid boundary
+ */
+int steg_multipart_init(steg_multipart_t* parser, const char* content_type,
+                        const steg_multipart_callbacks_t* callbacks, void* ctx);
+
+/**
+ * @brief Feed the next bytes of the body
+ *
+ * @param parser Parser from steg_multipart_init()
+ * @param data Body bytes
+ * @param length Number of bytes
+ * @return STEG_SUCCESS, STEG_INVALID_ARGUMENT on a malformed body, or
+ *         the error a callback returned
+ */
+int steg_multipart_feed(steg_multipart_t* parser, const unsigned char* data, size_t length);
+
+/**
+ * @brief Check that the body ended with its closing boundary
+ *
+ * @param parser Parser that has been fed the whole body
+ * @return STEG_SUCCESS, or STEG_INVALID_ARGUMENT if the body was cut short
+ */
+int steg_multipart_finish(const steg_multipart_t* parser);
+
+#endif // STEG_MULTIPART_H
@@ -0,0 +1,78 @@
+/**
+ * @file steg_pipeline.h
+ * @brief LSB Steganography Tool - Read/Process/Write Block Pipeline
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * Runs a stream of blocks through three stages: a reader thread loads
+ * block n + 1 while the caller processes block n and a writer thread
+ * stores block n - 1. The stages are connected by a bounded ring of
+ * equally sized block buffers, so disk reads, the LSB kernels and disk
+ * writes overlap and memory use stays fixed.
+ *
+ * The pipeline knows nothing about images: the stages are callbacks.
+ * The BMP engine drives it with its strip cursor; a handler that
+ * decodes pixels (see formats.c) would load and decode in its read
+ * stage and encode and save in its write stage.
+ */
+
+#ifndef STEG_PIPELINE_H
+#define STEG_PIPELINE_H
+
+#include <stddef.h>
+
+/** @brief Returned by the process stage: this block is the last one to write */
+#define STEG_PIPELINE_LAST 1
+
+/**
+ * @brief One block slot of the ring
+ */
+typedef struct {
+    unsigned char* data; /**< Slot storage, block_size bytes */
+    size_t slot;         /**< Index of the slot, for per-slot caller state */
+    size_t sequence;     /**< Position of the block in the stream, from 0 */
+    size_t length;       /**< Bytes loaded by the read stage; 0 ends the stream */
+} steg_block_t;
+
+/**
+ * @brief Stage callback
+ *
+ * @param ctx Caller context given in steg_pipeline_t
+ * @param block Block to load, process or store
+ * @return Error code (STEG_SUCCESS on success); the process stage may
+ *         also return STEG_PIPELINE_LAST
+ */
+typedef int (*steg_stage_fn)(void* ctx, steg_block_t* block);
+
+/**
+ * @brief Stages and buffers of a pipeline run
+ */
+typedef struct {
+    size_t depth;          /**< Block slots in the ring */
+    size_t block_size;     /**< Bytes per slot */
+    steg_stage_fn read;    /**< Loads the next block, run on the reader thread */
+    steg_stage_fn process; /**< Transforms a block, run on the calling thread */
+    steg_stage_fn write;   /**< Stores a block, run on the writer thread */
+    void* ctx;             /**< Passed to every stage */
+} steg_pipeline_t;
+
+/**
+ * @brief Run every block of a stream through the pipeline
+ *
+ * @param pipeline Stages and buffers
+ * @return First error reported by a stage, or STEG_SUCCESS
+ *
+ * Each stage sees the blocks one at a time and in stream order. The
+ * stream ends when the read stage returns a block of length 0 or the
+ * process stage returns STEG_PIPELINE_LAST; blocks read ahead past that
+ * point are dropped without being processed or written. After an error
+ * no further blocks are started. With a depth below 2, or when the
+ * threads cannot be started, the stages run in turn on the caller.
+ *
+ * The reader and writer threads are reused from run to run; a new pair
+ * is only started when every existing pair is serving another run.
+ */
+int steg_pipeline_run(const steg_pipeline_t* pipeline);
+
+#endif // STEG_PIPELINE_H
@@ -0,0 +1,197 @@
+/**
+ * @file stegd.h
+ * @brief LSB Steganography Tool - stegd Daemon Protocol
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * stegd is a long-running daemon that serves embed, extract and
+ * capacity requests over a Unix domain socket, so a caller pays for
+ * process startup and handler lookup once instead of per image.
+ *
+ * The protocol is a fixed-size request header, the image bytes and
+ * then the payload bytes; the daemon answers with a fixed-size response
+ * header and its data (the stego image for embed, the payload for
+ * extract, nothing for capacity). Integers are little-endian. A
+ * connection may carry any number of requests, answered in order.
+ *
+ * Large images need not travel through the socket at all: a client may
+ * pass the image as a file descriptor (a regular file or a memfd) with
+ * SCM_RIGHTS and ask for the result back as a sealed memfd, so only the
+ * headers and the payload are copied.
+ */
+
+#ifndef STEGD_H
+#define STEGD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Socket path used when none is given */
+#define STEGD_DEFAULT_SOCKET "/tmp/stegd.sock"
+
+/** @brief First bytes of every request and response header */
+#define STEGD_MAGIC "STGD"
+
+/** @brief Protocol version carried in every header */
+#define STEGD_VERSION 1
+
+/** @brief Size of an encoded request header */
+#define STEGD_REQUEST_SIZE 24
+
+/** @brief Size of an encoded response header */
+#define STEGD_RESPONSE_SIZE 28
+
+/** @brief Largest image the daemon accepts by default (256 MiB) */
+#define STEGD_DEFAULT_MAX_IMAGE (256 * 1024 * 1024)
+
+/** @brief Hide the payload in the image and return the stego image */
+#define STEGD_OP_EMBED 1
+
+/** @brief Return the payload hidden in the image */
+#define STEGD_OP_EXTRACT 2
+
+/** @brief Return the capacity of the image in bytes */
+#define STEGD_OP_CAPACITY 3
+
+/** @brief Request: the image is the file descriptor sent with the header, not inline bytes */
+#define STEGD_FLAG_IMAGE_FD 0x01
+
+/** @brief Request: return the data as a memfd; response: a memfd came with the header */
+#define STEGD_FLAG_OUTPUT_FD 0x02
+
+/** @brief Let the daemon recognise the format from the image's signature */
+#define STEGD_FORMAT_AUTO 0
+
+/** @brief Image formats, one per handler in formats.c */
+#define STEGD_FORMAT_BMP 1
+#define STEGD_FORMAT_PNG 2
+#define STEGD_FORMAT_JPEG 3
+
+/** @brief One past the highest format number */
+#define STEGD_FORMAT_COUNT 4
+
+/**
+ * @brief Decoded request header
+ *
+ * Followed on the wire by image_length image bytes (unless
+ * STEGD_FLAG_IMAGE_FD is set) and payload_length payload bytes (embed
+ * only).
+ */
+typedef struct {
+    uint8_t op;              /**< One of the STEGD_OP_* values */
+    uint8_t format;          /**< One of the STEGD_FORMAT_* values */
+    uint8_t flags;           /**< STEGD_FLAG_* bits */
+    uint64_t image_length;   /**< Bytes of image; with an image fd, the bytes
+                                  to use from its start (0 for all of it) */
+    uint64_t payload_length; /**< Bytes of payload after the image */
+} stegd_request_t;
+
+/**
+ * @brief Decoded response header
+ *
+ * Followed on the wire by data_length bytes of data, unless the data
+ * came as a memfd (STEGD_FLAG_OUTPUT_FD).
+ */
+typedef struct {
+    uint8_t op;           /**< Operation being answered */
+    uint8_t flags;        /**< STEGD_FLAG_OUTPUT_FD when a memfd holds the data */
+    int32_t status;       /**< STEG_SUCCESS or a STEG_* error code */
+    uint64_t value;       /**< Capacity for STEGD_OP_CAPACITY, 0 otherwise */
+    uint64_t data_length; /**< Bytes of data */
+} stegd_response_t;
+
+/**
+ * @brief Encode a request header
+ *
+ * @param request Request to encode
+ * @param out Destination of STEGD_REQUEST_SIZE bytes
+ */
+void stegd_encode_request(const stegd_request_t* request, unsigned char* out);
+
+/**
+ * @brief Decode a request header
+ *
+ * @param in STEGD_REQUEST_SIZE bytes
+ * @param request Receives the request
+ * @return STEG_SUCCESS, or STEG_INVALID_ARGUMENT on a bad magic or version
+ */
+int stegd_decode_request(const unsigned char* in, stegd_request_t* request);
+
+/**
+ * @brief Encode a response header
+ *
+ * @param response Response to encode
+ * @param out Destination of STEGD_RESPONSE_SIZE bytes
+ */
+void stegd_encode_response(const stegd_response_t* response, unsigned char* out);
+
+/**
+ * @brief Decode a response header
+ *
+ * @param in STEGD_RESPONSE_SIZE bytes
+ * @param response Receives the response
+ * @return STEG_SUCCESS, or STEG_INVALID_ARGUMENT on a bad magic or version
+ */
+int stegd_decode_response(const unsigned char* in, stegd_response_t* response);
+
+/**
+ * @brief Protocol format number of a format handler
+ *
+ * @param name Handler name, such as "PNG"
+ * @return One of the STEGD_FORMAT_* values, or STEGD_FORMAT_AUTO if
+ *         there is none
+ */
+int stegd_format_for_name(const char* name);
+
+/**
+ * @brief Connect to a stegd socket
+ *
+ * @param path Socket path
+ * @return Connected socket, or -1 on failure
+ */
+int stegd_connect(const char* path);
+
+/**
+ * @brief Send one request and wait for its response
+ *
+ * @param fd Socket from stegd_connect()
+ * @param request Request header; its lengths give the bytes sent
+ * @param image Image bytes
+ * @param payload Payload bytes (may be NULL when payload_length is 0)
+ * @param response Receives the response header
+ * @param data Receives the response data (malloc'd, freed by the
+ *        caller), or NULL when there is none
+ * @return STEG_SUCCESS once a response has been received (its status
+ *         says how the request went), or an error code when the
+ *         exchange itself failed
+ */
+int stegd_call(int fd, const stegd_request_t* request, const unsigned char* image,
+               const unsigned char* payload, stegd_response_t* response, unsigned char** data);
+
+/**
+ * @brief Send one request, passing and receiving file descriptors
+ *
+ * @param fd Socket from stegd_connect()
+ * @param request Request header; its flags are set from image_fd and output_fd
+ * @param image_fd Image to pass with SCM_RIGHTS, or -1 to send image bytes
+ * @param image Image bytes when image_fd is -1
+ * @param payload Payload bytes (may be NULL when payload_length is 0)
+ * @param response Receives the response header
+ * @param data Receives the response data when it came inline (malloc'd,
+ *        freed by the caller), or NULL
+ * @param output_fd Where to receive the data as a sealed memfd (closed by
+ *        the caller), or NULL for inline data; set to -1 when the
+ *        response carries none
+ * @return As for stegd_call()
+ *
+ * The image never crosses the socket, so multi-hundred-megabyte images
+ * cost no socket copies. Seal a memfd with F_SEAL_SHRINK and F_SEAL_GROW
+ * to let the daemon map it; any other fd is read into a private buffer.
+ * The memfd it returns can be mapped or copied on by the kernel.
+ */
+int stegd_call_fd(int fd, const stegd_request_t* request, int image_fd, const unsigned char* image,
+                  const unsigned char* payload, stegd_response_t* response, unsigned char** data,
+                  int* output_fd);
+
+#endif // STEGD_H
@@ -0,0 +1,145 @@
+/**
+ * @file thread_pool.h
+ * @brief LSB Steganography Tool - Thread Pool
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * A fixed set of worker threads that run "parallel for" jobs: a job
+ * is one function called once per task index, and the submitting
+ * thread works on the job too and returns once every task has run.
+ *
+ * Scheduling is work-stealing: each worker queues the tasks of the
+ * jobs it submits on its own deque and idle workers steal from the
+ * others. Jobs may be submitted from inside a task, so a batch job
+ * running on one worker can split a large image into stripe tasks
+ * that the rest of the pool picks up. A thread that never works on
+ * jobs itself, such as the stegd event loop, can also hand the pool
+ * single detached tasks.
+ *
+ * The engine uses it to cut pixel runs into stripes. Payload bit i
+ * always lands at a known pixel offset, so each stripe embeds or
+ * extracts its own slice of the payload independently and the output
+ * is byte-identical to a single-threaded run.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+/**
+ * @brief Opaque thread pool
+ */
+typedef struct steg_thread_pool steg_thread_pool_t;
+
+/**
+ * @brief Per-worker counters of a pool
+ */
+typedef struct {
+    unsigned long long tasks;  /**< Tasks run by this worker */
+    unsigned long long stolen; /**< Tasks taken from another worker's deque */
+    double busy_seconds;       /**< Time spent running tasks */
+} steg_worker_stats_t;
+
+/**
+ * @brief Task body, called once for every index of a job
+ *
+ * @param arg Job argument given to steg_thread_pool_run()
+ * @param index Task index, in [0, tasks)
+ */
+typedef void (*steg_task_fn)(void* arg, size_t index);
+
+/**
+ * @brief Create a thread pool
+ *
+ * @param threads Total threads working on a job, including the caller
+ *        (threads - 1 workers are started)
+ * @return New pool, or NULL on failure
+ */
+steg_thread_pool_t* steg_thread_pool_create(int threads);
+
+/**
+ * @brief Stop the workers and free the pool
+ */
+void steg_thread_pool_destroy(steg_thread_pool_t* pool);
+
+/**
+ * @brief Number of threads working on a job, including the caller
+ */
+int steg_thread_pool_threads(const steg_thread_pool_t* pool);
+
+/**
+ * @brief Run fn(arg, index) for every index in [0, tasks) and wait
+ *
+ * @param pool Pool to run on; NULL runs every task on the caller
+ * @param tasks Number of tasks
+ * @param fn Task body
+ * @param arg Argument passed to every call
+ *
+ * May be called from inside a task to split it further; the caller
+ * then runs only tasks of its own job while it waits. A thread from
+ * outside the pool works as worker 0; several may submit at once and
+ * then share that worker's deque and counters.
+ */
+void steg_thread_pool_run(steg_thread_pool_t* pool, size_t tasks, steg_task_fn fn, void* arg);
+
+/**
+ * @brief Queue fn(arg, 0) to run on a worker thread and return at once
+ *
+ * @param pool Pool to run on; it must have at least one worker thread
+ * @param fn Task body
+ * @param arg Argument passed to fn
+ * @return STEG_SUCCESS, STEG_INVALID_ARGUMENT without worker threads,
+ *         or STEG_MEMORY_ERROR when the task cannot be queued
+ *
+ * Nothing waits for the task; it must report its own completion. The
+ * caller counts as the outside submitter of steg_thread_pool_run() and
+ * must not run jobs on the pool itself. Tasks still queued when the
+ * pool is destroyed are dropped.
+ */
+int steg_thread_pool_submit(steg_thread_pool_t* pool, steg_task_fn fn, void* arg);
+
+/**
+ * @brief Index of the worker the calling thread is running a task as
+ *
+ * @return Worker index, in [0, threads); 0 for the outside thread
+ *         while it works on a job, and -1 outside of any job
+ *
+ * Lets tasks pick per-worker state, such as a steg_ctx_t, without
+ * locking: no two tasks run as the same worker at once, as long as a
+ * single outside thread submits jobs.
+ */
+int steg_thread_pool_current_worker(void);
+
+/**
+ * @brief Copy the per-worker counters
+ *
+ * Counters are updated atomically, so they may be read while jobs run;
+ * worker 0 counts the tasks of every outside submitter.
+ *
+ * @param pool Pool to query (NULL yields no workers)
+ * @param stats Receives one entry per worker, worker 0 first
+ * @param max Number of entries stats can hold
+ * @return Number of entries written
+ */
+int steg_thread_pool_stats(const steg_thread_pool_t* pool, steg_worker_stats_t* stats, int max);
+
+/**
+ * @brief Zero the per-worker counters
+ */
+void steg_thread_pool_reset_stats(steg_thread_pool_t* pool);
+
+/**
+ * @brief Process-wide pool sized by steg_get_threads()
+ *
+ * @return Shared pool, or NULL when a single thread is configured
+ *
+ * Created on first use and rebuilt when the thread count changes.
+ * Safe to call from any thread. A pool that is replaced stays alive,
+ * so callers still using it can finish their jobs. Every pool is
+ * released at exit.
+ */
+steg_thread_pool_t* steg_thread_pool_shared(void);
+
+#endif // THREAD_POOL_H
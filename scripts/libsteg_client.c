@@ -0,0 +1,182 @@
+/**
+ * @file libsteg_client.c
+ * @brief LSB Steganography Tool - libsteg In-Memory Check
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * Used by roundtrip_test.sh. Links against libsteg.a and round-trips a
+ * payload through the library's in-memory entry points, never handing
+ * it a file: "bmp" embeds a binary payload into a BMP with
+ * embed_payload_buffer() and writes the stego image so the script can
+ * compare it with steg_cli's; "text" embeds a text message through the
+ * handler of any supported format with format_embed_alloc(); "ctx"
+ * embeds and extracts through one steg_ctx_t several times and checks
+ * that the warmed-up context no longer takes memory from the heap.
+ *
+ * Usage: libsteg_client bmp|ctx <image.bmp> <payload> <output.bmp>
+ *        libsteg_client text <image> <message>
+ */
+
+#include "../include/steg.h"
+#include "../include/formats.h"
+#include "../include/steg_ctx.h"
+
+// Calls made on one context; the first one sizes its arena
+#define CTX_ROUNDS 3
+
+// Read a whole file into a malloc'd buffer
+static unsigned char* read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    unsigned char* data = NULL;
+    
+    *size = 0;
+    if (!file) {
+        return NULL;
+    }
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long length = ftell(file);
+        rewind(file);
+        data = length >= 0 ? malloc((size_t)length + 1) : NULL;
+        if (data && fread(data, 1, (size_t)length, file) == (size_t)length) {
+            *size = (size_t)length;
+        } else {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    return data;
+}
+
+// Write a buffer to a file
+static int write_file(const char* path, const unsigned char* data, size_t size) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        return 0;
+    }
+    int written = fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && written;
+}
+
+// Embed with embed_payload_buffer() and extract with extract_payload_buffer()
+static int run_bmp(unsigned char* image, size_t image_size, const unsigned char* payload,
+                   size_t payload_size, const char* output) {
+    size_t length = 0;
+    unsigned char* extracted = malloc(payload_size + 1);
+    
+    int result = extracted ? embed_payload_buffer(payload, payload_size, image, image_size) : STEG_MEMORY_ERROR;
+    if (result == STEG_SUCCESS) {
+        result = extract_payload_buffer(extracted, payload_size + 1, &length, image, image_size);
+    }
+    if (result == STEG_SUCCESS && (length != payload_size || memcmp(extracted, payload, payload_size) != 0)) {
+        fprintf(stderr, "libsteg_client: payload did not survive the in-memory round trip\n");
+        result = STEG_FILE_ERROR;
+    }
+    if (result == STEG_SUCCESS && !write_file(output, image, image_size)) {
+        result = STEG_FILE_ERROR;
+    }
+    free(extracted);
+    return result;
+}
+
+// Embed and extract a text message through a format handler's buffer entry points
+static int run_text(const char* path, const unsigned char* image, size_t image_size, const char* message) {
+    const format_handler_t* handler = get_format_handler(path);
+    unsigned char* stego = NULL;
+    char* extracted = NULL;
+    size_t stego_size = 0;
+    size_t length = 0;
+    
+    if (!handler) {
+        fprintf(stderr, "libsteg_client: no handler for %s\n", path);
+        return STEG_INVALID_BMP;
+    }
+    
+    int result = format_embed_alloc(handler, image, image_size, message, &stego, &stego_size);
+    if (result == STEG_SUCCESS) {
+        result = format_extract_alloc(handler, stego, stego_size, &extracted, &length);
+    }
+    if (result == STEG_SUCCESS && (length != strlen(message) || strcmp(extracted, message) != 0)) {
+        fprintf(stderr, "libsteg_client: %s message did not survive the round trip\n", handler->name);
+        result = STEG_FILE_ERROR;
+    }
+    free(stego);
+    free(extracted);
+    return result;
+}
+
+// Embed and extract CTX_ROUNDS times through one context
+static int run_ctx(const unsigned char* image, size_t image_size, const unsigned char* payload,
+                   size_t payload_size, const char* output) {
+    steg_ctx_t* ctx = steg_ctx_create(0);
+    unsigned char* stego = malloc(image_size);
+    steg_ctx_stats_t stats;
+    unsigned long long warm_allocations = 0;
+    int result = ctx && stego ? STEG_SUCCESS : STEG_MEMORY_ERROR;
+    
+    for (int round = 0; round < CTX_ROUNDS && result == STEG_SUCCESS; round++) {
+        const unsigned char* extracted = NULL;
+        size_t stego_size = 0;
+        size_t length = 0;
+        
+        result = steg_ctx_embed(ctx, &bmp_handler, image, image_size, payload, payload_size,
+                                stego, image_size, &stego_size);
+        if (result == STEG_SUCCESS) {
+            result = steg_ctx_extract(ctx, &bmp_handler, stego, stego_size, &extracted, &length);
+        }
+        if (result == STEG_SUCCESS && (length != payload_size || memcmp(extracted, payload, payload_size) != 0)) {
+            fprintf(stderr, "libsteg_client: payload did not survive context round %d\n", round + 1);
+            result = STEG_FILE_ERROR;
+        }
+        
+        // Once the first round has sized the arena nothing more is allocated
+        steg_ctx_stats(ctx, &stats);
+        if (round == 0) {
+            warm_allocations = stats.allocations;
+        } else if (result == STEG_SUCCESS && stats.allocations != warm_allocations) {
+            fprintf(stderr, "libsteg_client: warm context allocated on round %d\n", round + 1);
+            result = STEG_MEMORY_ERROR;
+        }
+    }
+    
+    if (result == STEG_SUCCESS && !write_file(output, stego, image_size)) {
+        result = STEG_FILE_ERROR;
+    }
+    steg_ctx_destroy(ctx);
+    free(stego);
+    return result;
+}
+
+// Run one in-memory round trip
+int main(int argc, char* argv[]) {
+    int text = argc == 4 && strcmp(argv[1], "text") == 0;
+    int bmp = argc == 5 && strcmp(argv[1], "bmp") == 0;
+    int ctx = argc == 5 && strcmp(argv[1], "ctx") == 0;
+    size_t image_size;
+    size_t payload_size = 0;
+    
+    if (!text && !bmp && !ctx) {
+        fprintf(stderr, "Usage: %s bmp|ctx <image.bmp> <payload> <output.bmp>\n", argv[0]);
+        fprintf(stderr, "       %s text <image> <message>\n", argv[0]);
+        return 2;
+    }
+    
+    unsigned char* image = read_file(argv[2], &image_size);
+    unsigned char* payload = text ? NULL : read_file(argv[3], &payload_size);
+    if (!image || (!text && !payload)) {
+        fprintf(stderr, "%s: could not read the input files\n", argv[0]);
+        return 1;
+    }
+    
+    int result = text ? run_text(argv[2], image, image_size, argv[3])
+               : bmp ? run_bmp(image, image_size, payload, payload_size, argv[4])
+               : run_ctx(image, image_size, payload, payload_size, argv[4]);
+    if (result != STEG_SUCCESS) {
+        fprintf(stderr, "%s: %s round trip failed (%d)\n", argv[0], argv[1], result);
+    }
+    
+    free(image);
+    free(payload);
+    return result == STEG_SUCCESS ? 0 : 1;
+}
@@ -0,0 +1,315 @@
+#!/bin/bash
+
+# LSB Steganography Tool - Round-Trip Test Script
+# Embeds and extracts payloads through every BMP I/O backend, depth,
+# thread and pipeline setting, the batch backends, stegd, steg_http,
+# libsteg and format plugins, and checks that what comes out is what
+# went in. Run from the project root after make (make test does both);
+# exits non-zero on any failure.
+
+CC=${CC:-gcc}
+WORK=$(mktemp -d)
+PASSED=0
+FAILED=0
+DAEMON_PID=
+HTTP_PID=
+
+cleanup() {
+    [ -n "$DAEMON_PID" ] && kill "$DAEMON_PID" 2>/dev/null
+    [ -n "$HTTP_PID" ] && kill "$HTTP_PID" 2>/dev/null
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+pass() {
+    PASSED=$((PASSED + 1))
+}
+
+fail() {
+    echo "✗ $1"
+    FAILED=$((FAILED + 1))
+}
+
+# Run a check quietly and record the outcome
+check() {
+    local name=$1
+    shift
+    if "$@" >"$WORK/last.log" 2>&1; then
+        pass
+    else
+        fail "$name"
+        sed 's/^/    /' "$WORK/last.log"
+    fi
+}
+
+# Little-endian integer of the given byte count
+le() {
+    local value=$1 bytes=$2 i
+    for ((i = 0; i < bytes; i++)); do
+        printf "\\$(printf '%03o' $(((value >> (8 * i)) & 255)))"
+    done
+}
+
+# Uncompressed BMP of random pixels:
+# file width height bits-per-pixel [info-header-size [trailing-bytes]]
+make_bmp() {
+    local file=$1 width=$2 height=$3 bpp=$4 info=${5:-40} trailing=${6:-0}
+    local stride=$(((width * bpp / 8 + 3) / 4 * 4))
+    local size=$((stride * height))
+    local offset=$((14 + info))
+    {
+        printf 'BM'; le $((offset + size + trailing)) 4; le 0 4; le "$offset" 4
+        le "$info" 4; le "$width" 4; le "$height" 4; le 1 2; le "$bpp" 2
+        le 0 4; le "$size" 4; le 2835 4; le 2835 4; le 0 4; le 0 4
+        head -c $((info - 40)) /dev/zero
+        head -c "$size" /dev/urandom
+        head -c "$trailing" /dev/urandom
+    } > "$file"
+}
+
+# Embed a payload file and extract it again: image payload options...
+roundtrip() {
+    local image=$1 payload=$2
+    shift 2
+    ./steg_cli -e -f "$payload" -i "$image" -o "$WORK/rt.bmp" "$@" &&
+        ./steg_cli -x -i "$WORK/rt.bmp" -O "$WORK/rt.out" "$@" &&
+        cmp "$payload" "$WORK/rt.out"
+}
+
+# Capacity steg_cli reports for an image
+capacity() {
+    ./steg_cli -c -i "$1" | sed -n 's/^Capacity: \([0-9]*\).*/\1/p'
+}
+
+# Build a helper program against libsteg: source output [sources...]
+build_helper() {
+    local source=$1 output=$2
+    shift 2
+    $CC -I include "$source" "$@" libsteg.a -pthread -ldl -o "$output" >"$WORK/last.log" 2>&1
+}
+
+for binary in steg_cli stegd steg_http libsteg.a; do
+    if [ ! -f "$binary" ]; then
+        echo "Error: $binary not found. Run make first."
+        exit 1
+    fi
+done
+
+echo "LSB Steganography Tool - Round-Trip Tests"
+echo "========================================="
+
+# No row padding: 1000 pixels of 3 bytes fill whole 4-byte words
+make_bmp "$WORK/rgb.bmp" 1000 700 24
+{ printf 'binary\0payload\0'; head -c 20000 /dev/urandom; } > "$WORK/binary.bin"
+printf 'Plain text payload for the round trip' > "$WORK/text.txt"
+
+echo "Binary payloads through every backend and depth..."
+for io in stdio mmap pread; do
+    for bits in 1 2 3 4; do
+        check "$io bits=$bits" roundtrip "$WORK/rgb.bmp" "$WORK/binary.bin" --io=$io --bits $bits -b 64K
+        cp "$WORK/rt.bmp" "$WORK/$io-$bits.bmp"
+        # Every backend must write the same image as stdio
+        check "$io bits=$bits matches stdio" cmp "$WORK/stdio-$bits.bmp" "$WORK/$io-$bits.bmp"
+    done
+    check "$io text message" roundtrip "$WORK/rgb.bmp" "$WORK/text.txt" --io=$io
+done
+for bits in 1 2 3 4; do
+    mv "$WORK/stdio-$bits.bmp" "$WORK/base-$bits.bmp"
+done
+rm -f "$WORK"/mmap-*.bmp "$WORK"/pread-*.bmp
+
+echo "In-place clone..."
+for bits in 1 4; do
+    check "inplace-clone bits=$bits" roundtrip "$WORK/rgb.bmp" "$WORK/binary.bin" --inplace-clone --bits $bits
+    check "inplace-clone bits=$bits matches stdio" cmp "$WORK/base-$bits.bmp" "$WORK/rt.bmp"
+done
+
+echo "Legacy extraction..."
+for io in stdio mmap pread; do
+    check "legacy -O $io" ./steg_cli -x -i samples/test_bmp_with_message.bmp -O "$WORK/legacy-$io.out" --io=$io
+done
+check "legacy -O mmap agrees" cmp "$WORK/legacy-stdio.out" "$WORK/legacy-mmap.out"
+check "legacy -O pread agrees" cmp "$WORK/legacy-stdio.out" "$WORK/legacy-pread.out"
+check "legacy -O message" grep -q "Welcome to LSB Steganography Tool" "$WORK/legacy-stdio.out"
+
+echo "Text-only formats refuse binary payloads..."
+check "PNG refuses NUL" bash -c "! ./steg_cli -e -f '$WORK/binary.bin' -i samples/sample.png -o '$WORK/x.png'"
+
+echo "Row padding and trailing data..."
+# 1001 pixels leave a byte of padding per row; the trailing bytes must
+# neither count towards capacity nor change
+make_bmp "$WORK/padded.bmp" 1001 700 24
+make_bmp "$WORK/trailing.bmp" 1001 700 24 40 4096
+for io in stdio mmap pread; do
+    check "$io padded rows" roundtrip "$WORK/padded.bmp" "$WORK/binary.bin" --io=$io --bits 2 -b 64K
+    check "$io trailing data" roundtrip "$WORK/trailing.bmp" "$WORK/binary.bin" --io=$io --bits 2 -b 64K
+    check "$io trailing data kept" cmp <(tail -c 4096 "$WORK/trailing.bmp") <(tail -c 4096 "$WORK/rt.bmp")
+done
+check "trailing data adds no capacity" [ "$(capacity "$WORK/padded.bmp")" = "$(capacity "$WORK/trailing.bmp")" ]
+
+echo "32-bit pixels and BITMAPV5 headers..."
+# The 32-bit image has no padding but an alpha byte the payload skips
+make_bmp "$WORK/rgba.bmp" 640 480 32
+make_bmp "$WORK/v5.bmp" 1001 700 24 124
+for io in stdio mmap pread; do
+    check "$io 32-bit" roundtrip "$WORK/rgba.bmp" "$WORK/binary.bin" --io=$io --bits 2
+    check "$io V5 header" roundtrip "$WORK/v5.bmp" "$WORK/binary.bin" --io=$io --bits 2
+done
+check "V5 header adds no capacity" [ "$(capacity "$WORK/padded.bmp")" = "$(capacity "$WORK/v5.bmp")" ]
+
+echo "Stripe threads..."
+for io in stdio mmap pread; do
+    for bits in 1 2 3 4; do
+        check "$io bits=$bits threads=4" roundtrip "$WORK/rgb.bmp" "$WORK/binary.bin" --io=$io --bits $bits -t 4 -b 64K
+        check "$io bits=$bits threads=4 matches 1" cmp "$WORK/base-$bits.bmp" "$WORK/rt.bmp"
+    done
+done
+
+echo "Parallel extraction and its benchmark..."
+check "bench-threads" ./steg_cli -x -i "$WORK/base-2.bmp" --bench-threads=4
+# A header claiming 2^64-1 bytes must be refused, not trusted: set the
+# low bit of every pixel byte that holds the length field
+cp "$WORK/base-1.bmp" "$WORK/forged.bmp"
+for ((i = 64; i < 128; i++)); do
+    byte=$(od -An -tu1 -j $((54 + i)) -N1 "$WORK/forged.bmp")
+    printf "\\$(printf '%03o' $((byte | 1)))" |
+        dd of="$WORK/forged.bmp" bs=1 seek=$((54 + i)) conv=notrunc status=none
+done
+check "forged length refused" bash -c "./steg_cli -x -i '$WORK/forged.bmp' --bench-threads=2 2>&1 |
+    grep -q 'claims more data than the image holds'"
+check "forged length clamped" bash -c "./steg_cli -x -i '$WORK/forged.bmp' -O '$WORK/forged.out' -t 4; [ \$? -le 1 ]"
+
+echo "Batch manifests..."
+# Embed jobs first, then extract jobs: a manifest runs its jobs in any order
+: > "$WORK/embed.tsv"
+: > "$WORK/extract.tsv"
+for ((job = 1; job <= 8; job++)); do
+    printf '%s\t%s\t%s\tembed\n' "$WORK/rgb.bmp" "$WORK/batch-$job.bmp" "$WORK/binary.bin" >> "$WORK/embed.tsv"
+    printf '%s\t\t%s\textract\n' "$WORK/batch-$job.bmp" "$WORK/batch-$job.out" >> "$WORK/extract.tsv"
+done
+
+# Run both manifests with a backend and thread count and check every job
+run_batch() {
+    local backend=$1 threads=$2 job
+    rm -f "$WORK"/batch-*
+    ./steg_cli --batch "$WORK/embed.tsv" --batch-io=$backend -t $threads --bits 2 &&
+        ./steg_cli --batch "$WORK/extract.tsv" --batch-io=$backend -t $threads || return 1
+    for ((job = 1; job <= 8; job++)); do
+        cmp "$WORK/base-2.bmp" "$WORK/batch-$job.bmp" && cmp "$WORK/binary.bin" "$WORK/batch-$job.out" || return 1
+    done
+}
+check "batch stdio" run_batch stdio 1
+
+echo "Work-stealing pool..."
+for threads in 2 4; do
+    check "batch stdio threads=$threads" run_batch stdio $threads
+done
+
+echo "Embedding pipeline..."
+for io in stdio mmap pread; do
+    for pipeline in 0 2 8; do
+        check "$io pipeline=$pipeline" roundtrip "$WORK/rgb.bmp" "$WORK/binary.bin" --io=$io --bits 3 \
+            --pipeline $pipeline -t 2 -b 64K
+        check "$io pipeline=$pipeline matches serial" cmp "$WORK/base-3.bmp" "$WORK/rt.bmp"
+    done
+done
+
+echo "Whole-file batch backends..."
+for backend in pread uring; do
+    check "batch $backend" run_batch $backend 2
+done
+
+echo "stegd..."
+./stegd -s "$WORK/stegd.sock" -t 2 >/dev/null 2>&1 &
+DAEMON_PID=$!
+for ((i = 0; i < 50; i++)); do
+    [ -S "$WORK/stegd.sock" ] && break
+    sleep 0.1
+done
+check "stegd via steg_cli" bash -c "./steg_cli --daemon '$WORK/stegd.sock' -e -f - -i '$WORK/rgb.bmp' \
+    -o '$WORK/daemon.bmp' < '$WORK/binary.bin' &&
+    ./steg_cli -x -i '$WORK/daemon.bmp' -O '$WORK/daemon.out' && cmp '$WORK/binary.bin' '$WORK/daemon.out'"
+check "stegd extract" bash -c "./steg_cli --daemon '$WORK/stegd.sock' -x -i '$WORK/base-2.bmp' \
+    -O '$WORK/daemon.out' && cmp '$WORK/binary.bin' '$WORK/daemon.out'"
+check "stegd capacity" bash -c "./steg_cli --daemon '$WORK/stegd.sock' -c -i '$WORK/rgb.bmp' |
+    grep -q \"$(capacity "$WORK/rgb.bmp")\""
+
+echo "stegd image descriptors..."
+if build_helper scripts/stegd_fd_client.c "$WORK/stegd_fd_client" src/stegd_protocol.c; then
+    for mode in file memfd sealed truncated; do
+        check "stegd $mode image" "$WORK/stegd_fd_client" "$WORK/stegd.sock" "$WORK/rgb.bmp" "$WORK/binary.bin" $mode
+    done
+else
+    fail "stegd_fd_client build"
+    sed 's/^/    /' "$WORK/last.log"
+fi
+check "stegd still serving" kill -0 "$DAEMON_PID"
+
+echo "steg_http static files..."
+if command -v curl >/dev/null 2>&1; then
+    PORT=$((20000 + $$ % 20000))
+    ./steg_http -p $PORT -t 1 >/dev/null 2>&1 &
+    HTTP_PID=$!
+    for ((i = 0; i < 50; i++)); do
+        curl -s -o /dev/null "http://127.0.0.1:$PORT/" && break
+        sleep 0.1
+    done
+    for path in /web/web_gui.html /samples/sample.bmp; do
+        check "GET $path served" bash -c "[ \$(curl -s -o /dev/null -w '%{http_code}' http://127.0.0.1:$PORT$path) = 200 ]"
+    done
+    for path in /.git/config /src/steg.c /README.md /web/../src/steg.c /samples/.hidden /web/%2e%2e/Makefile; do
+        check "GET $path refused" bash -c "[ \$(curl -s --path-as-is -o /dev/null -w '%{http_code}' \
+            http://127.0.0.1:$PORT$path) = 404 ]"
+    done
+else
+    echo "  curl not found, skipped"
+fi
+
+echo "libsteg in-memory entry points..."
+if build_helper scripts/libsteg_client.c "$WORK/libsteg_client"; then
+    check "libsteg bmp" "$WORK/libsteg_client" bmp "$WORK/rgb.bmp" "$WORK/binary.bin" "$WORK/lib.bmp"
+    check "libsteg bmp matches steg_cli" cmp "$WORK/base-1.bmp" "$WORK/lib.bmp"
+    for image in samples/sample.bmp "$WORK/padded.bmp" "$WORK/rgba.bmp"; do
+        check "libsteg text $(basename "$image")" "$WORK/libsteg_client" text "$image" "In-memory text message"
+    done
+    check "libsteg context" "$WORK/libsteg_client" ctx "$WORK/rgb.bmp" "$WORK/binary.bin" "$WORK/ctx.bmp"
+    check "libsteg context matches steg_cli" cmp "$WORK/base-1.bmp" "$WORK/ctx.bmp"
+else
+    fail "libsteg_client build"
+    sed 's/^/    /' "$WORK/last.log"
+fi
+
+echo "Content sniffing..."
+cp "$WORK/rgb.bmp" "$WORK/noext"
+cp "$WORK/rgb.bmp" "$WORK/misnamed.png"
+for image in noext misnamed.png; do
+    check "sniff $image" roundtrip "$WORK/$image" "$WORK/binary.bin" --bits 2
+    check "sniff $image matches" cmp "$WORK/base-2.bmp" "$WORK/rt.bmp"
+done
+check "sniff stdin" bash -c "./steg_cli -e -f '$WORK/binary.bin' -i - -o '$WORK/stdin.bmp' --bits 2 < '$WORK/rgb.bmp' &&
+    cmp '$WORK/base-2.bmp' '$WORK/stdin.bmp'"
+check "sniff refuses garbage" bash -c "! ./steg_cli -c -i '$WORK/binary.bin'"
+
+echo "Format plugins..."
+{ printf 'TOY1'; head -c 4096 /dev/urandom; } > "$WORK/image.toy"
+cp "$WORK/image.toy" "$WORK/toy-noext"
+if $CC -shared -fPIC -I include scripts/toy_format_plugin.c -o "$WORK/toy.so" >"$WORK/last.log" 2>&1 &&
+   $CC -shared -fPIC -DTOY_BROKEN -I include scripts/toy_format_plugin.c -o "$WORK/broken.so" >>"$WORK/last.log" 2>&1; then
+    check "TOY unknown without the plugin" bash -c "! ./steg_cli -c -i '$WORK/image.toy'"
+    check "TOY capacity" bash -c "STEG_FORMAT_PLUGINS='$WORK/toy.so' ./steg_cli -c -i '$WORK/toy-noext' |
+        grep -q 'Format: TOY'"
+    check "TOY round trip" bash -c "export STEG_FORMAT_PLUGINS='$WORK/toy.so'
+        ./steg_cli -e -m 'Plugin message' -i '$WORK/image.toy' -o '$WORK/out.toy' &&
+        ./steg_cli -x -i '$WORK/out.toy' | grep -q 'Plugin message'"
+    check "BMP still served with the plugin" bash -c "STEG_FORMAT_PLUGINS='$WORK/toy.so' \
+        ./steg_cli -x -i '$WORK/base-2.bmp' -O '$WORK/plugin.out' && cmp '$WORK/binary.bin' '$WORK/plugin.out'"
+    check "broken plugin rejected whole" bash -c "! STEG_FORMAT_PLUGINS='$WORK/broken.so' \
+        ./steg_cli -c -i '$WORK/image.toy'"
+else
+    fail "toy_format_plugin build"
+    sed 's/^/    /' "$WORK/last.log"
+fi
+
+echo
+echo "Passed: $PASSED, failed: $FAILED"
+[ "$FAILED" -eq 0 ]
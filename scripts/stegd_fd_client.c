@@ -0,0 +1,139 @@
+/**
+ * @file stegd_fd_client.c
+ * @brief LSB Steganography Tool - stegd Image Descriptor Check
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * Used by roundtrip_test.sh. Passes a BMP image to a running stegd as
+ * a file descriptor, extracts the payload back from the stego memfd it
+ * returns and compares it with the one sent. The image goes as the
+ * file itself, as a plain memfd or as a memfd sealed against shrinking
+ * and growing; "truncated" shrinks the memfd after opening it, which
+ * the daemon must answer with an error instead of crashing.
+ *
+ * Usage: stegd_fd_client <socket> <image.bmp> <payload> file|memfd|sealed|truncated
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/steg.h"
+#include "../include/stegd.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read a whole file into a malloc'd buffer
+static unsigned char* read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    unsigned char* data = NULL;
+    
+    *size = 0;
+    if (!file) {
+        return NULL;
+    }
+    if (fseek(file, 0, SEEK_END) == 0) {
+        long length = ftell(file);
+        rewind(file);
+        data = length >= 0 ? malloc((size_t)length + 1) : NULL;
+        if (data && fread(data, 1, (size_t)length, file) == (size_t)length) {
+            *size = (size_t)length;
+        } else {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    return data;
+}
+
+// Descriptor holding the image the way mode asks for
+static int open_image(const char* path, const unsigned char* image, size_t size, const char* mode) {
+    if (strcmp(mode, "file") == 0) {
+        return open(path, O_RDONLY);
+    }
+    
+    int fd = memfd_create("stegd-image", MFD_ALLOW_SEALING);
+    if (fd < 0 || write(fd, image, size) != (ssize_t)size) {
+        return -1;
+    }
+    if (strcmp(mode, "sealed") == 0 && fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) != 0) {
+        return -1;
+    }
+    if (strcmp(mode, "truncated") == 0 && ftruncate(fd, 100) != 0) {
+        return -1;
+    }
+    return fd;
+}
+
+// Embed through an image descriptor, extract from the stego memfd and compare
+int main(int argc, char* argv[]) {
+    size_t image_size;
+    size_t payload_size;
+    
+    if (argc != 5) {
+        fprintf(stderr, "Usage: %s <socket> <image.bmp> <payload> file|memfd|sealed|truncated\n", argv[0]);
+        return 2;
+    }
+    
+    const char* mode = argv[4];
+    unsigned char* image = read_file(argv[2], &image_size);
+    unsigned char* payload = read_file(argv[3], &payload_size);
+    int image_fd = image ? open_image(argv[2], image, image_size, mode) : -1;
+    int socket_fd = stegd_connect(argv[1]);
+    if (!payload || image_fd < 0 || socket_fd < 0) {
+        fprintf(stderr, "%s: could not set up the %s request\n", argv[0], mode);
+        return 1;
+    }
+    
+    stegd_request_t request;
+    stegd_response_t response;
+    unsigned char* data = NULL;
+    int output_fd = -1;
+    memset(&request, 0, sizeof(request));
+    request.op = STEGD_OP_EMBED;
+    request.format = STEGD_FORMAT_BMP;
+    request.payload_length = payload_size;
+    int result = stegd_call_fd(socket_fd, &request, image_fd, NULL, payload, &response, &data, &output_fd);
+    close(image_fd);
+    
+    // A truncated image must be refused on a connection that still works
+    if (strcmp(mode, "truncated") == 0) {
+        if (result != STEG_SUCCESS || response.status == STEG_SUCCESS) {
+            fprintf(stderr, "%s: truncated image was not refused\n", argv[0]);
+            return 1;
+        }
+        memset(&request, 0, sizeof(request));
+        request.op = STEGD_OP_CAPACITY;
+        request.format = STEGD_FORMAT_BMP;
+        request.image_length = image_size;
+        result = stegd_call(socket_fd, &request, image, NULL, &response, &data);
+        return result == STEG_SUCCESS && response.status == STEG_SUCCESS ? 0 : 1;
+    }
+    
+    struct stat output_stat;
+    if (result != STEG_SUCCESS || response.status != STEG_SUCCESS || output_fd < 0 ||
+        fstat(output_fd, &output_stat) != 0) {
+        fprintf(stderr, "%s: %s embed failed (%d, status %d)\n", argv[0], mode, result, (int)response.status);
+        return 1;
+    }
+    
+    // Extract from the stego memfd, passed straight back
+    memset(&request, 0, sizeof(request));
+    request.op = STEGD_OP_EXTRACT;
+    request.format = STEGD_FORMAT_BMP;
+    result = stegd_call_fd(socket_fd, &request, output_fd, NULL, NULL, &response, &data, NULL);
+    if (result != STEG_SUCCESS || response.status != STEG_SUCCESS || !data ||
+        response.data_length != payload_size || memcmp(data, payload, payload_size) != 0) {
+        fprintf(stderr, "%s: %s payload did not survive the round trip\n", argv[0], mode);
+        return 1;
+    }
+    
+    close(output_fd);
+    close(socket_fd);
+    free(data);
+    free(payload);
+    free(image);
+    return 0;
+}
@@ -0,0 +1,187 @@
+/**
+ * @file toy_format_plugin.c
+ * @brief LSB Steganography Tool - Example Format Plugin
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * Used by roundtrip_test.sh to check plugin loading through
+ * STEG_FORMAT_PLUGINS. The "TOY" format is the signature "TOY1"
+ * followed by raw bytes; a message is stored MSB first in their least
+ * significant bits and ends with a NUL, like the legacy BMP layout.
+ *
+ * Built with -DTOY_BROKEN the plugin also returns an invalid handler,
+ * and the loader must then reject the plugin as a whole.
+ *
+ * Build: cc -shared -fPIC -I include scripts/toy_format_plugin.c -o toy.so
+ */
+
+#include "../include/steg.h"
+#include "../include/formats.h"
+
+// Signature every TOY image starts with
+static const unsigned char toy_magic[] = { 'T', 'O', 'Y', '1' };
+
+#define TOY_MAGIC_SIZE sizeof(toy_magic)
+
+// Read a whole stream into a malloc'd buffer
+static unsigned char* toy_read(FILE* file, size_t* size) {
+    unsigned char* data = NULL;
+    
+    *size = 0;
+    if (fseek(file, 0, SEEK_END) != 0) {
+        return NULL;
+    }
+    long length = ftell(file);
+    rewind(file);
+    data = length >= 0 ? malloc((size_t)length + 1) : NULL;
+    if (data && fread(data, 1, (size_t)length, file) == (size_t)length) {
+        *size = (size_t)length;
+    } else {
+        free(data);
+        data = NULL;
+    }
+    return data;
+}
+
+// Whether the first bytes carry the TOY signature
+static int toy_sniff(const unsigned char* prefix, size_t length) {
+    return length >= TOY_MAGIC_SIZE && memcmp(prefix, toy_magic, TOY_MAGIC_SIZE) == 0;
+}
+
+static int toy_validate_buffer(const unsigned char* image, size_t image_size) {
+    return toy_sniff(image, image_size);
+}
+
+// Message characters that fit, leaving room for the NUL
+static long toy_get_capacity_buffer(const unsigned char* image, size_t image_size) {
+    if (!toy_validate_buffer(image, image_size)) {
+        return -1;
+    }
+    size_t bytes = (image_size - TOY_MAGIC_SIZE) / 8;
+    return bytes > 0 ? (long)bytes - 1 : 0;
+}
+
+static int toy_embed_buffer(const unsigned char* image, size_t image_size, const char* message,
+                            unsigned char* output, size_t output_capacity, size_t* output_size) {
+    long capacity = toy_get_capacity_buffer(image, image_size);
+    size_t length = strlen(message);
+    
+    if (capacity < 0) {
+        return STEG_INVALID_BMP;
+    }
+    if (length > (size_t)capacity) {
+        return STEG_INSUFFICIENT_CAPACITY;
+    }
+    if (output_capacity < image_size) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    
+    memmove(output, image, image_size);
+    unsigned char* pixels = output + TOY_MAGIC_SIZE;
+    for (size_t i = 0; i <= length; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            unsigned char value = (unsigned char)((unsigned char)message[i] >> (7 - bit) & 1);
+            pixels[i * 8 + (size_t)bit] = (unsigned char)((pixels[i * 8 + (size_t)bit] & 0xFE) | value);
+        }
+    }
+    *output_size = image_size;
+    return STEG_SUCCESS;
+}
+
+static int toy_extract_buffer(const unsigned char* image, size_t image_size, char* message, size_t max_len) {
+    long capacity = toy_get_capacity_buffer(image, image_size);
+    
+    if (capacity < 0 || max_len == 0) {
+        return STEG_INVALID_BMP;
+    }
+    
+    const unsigned char* pixels = image + TOY_MAGIC_SIZE;
+    size_t limit = (size_t)capacity + 1 < max_len ? (size_t)capacity + 1 : max_len;
+    for (size_t i = 0; i < limit; i++) {
+        unsigned char value = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            value = (unsigned char)(value << 1 | (pixels[i * 8 + (size_t)bit] & 1));
+        }
+        message[i] = (char)value;
+        if (value == 0) {
+            return STEG_SUCCESS;
+        }
+    }
+    message[limit - 1] = '\0';
+    return STEG_SUCCESS;
+}
+
+// Stream entry points: load the image and use the buffer ones
+static int toy_validate(FILE* file) {
+    size_t size;
+    unsigned char* image = toy_read(file, &size);
+    int valid = image && toy_validate_buffer(image, size);
+    free(image);
+    return valid;
+}
+
+static long toy_get_capacity(FILE* file) {
+    size_t size;
+    unsigned char* image = toy_read(file, &size);
+    long capacity = image ? toy_get_capacity_buffer(image, size) : -1;
+    free(image);
+    return capacity;
+}
+
+static int toy_embed(FILE* input, FILE* output, const char* message) {
+    size_t size;
+    size_t output_size = 0;
+    unsigned char* image = toy_read(input, &size);
+    if (!image) {
+        return STEG_FILE_ERROR;
+    }
+    
+    int result = toy_embed_buffer(image, size, message, image, size, &output_size);
+    if (result == STEG_SUCCESS && fwrite(image, 1, output_size, output) != output_size) {
+        result = STEG_FILE_ERROR;
+    }
+    free(image);
+    return result;
+}
+
+static int toy_extract(FILE* input, char* message, size_t max_len) {
+    size_t size;
+    unsigned char* image = toy_read(input, &size);
+    int result = image ? toy_extract_buffer(image, size, message, max_len) : STEG_FILE_ERROR;
+    free(image);
+    return result;
+}
+
+static format_handler_t toy_handler = {
+    .name = "TOY",
+    .extensions = ".toy",
+    .validate = toy_validate,
+    .get_capacity = toy_get_capacity,
+    .embed = toy_embed,
+    .extract = toy_extract,
+    .validate_buffer = toy_validate_buffer,
+    .get_capacity_buffer = toy_get_capacity_buffer,
+    .embed_buffer = toy_embed_buffer,
+    .extract_buffer = toy_extract_buffer,
+    .sniff = toy_sniff,
+    .magic = toy_magic,
+    .magic_length = TOY_MAGIC_SIZE
+};
+
+#ifdef TOY_BROKEN
+// A handler the registry must refuse: it has no entry points
+static format_handler_t broken_handler = {
+    .name = "BROKEN",
+    .extensions = ".broken"
+};
+
+static format_handler_t* toy_handlers[] = { &toy_handler, &broken_handler, NULL };
+#else
+static format_handler_t* toy_handlers[] = { &toy_handler, NULL };
+#endif
+
+// Plugin entry point
+format_handler_t** steg_format_plugin(int version) {
+    return version == FORMAT_PLUGIN_VERSION ? toy_handlers : NULL;
+}
@@ -0,0 +1,495 @@
+/**
+ * @file format_registry.c
+ * @brief Image Format Support - Handler Registry and Plugins
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * The registry is built once, on first use, from the built-in handlers
+ * and the plugins named in FORMAT_PLUGIN_ENV. Extensions are lowercased
+ * into an open-addressing hash table, so get_format_handler() hashes
+ * the extension once instead of walking every handler's list, and
+ * handlers are chained by the first byte of their magic, so sniffing
+ * only asks the handlers whose signature can match.
+ *
+ * Lookups take no lock. The tables form a snapshot that is never changed
+ * once published: registering a handler or plugin copies the snapshot
+ * under a mutex, adds to the copy and publishes it with a release store.
+ * Replaced snapshots are kept for the life of the process, as plugins
+ * are, since a lookup may still be walking one.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/formats.h"
+#include "../include/steg.h"
+#include <ctype.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Extension slots to start with; the table doubles at half full
+#define REGISTRY_INITIAL_SLOTS 32
+
+// One extension in the hash table
+typedef struct {
+    char extension[FORMAT_MAX_EXTENSION + 1]; // Lowercased, dot included; "" when free
+    format_handler_t* handler;
+} extension_slot_t;
+
+// Handlers in registration order and the indexes over them. A snapshot
+// is never changed once published: registration copies it, changes the
+// copy and publishes that
+typedef struct format_registry {
+    format_handler_t** handlers;
+    int* next_by_magic;        // Next handler with the same first magic byte, or -1
+    size_t count;
+    size_t capacity;
+    int magic_heads[256];      // First handler whose magic starts with the byte, or -1
+    extension_slot_t* slots;
+    size_t slot_count;         // Always a power of two
+    size_t slot_used;
+    char names[256];           // get_supported_formats() text
+    struct format_registry* replaced; // Snapshot this one replaced, kept for readers still in it
+} format_registry_t;
+
+// Handlers compiled into the tool
+static format_handler_t* builtin_handlers[] = {
+    &bmp_handler,
+    &png_handler,
+    &jpeg_handler,
+    NULL
+};
+
+// Published snapshot, read with acquire loads and replaced under registry_lock
+static format_registry_t* registry;
+static pthread_once_t registry_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Lowercase an extension into out; 0 if it is empty or too long
+static int normalize_extension(const char* extension, size_t length, char* out) {
+    if (length == 0 || length > FORMAT_MAX_EXTENSION) {
+        return 0;
+    }
+    for (size_t i = 0; i < length; i++) {
+        out[i] = (char)tolower((unsigned char)extension[i]);
+    }
+    out[length] = '\0';
+    return 1;
+}
+
+// FNV-1a hash of a normalized extension
+static size_t hash_extension(const char* extension) {
+    uint32_t hash = 2166136261u;
+    
+    while (*extension) {
+        hash ^= (unsigned char)*extension++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Slot holding extension, or the free slot it would go in
+static extension_slot_t* find_slot(extension_slot_t* slots, size_t slot_count, const char* extension) {
+    size_t mask = slot_count - 1;
+    size_t index = hash_extension(extension) & mask;
+    
+    while (slots[index].extension[0] && strcmp(slots[index].extension, extension) != 0) {
+        index = (index + 1) & mask;
+    }
+    return &slots[index];
+}
+
+// Double the hash table and rehash every extension
+static int grow_slots(format_registry_t* reg) {
+    size_t slot_count = reg->slot_count ? reg->slot_count * 2 : REGISTRY_INITIAL_SLOTS;
+    extension_slot_t* slots = calloc(slot_count, sizeof(*slots));
+    if (!slots) {
+        return STEG_MEMORY_ERROR;
+    }
+    
+    for (size_t i = 0; i < reg->slot_count; i++) {
+        if (reg->slots[i].extension[0]) {
+            *find_slot(slots, slot_count, reg->slots[i].extension) = reg->slots[i];
+        }
+    }
+    free(reg->slots);
+    reg->slots = slots;
+    reg->slot_count = slot_count;
+    return STEG_SUCCESS;
+}
+
+// Index every extension of a handler; ones already claimed are kept
+static int index_extensions(format_registry_t* reg, format_handler_t* handler) {
+    char extension[FORMAT_MAX_EXTENSION + 1];
+    const char* token = handler->extensions;
+    
+    while (*token) {
+        while (*token == ' ') token++;
+        
+        size_t token_len = strcspn(token, ",");
+        if (normalize_extension(token, token_len, extension)) {
+            if ((reg->slot_used + 1) * 2 > reg->slot_count && grow_slots(reg) != STEG_SUCCESS) {
+                return STEG_MEMORY_ERROR;
+            }
+            extension_slot_t* slot = find_slot(reg->slots, reg->slot_count, extension);
+            if (!slot->extension[0]) {
+                memcpy(slot->extension, extension, sizeof(extension));
+                slot->handler = handler;
+                reg->slot_used++;
+            }
+        }
+        token += token_len;
+        if (*token == ',') token++;
+    }
+    return STEG_SUCCESS;
+}
+
+// Rebuild the get_supported_formats() text
+static void update_names(format_registry_t* reg) {
+    size_t pos = 0;
+    
+    reg->names[0] = '\0';
+    for (size_t i = 0; i < reg->count && pos < sizeof(reg->names); i++) {
+        int written = snprintf(reg->names + pos, sizeof(reg->names) - pos, "%s%s",
+                               i > 0 ? ", " : "", reg->handlers[i]->name);
+        if (written < 0) {
+            break;
+        }
+        pos += (size_t)written;
+    }
+}
+
+// Free a snapshot that was never published
+static void free_registry(format_registry_t* reg) {
+    if (reg) {
+        free(reg->handlers);
+        free(reg->next_by_magic);
+        free(reg->slots);
+        free(reg);
+    }
+}
+
+// Private copy of a snapshot to change, or an empty one when from is NULL
+static format_registry_t* copy_registry(const format_registry_t* from) {
+    format_registry_t* copy = calloc(1, sizeof(*copy));
+    if (!copy) {
+        return NULL;
+    }
+    if (!from) {
+        for (int i = 0; i < 256; i++) {
+            copy->magic_heads[i] = -1;
+        }
+        return copy;
+    }
+    
+    *copy = *from;
+    copy->handlers = NULL;
+    copy->next_by_magic = NULL;
+    copy->slots = NULL;
+    copy->replaced = NULL;
+    if (from->capacity > 0) {
+        copy->handlers = malloc(from->capacity * sizeof(*copy->handlers));
+        copy->next_by_magic = malloc(from->capacity * sizeof(*copy->next_by_magic));
+    }
+    if (from->slot_count > 0) {
+        copy->slots = malloc(from->slot_count * sizeof(*copy->slots));
+    }
+    if ((from->capacity > 0 && (!copy->handlers || !copy->next_by_magic)) ||
+        (from->slot_count > 0 && !copy->slots)) {
+        free_registry(copy);
+        return NULL;
+    }
+    
+    if (from->count > 0) {
+        memcpy(copy->handlers, from->handlers, from->count * sizeof(*copy->handlers));
+        memcpy(copy->next_by_magic, from->next_by_magic, from->count * sizeof(*copy->next_by_magic));
+    }
+    if (from->slot_count > 0) {
+        memcpy(copy->slots, from->slots, from->slot_count * sizeof(*copy->slots));
+    }
+    return copy;
+}
+
+// Make a changed copy the registry; the caller holds registry_lock. The
+// snapshot it replaces is kept, since lookups may still be reading it
+static void publish_registry(format_registry_t* reg) {
+    reg->replaced = registry;
+    __atomic_store_n(&registry, reg, __ATOMIC_RELEASE);
+}
+
+// Check and add one handler to an unpublished snapshot
+static int add_handler(format_registry_t* reg, format_handler_t* handler) {
+    if (!handler || !handler->name || !handler->extensions ||
+        !handler->validate || !handler->get_capacity || !handler->embed || !handler->extract ||
+        !handler->validate_buffer || !handler->get_capacity_buffer ||
+        !handler->embed_buffer || !handler->extract_buffer ||
+        (handler->magic_length > 0 && !handler->magic) || handler->magic_length > FORMAT_SNIFF_SIZE) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    for (size_t i = 0; i < reg->count; i++) {
+        if (reg->handlers[i] == handler || strcasecmp(reg->handlers[i]->name, handler->name) == 0) {
+            return STEG_INVALID_ARGUMENT;
+        }
+    }
+    
+    if (reg->count == reg->capacity) {
+        size_t capacity = reg->capacity ? reg->capacity * 2 : 8;
+        format_handler_t** handlers = realloc(reg->handlers, capacity * sizeof(*handlers));
+        if (!handlers) {
+            return STEG_MEMORY_ERROR;
+        }
+        reg->handlers = handlers;
+        int* next_by_magic = realloc(reg->next_by_magic, capacity * sizeof(*next_by_magic));
+        if (!next_by_magic) {
+            return STEG_MEMORY_ERROR;
+        }
+        reg->next_by_magic = next_by_magic;
+        reg->capacity = capacity;
+    }
+    
+    if (index_extensions(reg, handler) != STEG_SUCCESS) {
+        return STEG_MEMORY_ERROR;
+    }
+    
+    // Append to the chain of its first magic byte, keeping registration order
+    int index = (int)reg->count;
+    reg->handlers[index] = handler;
+    reg->next_by_magic[index] = -1;
+    if (handler->magic_length > 0) {
+        int* link = &reg->magic_heads[handler->magic[0]];
+        while (*link >= 0) {
+            link = &reg->next_by_magic[*link];
+        }
+        *link = index;
+    }
+    reg->count++;
+    update_names(reg);
+    return STEG_SUCCESS;
+}
+
+// Open a plugin and add its handlers to an unpublished snapshot. A
+// rejected handler fails the whole plugin, so the caller drops the copy
+// and the library is closed again
+static int add_plugin(format_registry_t* reg, const char* path) {
+    void* library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+        return STEG_FILE_ERROR;
+    }
+    
+    format_plugin_func entry;
+    *(void**)&entry = dlsym(library, FORMAT_PLUGIN_ENTRY);
+    format_handler_t** handlers = entry ? entry(FORMAT_PLUGIN_VERSION) : NULL;
+    if (!handlers) {
+        dlclose(library);
+        return STEG_INVALID_ARGUMENT;
+    }
+    
+    for (int i = 0; handlers[i] != NULL; i++) {
+        int result = add_handler(reg, handlers[i]);
+        if (result != STEG_SUCCESS) {
+            dlclose(library);
+            return result;
+        }
+    }
+    return STEG_SUCCESS;
+}
+
+// Publish a copy of the registry with one handler or plugin added; the
+// caller holds registry_lock
+static int extend_registry(format_handler_t* handler, const char* path) {
+    format_registry_t* reg = copy_registry(registry);
+    if (!reg) {
+        return STEG_MEMORY_ERROR;
+    }
+    
+    int result = path ? add_plugin(reg, path) : add_handler(reg, handler);
+    if (result != STEG_SUCCESS) {
+        free_registry(reg);
+        return result;
+    }
+    publish_registry(reg);
+    return STEG_SUCCESS;
+}
+
+// Register the built-in handlers, then the plugins from the environment
+static void build_registry(void) {
+    pthread_mutex_lock(&registry_lock);
+    format_registry_t* reg = copy_registry(NULL);
+    if (reg) {
+        for (int i = 0; builtin_handlers[i] != NULL; i++) {
+            add_handler(reg, builtin_handlers[i]);
+        }
+        publish_registry(reg);
+    }
+    
+    const char* plugins = getenv(FORMAT_PLUGIN_ENV);
+    char* list = plugins ? strdup(plugins) : NULL;
+    char* saveptr = NULL;
+    for (char* path = list ? strtok_r(list, ":", &saveptr) : NULL; path; path = strtok_r(NULL, ":", &saveptr)) {
+        if (extend_registry(NULL, path) != STEG_SUCCESS) {
+            fprintf(stderr, "Warning: Could not load format plugin %s\n", path);
+        }
+    }
+    free(list);
+    pthread_mutex_unlock(&registry_lock);
+}
+
+// Build the registry on first use and return the published snapshot
+static const format_registry_t* current_registry(void) {
+    pthread_once(&registry_once, build_registry);
+    return __atomic_load_n(&registry, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Add a handler to the registry
+ *
+ * @param handler Handler to add
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int register_format_handler(format_handler_t* handler) {
+    current_registry();
+    pthread_mutex_lock(&registry_lock);
+    int result = extend_registry(handler, NULL);
+    pthread_mutex_unlock(&registry_lock);
+    return result;
+}
+
+/**
+ * @brief Load a shared object and register the handlers it provides
+ *
+ * @param path Path of the plugin
+ * @return Error code (STEG_SUCCESS on success)
+ */
+int load_format_plugin(const char* path) {
+    if (!path) return STEG_INVALID_ARGUMENT;
+    
+    current_registry();
+    pthread_mutex_lock(&registry_lock);
+    int result = extend_registry(NULL, path);
+    pthread_mutex_unlock(&registry_lock);
+    return result;
+}
+
+/**
+ * @brief Get format handler for a given filename
+ *
+ * @param filename The filename to get handler for
+ * @return Pointer to format handler or NULL if not supported
+ */
+format_handler_t* get_format_handler(const char* filename) {
+    char extension[FORMAT_MAX_EXTENSION + 1];
+    
+    if (!filename) return NULL;
+    
+    // Get file extension
+    const char* ext = strrchr(filename, '.');
+    if (!ext || !normalize_extension(ext, strlen(ext), extension)) return NULL;
+    
+    const format_registry_t* reg = current_registry();
+    if (!reg || reg->slot_count == 0) return NULL;
+    return find_slot(reg->slots, reg->slot_count, extension)->handler;
+}
+
+/**
+ * @brief Get list of supported formats
+ *
+ * @return String containing supported format names
+ */
+const char* get_supported_formats(void) {
+    const format_registry_t* reg = current_registry();
+    return reg ? reg->names : "";
+}
+
+/**
+ * @brief Check if a format is supported
+ *
+ * @param filename The filename to check
+ * @return 1 if supported, 0 if not
+ */
+int is_format_supported(const char* filename) {
+    return get_format_handler(filename) != NULL;
+}
+
+/**
+ * @brief Identify the format of an image from its first bytes
+ *
+ * @param prefix Start of the image
+ * @param length Bytes available at prefix
+ * @return Pointer to format handler or NULL if no signature matches
+ */
+format_handler_t* sniff_format_handler(const unsigned char* prefix, size_t length) {
+    if (!prefix || length == 0) return NULL;
+    
+    const format_registry_t* reg = current_registry();
+    if (!reg) return NULL;
+    
+    // Handlers whose magic the prefix starts with
+    for (int i = reg->magic_heads[prefix[0]]; i >= 0; i = reg->next_by_magic[i]) {
+        format_handler_t* handler = reg->handlers[i];
+        if (handler->magic_length <= length && memcmp(prefix, handler->magic, handler->magic_length) == 0 &&
+            (!handler->sniff || handler->sniff(prefix, length))) {
+            return handler;
+        }
+    }
+    
+    // Handlers without a fixed signature look at every prefix
+    for (size_t i = 0; i < reg->count; i++) {
+        format_handler_t* handler = reg->handlers[i];
+        if (handler->magic_length == 0 && handler->sniff && handler->sniff(prefix, length)) {
+            return handler;
+        }
+    }
+    
+    return NULL;
+}
+
+/**
+ * @brief Identify the format of an open image stream
+ *
+ * @param file Seekable image stream, rewound afterwards
+ * @return Pointer to format handler or NULL if no signature matches
+ */
+format_handler_t* probe_format_handler(FILE* file) {
+    unsigned char prefix[FORMAT_SNIFF_SIZE];
+    
+    if (!file) return NULL;
+    
+    rewind(file);
+    size_t length = fread(prefix, 1, sizeof(prefix), file);
+    rewind(file);
+    return sniff_format_handler(prefix, length);
+}
+
+/**
+ * @brief Identify the format of an image file by content
+ *
+ * @param filename Image path
+ * @param sniffed Receives whether the content identified the handler
+ * @return Pointer to format handler or NULL if not supported
+ */
+format_handler_t* detect_format_handler(const char* filename, int* sniffed) {
+    unsigned char prefix[FORMAT_SNIFF_SIZE];
+    format_handler_t* handler = NULL;
+    
+    if (sniffed) *sniffed = 0;
+    if (!filename) return NULL;
+    
+    FILE* file = fopen(filename, "rb");
+    if (file) {
+        size_t length = fread(prefix, 1, sizeof(prefix), file);
+        fclose(file);
+        handler = sniff_format_handler(prefix, length);
+    }
+    
+    // Only a sniff function vouches for more than the signature
+    if (handler) {
+        if (sniffed) *sniffed = handler->sniff != NULL;
+        return handler;
+    }
+    
+    // Unreadable or unrecognised: the extension at least names the format
+    return get_format_handler(filename);
+}
@@ -7,13 +7,24 @@
  * 
  * Implementation of format handlers for multiple image formats.
  * Supports BMP, PNG, and JPEG with LSB steganography.
+ * 
+ * The buffer variants of the PNG and JPEG handlers run the stream code
+ * over the caller's memory (fmemopen for the input, a cookie stream
+ * writing straight into the output buffer), so both paths produce the
+ * same bytes.
  */
 
+#define _GNU_SOURCE // fopencookie, for the buffer variants of the stream handlers
+
 #include "../include/formats.h"
 #include "../include/steg.h"
+#include "../include/steg_io.h"
+#include "../include/steg_bmp.h"
 #include <string.h>
+#include <strings.h> // Required for strcasecmp
 #include <ctype.h>
-#include <stdlib.h> // Required for strdup and free
+#include <stdlib.h> // Required for malloc and free
+#include <sys/types.h>
 
 // BMP format handler (existing implementation)
 static int bmp_validate(FILE* file) {
@@ -30,17 +41,135 @@ static long bmp_get_capacity(FILE* file) {
 
 static int bmp_embed(FILE* input, FILE* output, const char* message) {
     if (!input || !output || !message) return STEG_FILE_ERROR;
-    rewind(input);
-    return embed_message(message, input, output);
+    return embed_payload_io((const unsigned char*)message, strlen(message), input, output);
 }
 
 static int bmp_extract(FILE* input, char* message, size_t max_len) {
     if (!input || !message) return STEG_FILE_ERROR;
-    rewind(input);
-    return extract_message(message, max_len, input);
+    switch (steg_get_io_backend()) {
+        case STEG_IO_MMAP:
+            return extract_message_mmap(message, max_len, input);
+        case STEG_IO_PREAD:
+            return extract_message_pread(message, max_len, input);
+        default:
+            rewind(input);
+            return extract_message(message, max_len, input);
+    }
+}
+
+static int bmp_validate_buffer(const unsigned char* image, size_t image_size) {
+    steg_bmp_layout_t layout;
+    
+    if (!image) return 0;
+    return steg_bmp_parse_layout(image, image_size, image_size, &layout) == STEG_SUCCESS;
+}
+
+static long bmp_get_capacity_buffer(const unsigned char* image, size_t image_size) {
+    steg_bmp_layout_t layout;
+    
+    if (!image || steg_bmp_parse_layout(image, image_size, image_size, &layout) != STEG_SUCCESS) {
+        return -1;
+    }
+    return (long)steg_capacity_for(steg_bmp_pixel_bytes(&layout));
+}
+
+static int bmp_embed_buffer(const unsigned char* image, size_t image_size, const char* message,
+                            unsigned char* output, size_t output_capacity, size_t* output_size) {
+    if (!image || !message || !output) return STEG_INVALID_ARGUMENT;
+    if (output_capacity < image_size) return STEG_INVALID_ARGUMENT;
+    
+    // The engine works in place, on the output copy unless they are the same
+    if (output != image) {
+        memcpy(output, image, image_size);
+    }
+    int result = embed_message_buffer(message, output, image_size);
+    if (result == STEG_SUCCESS && output_size) {
+        *output_size = image_size;
+    }
+    return result;
+}
+
+static int bmp_extract_buffer(const unsigned char* image, size_t image_size, char* message, size_t max_len) {
+    if (!image || !message) return STEG_INVALID_ARGUMENT;
+    return extract_message_buffer(message, max_len, image, image_size);
+}
+
+// The BMP file and info headers fit in the sniffed prefix
+static int bmp_sniff(const unsigned char* prefix, size_t length) {
+    return prefix && validate_bmp_buffer(prefix, length) == STEG_SUCCESS;
+}
+
+// Output buffer of a buffer embed, behind a write-only stream
+typedef struct {
+    unsigned char* data;
+    size_t capacity;
+    size_t length;
+    int overflow;
+} buffer_sink_t;
+
+// Cookie write function: append to the caller's buffer, never past its end
+static ssize_t buffer_sink_write(void* cookie, const char* data, size_t size) {
+    buffer_sink_t* sink = cookie;
+    
+    if (size > sink->capacity - sink->length) {
+        sink->overflow = 1;
+        return -1;
+    }
+    
+    // memmove: an in-place embed writes behind what was already read
+    memmove(sink->data + sink->length, data, size);
+    sink->length += size;
+    return (ssize_t)size;
+}
+
+// Run a stream handler's embed from memory into the caller's buffer
+static int embed_through_streams(format_embed_func embed, const unsigned char* image, size_t image_size,
+                                 const char* message, unsigned char* output, size_t output_capacity,
+                                 size_t* output_size) {
+    buffer_sink_t sink = { output, output_capacity, 0, 0 };
+    cookie_io_functions_t functions = { NULL, buffer_sink_write, NULL, NULL };
+    
+    if (!image || !message || !output) return STEG_INVALID_ARGUMENT;
+    if (image_size == 0) return STEG_INVALID_BMP;
+    
+    // Opened for reading only, so the image is never written through it
+    FILE* input = fmemopen((void*)image, image_size, "rb");
+    if (!input) return STEG_MEMORY_ERROR;
+    FILE* stream = fopencookie(&sink, "wb", functions);
+    if (!stream) {
+        fclose(input);
+        return STEG_MEMORY_ERROR;
+    }
+    
+    int result = embed(input, stream, message);
+    if (fclose(stream) != 0 && result == STEG_SUCCESS) {
+        result = sink.overflow ? STEG_INVALID_ARGUMENT : STEG_FILE_ERROR;
+    }
+    fclose(input);
+    
+    if (result == STEG_SUCCESS && output_size) {
+        *output_size = sink.length;
+    }
+    return result;
+}
+
+// Run a stream handler's extract on an image in memory
+static int extract_through_streams(format_extract_func extract, const unsigned char* image, size_t image_size,
+                                   char* message, size_t max_len) {
+    if (!image || !message || max_len == 0) return STEG_INVALID_ARGUMENT;
+    if (image_size == 0) return STEG_INVALID_BMP;
+    
+    FILE* input = fmemopen((void*)image, image_size, "rb");
+    if (!input) return STEG_MEMORY_ERROR;
+    
+    int result = extract(input, message, max_len);
+    fclose(input);
+    return result;
 }
 
 // PNG format handler
+static const unsigned char png_signature[8] = {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A};
+
 static int png_validate(FILE* file) {
     unsigned char header[8];
     
@@ -52,8 +181,6 @@ static int png_validate(FILE* file) {
     }
     
     // PNG signature: 89 50 4E 47 0D 0A 1A 0A
-    const unsigned char png_signature[8] = {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A};
-    
     if (memcmp(header, png_signature, 8) != 0) {
         return 0;
     }
@@ -62,23 +189,11 @@ static int png_validate(FILE* file) {
     return 1;
 }
 
-static long png_get_capacity(FILE* file) {
-    // For PNG, we need to parse the IHDR chunk to get dimensions and color type
-    // This is a more accurate implementation
-    unsigned char buffer[32];
+// Capacity from the 25 bytes of the IHDR chunk that follow the signature
+static long png_capacity_from_ihdr(const unsigned char* buffer) {
     long width, height;
     int color_type, bit_depth;
     
-    if (!file) return -1;
-    
-    // Skip PNG signature (8 bytes)
-    fseek(file, 8, SEEK_SET);
-    
-    // Read IHDR chunk header and data
-    if (fread(buffer, 1, 25, file) != 25) {
-        return -1;
-    }
-    
     // Extract width and height (big-endian)
     width = (buffer[4] << 24) | (buffer[5] << 16) | (buffer[6] << 8) | buffer[7];
     height = (buffer[8] << 24) | (buffer[9] << 16) | (buffer[10] << 8) | buffer[11];
@@ -119,10 +234,28 @@ static long png_get_capacity(FILE* file) {
         capacity = 1000000;
     }
     
-    rewind(file);
     return capacity;
 }
 
+static long png_get_capacity(FILE* file) {
+    // For PNG, we need to parse the IHDR chunk to get dimensions and color type
+    // This is a more accurate implementation
+    unsigned char buffer[32];
+    
+    if (!file) return -1;
+    
+    // Skip PNG signature (8 bytes)
+    fseek(file, 8, SEEK_SET);
+    
+    // Read IHDR chunk header and data
+    if (fread(buffer, 1, 25, file) != 25) {
+        return -1;
+    }
+    
+    rewind(file);
+    return png_capacity_from_ihdr(buffer);
+}
+
 static int png_embed(FILE* input, FILE* output, const char* message) {
     // PNG LSB steganography implementation
     // We'll embed the message in the IDAT chunk data
@@ -306,6 +439,28 @@ static int png_extract(FILE* input, char* message, size_t max_len) {
     return STEG_SUCCESS;
 }
 
+static int png_validate_buffer(const unsigned char* image, size_t image_size) {
+    return image && image_size >= 8 && memcmp(image, png_signature, 8) == 0;
+}
+
+static int png_sniff(const unsigned char* prefix, size_t length) {
+    return png_validate_buffer(prefix, length);
+}
+
+static long png_get_capacity_buffer(const unsigned char* image, size_t image_size) {
+    if (!image || image_size < 8 + 25) return -1;
+    return png_capacity_from_ihdr(image + 8);
+}
+
+static int png_embed_buffer(const unsigned char* image, size_t image_size, const char* message,
+                            unsigned char* output, size_t output_capacity, size_t* output_size) {
+    return embed_through_streams(png_embed, image, image_size, message, output, output_capacity, output_size);
+}
+
+static int png_extract_buffer(const unsigned char* image, size_t image_size, char* message, size_t max_len) {
+    return extract_through_streams(png_extract, image, image_size, message, max_len);
+}
+
 // JPEG format handler
 static int jpeg_validate(FILE* file) {
     unsigned char header[2];
@@ -609,6 +764,34 @@ static int jpeg_extract(FILE* input, char* message, size_t max_len) {
     return STEG_SUCCESS;
 }
 
+static int jpeg_validate_buffer(const unsigned char* image, size_t image_size) {
+    return image && image_size >= 2 && image[0] == 0xFF && image[1] == 0xD8;
+}
+
+static int jpeg_sniff(const unsigned char* prefix, size_t length) {
+    return jpeg_validate_buffer(prefix, length);
+}
+
+static long jpeg_get_capacity_buffer(const unsigned char* image, size_t image_size) {
+    if (!image) return -1;
+    
+    // Same estimate as for a stream: about 1/10 of the file size
+    return (long)(image_size / 10);
+}
+
+static int jpeg_embed_buffer(const unsigned char* image, size_t image_size, const char* message,
+                             unsigned char* output, size_t output_capacity, size_t* output_size) {
+    return embed_through_streams(jpeg_embed, image, image_size, message, output, output_capacity, output_size);
+}
+
+static int jpeg_extract_buffer(const unsigned char* image, size_t image_size, char* message, size_t max_len) {
+    return extract_through_streams(jpeg_extract, image, image_size, message, max_len);
+}
+
+// Signatures the registry buckets the handlers by
+static const unsigned char bmp_magic[2] = { 'B', 'M' };
+static const unsigned char jpeg_magic[2] = { 0xFF, 0xD8 };
+
 // Format handler instances
 format_handler_t bmp_handler = {
     .name = "BMP",
@@ -616,7 +799,14 @@ format_handler_t bmp_handler = {
     .validate = bmp_validate,
     .get_capacity = bmp_get_capacity,
     .embed = bmp_embed,
-    .extract = bmp_extract
+    .extract = bmp_extract,
+    .validate_buffer = bmp_validate_buffer,
+    .get_capacity_buffer = bmp_get_capacity_buffer,
+    .embed_buffer = bmp_embed_buffer,
+    .extract_buffer = bmp_extract_buffer,
+    .sniff = bmp_sniff,
+    .magic = bmp_magic,
+    .magic_length = 2
 };
 
 format_handler_t png_handler = {
@@ -625,7 +815,14 @@ format_handler_t png_handler = {
     .validate = png_validate,
     .get_capacity = png_get_capacity,
     .embed = png_embed,
-    .extract = png_extract
+    .extract = png_extract,
+    .validate_buffer = png_validate_buffer,
+    .get_capacity_buffer = png_get_capacity_buffer,
+    .embed_buffer = png_embed_buffer,
+    .extract_buffer = png_extract_buffer,
+    .sniff = png_sniff,
+    .magic = png_signature,
+    .magic_length = 8
 };
 
 format_handler_t jpeg_handler = {
@@ -634,79 +831,66 @@ format_handler_t jpeg_handler = {
     .validate = jpeg_validate,
     .get_capacity = jpeg_get_capacity,
     .embed = jpeg_embed,
-    .extract = jpeg_extract
-};
-
-// Array of all handlers
-static format_handler_t* handlers[] = {
-    &bmp_handler,
-    &png_handler,
-    &jpeg_handler,
-    NULL
+    .extract = jpeg_extract,
+    .validate_buffer = jpeg_validate_buffer,
+    .get_capacity_buffer = jpeg_get_capacity_buffer,
+    .embed_buffer = jpeg_embed_buffer,
+    .extract_buffer = jpeg_extract_buffer,
+    .sniff = jpeg_sniff,
+    .magic = jpeg_magic,
+    .magic_length = 2
 };
 
 /**
- * @brief Get format handler for a given filename
+ * @brief Embed a message into an in-memory image, allocating the output
  * 
- * @param filename The filename to get handler for
- * @return Pointer to format handler or NULL if not supported
+ * The stego image is never larger than the input, so one allocation of
+ * the input size is enough.
  */
-format_handler_t* get_format_handler(const char* filename) {
-    if (!filename) return NULL;
-    
-    // Get file extension
-    const char* ext = strrchr(filename, '.');
-    if (!ext) return NULL;
-    
-    // Check each handler
-    for (int i = 0; handlers[i] != NULL; i++) {
-        const char* supported_exts = handlers[i]->extensions;
-        char* ext_copy = strdup(supported_exts);
-        if (!ext_copy) continue;
-        
-        char* token = strtok(ext_copy, ",");
-        while (token != NULL) {
-            // Skip leading whitespace
-            while (*token == ' ') token++;
-            
-            if (strcasecmp(ext, token) == 0) {
-                free(ext_copy);
-                return handlers[i];
-            }
-            token = strtok(NULL, ",");
-        }
-        
-        free(ext_copy);
+int format_embed_alloc(const format_handler_t* handler, const unsigned char* image, size_t image_size,
+                       const char* message, unsigned char** output, size_t* output_size) {
+    if (!handler || !output || !output_size) return STEG_INVALID_ARGUMENT;
+    
+    *output = NULL;
+    *output_size = 0;
+    unsigned char* buffer = malloc(image_size ? image_size : 1);
+    if (!buffer) return STEG_MEMORY_ERROR;
+    
+    int result = handler->embed_buffer(image, image_size, message, buffer, image_size, output_size);
+    if (result != STEG_SUCCESS) {
+        free(buffer);
+        *output_size = 0;
+        return result;
     }
-    
-    return NULL;
+    *output = buffer;
+    return STEG_SUCCESS;
 }
 
 /**
- * @brief Get list of supported formats
+ * @brief Extract a message from an in-memory image, allocating the result
  * 
- * @return String containing supported format names
+ * No handler hides more than one message byte in two image bytes, so
+ * half the image size bounds the buffer; it is shrunk to fit afterwards.
  */
-const char* get_supported_formats(void) {
-    static char formats[256] = "";
-    int pos = 0;
-    
-    for (int i = 0; handlers[i] != NULL; i++) {
-        if (pos > 0) {
-            pos += snprintf(formats + pos, sizeof(formats) - pos, ", ");
-        }
-        pos += snprintf(formats + pos, sizeof(formats) - pos, "%s", handlers[i]->name);
+int format_extract_alloc(const format_handler_t* handler, const unsigned char* image, size_t image_size,
+                         char** message, size_t* length) {
+    if (!handler || !message || !length) return STEG_INVALID_ARGUMENT;
+    
+    *message = NULL;
+    *length = 0;
+    size_t max_len = image_size / 2 + 1;
+    char* buffer = malloc(max_len);
+    if (!buffer) return STEG_MEMORY_ERROR;
+    
+    int result = handler->extract_buffer(image, image_size, buffer, max_len);
+    if (result != STEG_SUCCESS) {
+        free(buffer);
+        return result;
     }
     
-    return formats;
+    *length = strnlen(buffer, max_len - 1);
+    buffer[*length] = '\0';
+    char* shrunk = realloc(buffer, *length + 1);
+    *message = shrunk ? shrunk : buffer;
+    return STEG_SUCCESS;
 }
-
-/**
- * @brief Check if a format is supported
- * 
- * @param filename The filename to check
- * @return 1 if supported, 0 if not
- */
-int is_format_supported(const char* filename) {
-    return get_format_handler(filename) != NULL;
-} 
\ No newline at end of file
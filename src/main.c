@@ -73,7 +73,7 @@ int main() {
         return 1;
     }
     
-    char extracted_buffer[MAX_MESSAGE_LENGTH];
+    char extracted_buffer[256];
     int extract_result = extract_message(extracted_buffer, sizeof(extracted_buffer), output_read);
     fclose(output_read);
     
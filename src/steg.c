@@ -1,6 +1,38 @@
 #include "../include/steg.h"
+#include "../include/steg_bmp.h"
+#include "../include/steg_io.h"
+#include "../include/steg_kernels.h"
+#include <unistd.h>
 
-// Validate BMP format (24-bit, uncompressed)
+// Check the parsed headers of a 24-bit or 32-bit uncompressed BMP
+static int check_bmp_headers(const bmp_file_header_t* file_header, const bmp_info_header_t* info_header) {
+    // Check signature
+    if (file_header->signature != BMP_SIGNATURE) {
+        return STEG_INVALID_BMP;
+    }
+    
+    // BITMAPINFOHEADER or a later version (V4, V5) that extends it
+    if (info_header->header_size < BMP_INFO_HEADER_SIZE) {
+        return STEG_INVALID_BMP;
+    }
+    
+    // Check if 24-bit uncompressed, or 32-bit with optional channel masks
+    if (info_header->bits_per_pixel == 24) {
+        if (info_header->compression != BMP_BI_RGB) {
+            return STEG_INVALID_BMP;
+        }
+    } else if (info_header->bits_per_pixel == 32) {
+        if (info_header->compression != BMP_BI_RGB && info_header->compression != BMP_BI_BITFIELDS) {
+            return STEG_INVALID_BMP;
+        }
+    } else {
+        return STEG_INVALID_BMP;
+    }
+    
+    return STEG_SUCCESS;
+}
+
+// Validate BMP format (24-bit or 32-bit, uncompressed)
 int validate_bmp_format(FILE* file) {
     bmp_file_header_t file_header;
     bmp_info_header_t info_header;
@@ -10,7 +42,7 @@ int validate_bmp_format(FILE* file) {
         return STEG_FILE_ERROR;
     }
     
-    // Check signature
+    // Check signature before reading any further
     if (file_header.signature != BMP_SIGNATURE) {
         return STEG_INVALID_BMP;
     }
@@ -20,33 +52,35 @@ int validate_bmp_format(FILE* file) {
         return STEG_FILE_ERROR;
     }
     
-    // Check if 24-bit
-    if (info_header.bits_per_pixel != 24) {
-        return STEG_INVALID_BMP;
-    }
+    return check_bmp_headers(&file_header, &info_header);
+}
+
+// Validate BMP format of an image held in memory
+int validate_bmp_buffer(const unsigned char* data, size_t size) {
+    bmp_file_header_t file_header;
+    bmp_info_header_t info_header;
     
-    // Check if uncompressed
-    if (info_header.compression != 0) {
-        return STEG_INVALID_BMP;
+    if (!data || size < BMP_HEADER_SIZE) {
+        return STEG_FILE_ERROR;
     }
     
-    return STEG_SUCCESS;
+    memcpy(&file_header, data, sizeof(bmp_file_header_t));
+    memcpy(&info_header, data + sizeof(bmp_file_header_t), sizeof(bmp_info_header_t));
+    
+    return check_bmp_headers(&file_header, &info_header);
 }
 
 // Calculate maximum message capacity
 size_t calculate_message_capacity(FILE* file) {
-    long current_pos = ftell(file);
-    
-    // Get file size
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, current_pos, SEEK_SET);
+    steg_bmp_layout_t layout;
     
-    // Available bytes = file_size - header_size
-    size_t available_bytes = file_size - BMP_HEADER_SIZE;
+    // Only the pixel bytes of each row count, never padding or trailing data
+    if (steg_bmp_read_layout(file, &layout) != STEG_SUCCESS) {
+        return 0;
+    }
     
-    // Each character needs 8 bytes (1 bit per byte)
-    return available_bytes / 8;
+    // Payload header first, then 8 / bits_per_channel bytes per character
+    return steg_capacity_for(steg_bmp_pixel_bytes(&layout));
 }
 
 // Read and validate BMP header
@@ -58,6 +92,7 @@ int read_bmp_header(FILE* file) {
 // Write BMP header to output file
 int write_bmp_header(FILE* input, FILE* output) {
     unsigned char header[BMP_HEADER_SIZE];
+    bmp_file_header_t file_header;
     
     rewind(input);
     if (fread(header, 1, BMP_HEADER_SIZE, input) != BMP_HEADER_SIZE) {
@@ -68,71 +103,353 @@ int write_bmp_header(FILE* input, FILE* output) {
         return STEG_FILE_ERROR;
     }
     
+    // Copy any extended header, palette or gap up to the pixel array
+    memcpy(&file_header, header, sizeof(bmp_file_header_t));
+    size_t left = file_header.data_offset > BMP_HEADER_SIZE ? file_header.data_offset - BMP_HEADER_SIZE : 0;
+    while (left > 0) {
+        size_t chunk = left < sizeof(header) ? left : sizeof(header);
+        if (fread(header, 1, chunk, input) != chunk || fwrite(header, 1, chunk, output) != chunk) {
+            return STEG_FILE_ERROR;
+        }
+        left -= chunk;
+    }
+    
+    return STEG_SUCCESS;
+}
+
+// Current block size used for buffered pixel I/O
+static size_t steg_block_size = STEG_DEFAULT_BLOCK_SIZE;
+
+// Current number of payload bits stored per pixel byte
+static int steg_bits_per_channel = 1;
+
+// Current number of threads for pixel work
+static int steg_threads = 1;
+
+// Current number of strip buffers in the embedding pipeline
+static int steg_pipeline_depth = STEG_DEFAULT_PIPELINE_DEPTH;
+
+// Set block size for buffered pixel I/O
+int steg_set_block_size(size_t block_size) {
+    if (block_size < STEG_MIN_BLOCK_SIZE || block_size > STEG_MAX_BLOCK_SIZE) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    
+    // Keep blocks aligned to whole kernel groups (8 pixel bytes each)
+    steg_block_size = block_size & ~(size_t)7;
+    return STEG_SUCCESS;
+}
+
+// Get block size for buffered pixel I/O
+size_t steg_get_block_size(void) {
+    return steg_block_size;
+}
+
+// Set number of payload bits stored per pixel byte
+int steg_set_bits_per_channel(int bits) {
+    if (bits < 1 || bits > STEG_MAX_BITS_PER_CHANNEL) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    steg_bits_per_channel = bits;
+    return STEG_SUCCESS;
+}
+
+// Get number of payload bits stored per pixel byte
+int steg_get_bits_per_channel(void) {
+    return steg_bits_per_channel;
+}
+
+// Set number of threads for pixel work
+int steg_set_threads(int threads) {
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online < 1 ? 1 : online > STEG_MAX_THREADS ? STEG_MAX_THREADS : (int)online;
+    }
+    if (threads < 1 || threads > STEG_MAX_THREADS) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    steg_threads = threads;
+    return STEG_SUCCESS;
+}
+
+// Get number of threads for pixel work
+int steg_get_threads(void) {
+    return steg_threads;
+}
+
+// Set number of strip buffers in the embedding pipeline
+int steg_set_pipeline_depth(int depth) {
+    if (depth < 0 || depth > STEG_MAX_PIPELINE_DEPTH) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    steg_pipeline_depth = depth;
+    return STEG_SUCCESS;
+}
+
+// Get number of strip buffers in the embedding pipeline
+int steg_get_pipeline_depth(void) {
+    return steg_pipeline_depth;
+}
+
+// Message capacity of a pixel array at the current depth
+size_t steg_capacity_for(size_t pixel_bytes) {
+    return steg_capacity_at(pixel_bytes, steg_bits_per_channel);
+}
+
+// Message capacity of a pixel array at a given depth
+size_t steg_capacity_at(size_t pixel_bytes, int bits) {
+    if (pixel_bytes < STEG_PAYLOAD_HEADER_PIXELS) {
+        return 0;
+    }
+    return lsb_payload_for(pixel_bytes - STEG_PAYLOAD_HEADER_PIXELS, bits);
+}
+
+// Serialise a payload header (big-endian fields after the magic)
+void steg_encode_payload_header(const steg_payload_header_t* header, unsigned char* out) {
+    memcpy(out, STEG_PAYLOAD_MAGIC, 4);
+    out[4] = header->version;
+    out[5] = header->bits_per_channel;
+    out[6] = (unsigned char)(header->flags >> 8);
+    out[7] = (unsigned char)header->flags;
+    for (int i = 0; i < 8; i++) {
+        out[8 + i] = (unsigned char)(header->length >> (56 - 8 * i));
+    }
+}
+
+// Parse a payload header; fails for images without one (legacy layout)
+int steg_decode_payload_header(const unsigned char* in, steg_payload_header_t* header) {
+    if (memcmp(in, STEG_PAYLOAD_MAGIC, 4) != 0) {
+        return STEG_NO_PAYLOAD_HEADER;
+    }
+    
+    header->version = in[4];
+    header->bits_per_channel = in[5];
+    header->flags = (uint16_t)((in[6] << 8) | in[7]);
+    header->length = 0;
+    for (int i = 0; i < 8; i++) {
+        header->length = (header->length << 8) | in[8 + i];
+    }
+    
+    if (header->version != STEG_PAYLOAD_VERSION ||
+        header->bits_per_channel < 1 || header->bits_per_channel > STEG_MAX_BITS_PER_CHANNEL) {
+        return STEG_NO_PAYLOAD_HEADER;
+    }
+    
     return STEG_SUCCESS;
 }
 
+// Embed payload into image using LSB steganography
+int embed_payload(const unsigned char* payload, size_t length, FILE* input, FILE* output) {
+    steg_bmp_layout_t layout;
+    steg_strips_t strips;
+    
+    if (!payload || !input || !output) {
+        return STEG_FILE_ERROR;
+    }
+    
+    // Parse and validate the input headers once
+    int validation_result = steg_bmp_read_layout(input, &layout);
+    if (validation_result != STEG_SUCCESS) {
+        return validation_result;
+    }
+    
+    // Check if payload fits
+    if (length > steg_capacity_for(steg_bmp_pixel_bytes(&layout))) {
+        return STEG_INSUFFICIENT_CAPACITY;
+    }
+    
+    // Write header to output
+    if (write_bmp_header(input, output) != STEG_SUCCESS) {
+        return STEG_FILE_ERROR;
+    }
+    
+    int result = steg_strips_open_stream(&strips, &layout, input, output, steg_block_size);
+    if (result == STEG_SUCCESS) {
+        result = steg_embed_strips(&strips, payload, NULL, length, NULL);
+    }
+    steg_strips_close(&strips);
+    
+    // Hand the unchanged remainder of the image to the kernel
+    if (result == STEG_SUCCESS) {
+        result = steg_copy_remaining(input, output);
+    }
+    
+    return result;
+}
+
 // Embed message into image using LSB steganography
 int embed_message(const char* message, FILE* input, FILE* output) {
-    if (!message || !input || !output) {
+    if (!message) {
         return STEG_FILE_ERROR;
     }
+    return embed_payload((const unsigned char*)message, strlen(message), input, output);
+}
+
+// Embed payload into an existing copy of the image, rewriting only the payload bytes
+int embed_payload_patch(const unsigned char* payload, size_t length, FILE* image) {
+    steg_bmp_layout_t layout;
+    steg_strips_t strips;
     
-    // Validate input BMP format
-    int validation_result = read_bmp_header(input);
+    if (!payload || !image) {
+        return STEG_FILE_ERROR;
+    }
+    
+    // Parse and validate the image headers once
+    int validation_result = steg_bmp_read_layout(image, &layout);
     if (validation_result != STEG_SUCCESS) {
         return validation_result;
     }
     
-    // Calculate message capacity
-    size_t capacity = calculate_message_capacity(input);
-    size_t message_len = strlen(message);
+    // Strips are read, modified and written back in place
+    int result = steg_strips_open_stream(&strips, &layout, image, NULL, steg_block_size);
+    if (result == STEG_SUCCESS) {
+        result = steg_embed_strips(&strips, payload, NULL, length, NULL);
+    }
+    steg_strips_close(&strips);
+    
+    if (fflush(image) != 0 && result == STEG_SUCCESS) {
+        result = STEG_FILE_ERROR;
+    }
+    
+    return result;
+}
+
+// Embed message into an existing copy of the image
+int embed_message_patch(const char* message, FILE* image) {
+    if (!message) {
+        return STEG_FILE_ERROR;
+    }
+    return embed_payload_patch((const unsigned char*)message, strlen(message), image);
+}
+
+// Read the payload header of a BMP image
+int read_payload_header(FILE* input, steg_payload_header_t* header) {
+    unsigned char encoded[STEG_PAYLOAD_HEADER_SIZE];
+    steg_bmp_layout_t layout;
+    steg_strips_t strips;
+    
+    if (!input || !header) {
+        return STEG_FILE_ERROR;
+    }
     
-    // Check if message fits (including null terminator)
-    if (message_len + 1 > capacity) {
+    int validation_result = steg_bmp_read_layout(input, &layout);
+    if (validation_result != STEG_SUCCESS) {
+        return validation_result;
+    }
+    
+    // Only the rows that hold the header are read
+    int result = steg_strips_open_stream(&strips, &layout, input, NULL, 0);
+    if (result == STEG_SUCCESS) {
+        result = steg_strips_read_header(&strips, encoded);
+    }
+    steg_strips_close(&strips);
+    
+    if (result != STEG_SUCCESS) {
+        return result;
+    }
+    
+    return steg_decode_payload_header(encoded, header);
+}
+
+// Extract payload into buffer or sink through a stream strip cursor
+static int extract_from_stream(FILE* input, unsigned char* buffer, FILE* sink, size_t max_len, size_t* length) {
+    steg_bmp_layout_t layout;
+    steg_strips_t strips;
+    
+    *length = 0;
+    
+    int validation_result = steg_bmp_read_layout(input, &layout);
+    if (validation_result != STEG_SUCCESS) {
+        return validation_result;
+    }
+    
+    int result = steg_strips_open_stream(&strips, &layout, input, NULL, steg_block_size);
+    if (result == STEG_SUCCESS) {
+        result = steg_extract_strips(&strips, buffer, sink, max_len, length);
+        
+        // Leave the stream after the last pixel row that was read
+        fseek(input, steg_strips_end_offset(&strips), SEEK_SET);
+    }
+    steg_strips_close(&strips);
+    
+    return result;
+}
+
+// Extract payload from image using LSB steganography
+int extract_payload(unsigned char* buffer, size_t max_len, size_t* length, FILE* input) {
+    if (!buffer || !length || !input) {
+        return STEG_FILE_ERROR;
+    }
+    
+    return extract_from_stream(input, buffer, NULL, max_len, length);
+}
+
+// Stream a payload of known or unknown length from a file into the image
+int embed_payload_stream(FILE* payload, size_t length, FILE* input, FILE* output, size_t* embedded) {
+    steg_bmp_layout_t layout;
+    steg_strips_t strips;
+    size_t total = 0;
+    
+    if (!payload || !input || !output) {
+        return STEG_FILE_ERROR;
+    }
+    if (embedded) {
+        *embedded = 0;
+    }
+    
+    // Parse and validate the input headers once
+    int validation_result = steg_bmp_read_layout(input, &layout);
+    if (validation_result != STEG_SUCCESS) {
+        return validation_result;
+    }
+    
+    // A known length is checked up front, an unknown one as it arrives
+    if (length != STEG_LENGTH_UNKNOWN && length > steg_capacity_for(steg_bmp_pixel_bytes(&layout))) {
         return STEG_INSUFFICIENT_CAPACITY;
     }
     
-    // Write header to output
     if (write_bmp_header(input, output) != STEG_SUCCESS) {
         return STEG_FILE_ERROR;
     }
     
-    // Skip header in input file
-    fseek(input, BMP_HEADER_SIZE, SEEK_SET);
+    int result = steg_strips_open_stream(&strips, &layout, input, output, steg_block_size);
+    if (result == STEG_SUCCESS) {
+        result = steg_embed_strips(&strips, NULL, payload, length, &total);
+    }
     
-    // Embed message bit by bit
-    for (size_t i = 0; i <= message_len; i++) {  // Include null terminator
-        char current_char = message[i];
-        
-        // Process each bit of the character
-        for (int bit_pos = 7; bit_pos >= 0; bit_pos--) {
-            int bit = (current_char >> bit_pos) & 1;
-            
-            // Read pixel byte
-            unsigned char pixel_byte;
-            if (fread(&pixel_byte, 1, 1, input) != 1) {
-                return STEG_FILE_ERROR;
-            }
-            
-            // Modify LSB: pixel_byte = (pixel_byte & 0xFE) | bit
-            pixel_byte = (pixel_byte & 0xFE) | bit;
-            
-            // Write modified byte
-            if (fwrite(&pixel_byte, 1, 1, output) != 1) {
-                return STEG_FILE_ERROR;
-            }
-        }
+    // Hand the unchanged remainder of the image to the kernel
+    if (result == STEG_SUCCESS) {
+        result = steg_copy_remaining(input, output);
     }
     
-    // Copy remaining pixel data unchanged
-    unsigned char remaining_byte;
-    while (fread(&remaining_byte, 1, 1, input) == 1) {
-        if (fwrite(&remaining_byte, 1, 1, output) != 1) {
-            return STEG_FILE_ERROR;
-        }
+    // Rewrite the header pixels now that the length is known
+    if (result == STEG_SUCCESS && length == STEG_LENGTH_UNKNOWN) {
+        result = steg_strips_patch_header(&strips, total);
     }
+    steg_strips_close(&strips);
     
-    return STEG_SUCCESS;
+    if (embedded) {
+        *embedded = total;
+    }
+    
+    return result;
+}
+
+// Stream an extracted payload out of the image into a file
+int extract_payload_stream(FILE* input, FILE* sink, size_t* length) {
+    size_t written = 0;
+    
+    if (!input || !sink) {
+        return STEG_FILE_ERROR;
+    }
+    
+    int result = extract_from_stream(input, NULL, sink, SIZE_MAX / 8, &written);
+    
+    if (length) {
+        *length = result == STEG_SUCCESS ? written : 0;
+    }
+    
+    return result;
 }
 
 // Extract message from image using LSB steganography
@@ -141,48 +458,87 @@ int extract_message(char* buffer, size_t max_len, FILE* input) {
         return STEG_FILE_ERROR;
     }
     
-    // Validate input BMP format
-    int validation_result = read_bmp_header(input);
+    size_t length = 0;
+    int result = extract_payload((unsigned char*)buffer, max_len - 1, &length, input);
+    
+    // Ensure null termination
+    buffer[length] = '\0';
+    
+    return result;
+}
+
+// Embed payload into a BMP image held in memory
+int embed_payload_buffer(const unsigned char* payload, size_t length, unsigned char* image, size_t image_size) {
+    steg_bmp_layout_t layout;
+    steg_strips_t strips;
+    
+    if (!payload || !image) {
+        return STEG_FILE_ERROR;
+    }
+    
+    // Parse and validate the image headers once
+    int validation_result = steg_bmp_parse_layout(image, image_size, image_size, &layout);
     if (validation_result != STEG_SUCCESS) {
         return validation_result;
     }
     
-    // Skip header
-    fseek(input, BMP_HEADER_SIZE, SEEK_SET);
+    int result = steg_strips_open_memory(&strips, &layout, image, steg_block_size);
+    if (result == STEG_SUCCESS) {
+        result = steg_embed_strips(&strips, payload, NULL, length, NULL);
+    }
+    steg_strips_close(&strips);
+    
+    return result;
+}
+
+// Extract payload from a BMP image held in memory
+int extract_payload_buffer(unsigned char* buffer, size_t max_len, size_t* length,
+                           const unsigned char* image, size_t image_size) {
+    steg_bmp_layout_t layout;
+    steg_strips_t strips;
+    
+    if (!buffer || !length || !image) {
+        return STEG_FILE_ERROR;
+    }
+    *length = 0;
+    
+    // Parse and validate the image headers once
+    int validation_result = steg_bmp_parse_layout(image, image_size, image_size, &layout);
+    if (validation_result != STEG_SUCCESS) {
+        return validation_result;
+    }
     
-    size_t buffer_pos = 0;
+    // Extraction never stores, so the image is only read
+    int result = steg_strips_open_memory(&strips, &layout, (unsigned char*)image, steg_block_size);
+    if (result == STEG_SUCCESS) {
+        result = steg_extract_strips(&strips, buffer, NULL, max_len, length);
+    }
+    steg_strips_close(&strips);
     
-    // Extract message character by character
-    while (buffer_pos < max_len - 1) {
-        char extracted_char = 0;
-        
-        // Extract 8 bits to form a character
-        for (int bit_pos = 7; bit_pos >= 0; bit_pos--) {
-            unsigned char pixel_byte;
-            if (fread(&pixel_byte, 1, 1, input) != 1) {
-                return STEG_FILE_ERROR;
-            }
-            
-            // Extract LSB: bit = pixel_byte & 0x01
-            int bit = pixel_byte & 1;
-            
-            // Build character: char = (bit7 << 7) | (bit6 << 6) | ... | bit0
-            extracted_char |= (bit << bit_pos);
-        }
-        
-        // Store character in buffer
-        buffer[buffer_pos++] = extracted_char;
-        
-        // Check for null terminator
-        if (extracted_char == '\0') {
-            break;
-        }
+    return result;
+}
+
+// Embed message into a BMP image held in memory
+int embed_message_buffer(const char* message, unsigned char* image, size_t image_size) {
+    if (!message) {
+        return STEG_FILE_ERROR;
     }
+    return embed_payload_buffer((const unsigned char*)message, strlen(message), image, image_size);
+}
+
+// Extract message from a BMP image held in memory
+int extract_message_buffer(char* buffer, size_t max_len, const unsigned char* image, size_t image_size) {
+    if (!buffer || max_len == 0) {
+        return STEG_FILE_ERROR;
+    }
+    
+    size_t length = 0;
+    int result = extract_payload_buffer((unsigned char*)buffer, max_len - 1, &length, image, image_size);
     
     // Ensure null termination
-    buffer[buffer_pos] = '\0';
+    buffer[length] = '\0';
     
-    return STEG_SUCCESS;
+    return result;
 }
 
 // Print error messages
@@ -195,7 +551,7 @@ void print_error(int error_code) {
             fprintf(stderr, "Error: File I/O operation failed\n");
             break;
         case STEG_INVALID_BMP:
-            fprintf(stderr, "Error: Invalid BMP format (must be 24-bit uncompressed)\n");
+            fprintf(stderr, "Error: Invalid BMP format (must be 24-bit or 32-bit uncompressed)\n");
             break;
         case STEG_INSUFFICIENT_CAPACITY:
             fprintf(stderr, "Error: Image too small to hold the message\n");
@@ -203,6 +559,12 @@ void print_error(int error_code) {
         case STEG_MEMORY_ERROR:
             fprintf(stderr, "Error: Memory allocation failed\n");
             break;
+        case STEG_INVALID_ARGUMENT:
+            fprintf(stderr, "Error: Invalid argument\n");
+            break;
+        case STEG_NO_PAYLOAD_HEADER:
+            fprintf(stderr, "Error: No payload header found in image\n");
+            break;
         default:
             fprintf(stderr, "Error: Unknown error occurred\n");
             break;
@@ -0,0 +1,613 @@
+/**
+ * @file steg_batch_io.c
+ * @brief LSB Steganography Tool - Whole-File I/O for Batch Mode
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * io_uring engine built on the raw io_uring_setup/io_uring_enter/
+ * io_uring_register system calls (no liburing), and the pread/pwrite
+ * fallback on the thread pool.
+ *
+ * Every file is a small state machine driven by its completions: a
+ * load issues openat and statx together, then reads until the file is
+ * in memory and closes it; a store opens, writes and closes. The
+ * user_data of each submission carries the file index and the step.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/steg_batch_io.h"
+#include "../include/steg.h"
+#include "../include/steg_io.h"
+#include "../include/thread_pool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// Permissions of files created by a store, before the umask
+#define STORE_MODE 0644
+
+// Look up a batch I/O backend by name
+int steg_parse_batch_io(const char* name) {
+    if (strcmp(name, "stdio") == 0) {
+        return STEG_BATCH_IO_STDIO;
+    }
+    if (strcmp(name, "pread") == 0) {
+        return STEG_BATCH_IO_PREAD;
+    }
+    if (strcmp(name, "uring") == 0 || strcmp(name, "io_uring") == 0) {
+        return STEG_BATCH_IO_URING;
+    }
+    return -1;
+}
+
+// Get a printable name for a batch I/O backend
+const char* steg_batch_io_name(int backend) {
+    switch (backend) {
+        case STEG_BATCH_IO_PREAD:
+            return "pread";
+        case STEG_BATCH_IO_URING:
+            return "io_uring";
+        default:
+            return "stdio";
+    }
+}
+
+// ============================================================================
+// PREAD FALLBACK
+// ============================================================================
+
+// Files of one load or store on the thread pool
+typedef struct {
+    steg_file_t* files;
+    size_t max_size;
+} file_job_t;
+
+// Load one file with open/fstat/pread/close
+static void load_file_task(void* arg, size_t index) {
+    file_job_t* job = arg;
+    steg_file_t* file = &job->files[index];
+    struct stat file_stat;
+    
+    file->data = NULL;
+    file->size = 0;
+    file->result = STEG_FILE_ERROR;
+    
+    int fd = open(file->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    if (fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode)) {
+        file->size = (size_t)file_stat.st_size;
+        file->result = STEG_SUCCESS;
+        if (file->size > 0 && file->size <= job->max_size) {
+            file->data = malloc(file->size);
+            if (!file->data || steg_pread_all(fd, file->data, file->size, 0) != (ssize_t)file->size) {
+                free(file->data);
+                file->data = NULL;
+                file->result = STEG_FILE_ERROR;
+            }
+        }
+    }
+    close(fd);
+}
+
+// Store one file with open/pwrite/close
+static void store_file_task(void* arg, size_t index) {
+    file_job_t* job = arg;
+    steg_file_t* file = &job->files[index];
+    
+    file->result = STEG_FILE_ERROR;
+    int fd = open(file->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, STORE_MODE);
+    if (fd < 0) {
+        return;
+    }
+    int result = steg_pwrite_all(fd, file->data, file->size, 0);
+    if (close(fd) == 0) {
+        file->result = result;
+    }
+}
+
+// ============================================================================
+// IO_URING ENGINE
+// ============================================================================
+
+#ifdef __linux__
+
+// Submission queue entries per ring; the completion queue is twice as big
+#define RING_ENTRIES 128
+
+// Steps of a file, kept in the low bits of user_data
+#define STEP_OPEN 0
+#define STEP_STATX 1
+#define STEP_TRANSFER 2
+#define STEP_CLOSE 3
+#define STEP_BITS 2
+
+// A mapped io_uring instance
+typedef struct {
+    int fd;
+    unsigned entries;
+    void* sq_map;
+    size_t sq_map_size;
+    void* cq_map;
+    size_t cq_map_size;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    unsigned queued;        // Entries written but not yet submitted
+    unsigned in_flight;     // Entries submitted or queued, not yet completed
+} ring_t;
+
+// Progress of one file through the ring
+typedef struct {
+    int fd;
+    int waiting;            // Open and statx completions still due
+    int failed;
+    size_t done;            // Bytes read or written so far
+    struct statx stx;
+} file_state_t;
+
+// io_uring_setup(2)
+static int ring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+// io_uring_enter(2) without a signal mask
+static int ring_enter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+
+// io_uring_register(2)
+static int ring_register(int fd, unsigned opcode, void* arg, unsigned count) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+// Unmap and close a ring
+static void ring_close(ring_t* ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_map && ring->cq_map != MAP_FAILED && ring->cq_map != ring->sq_map) {
+        munmap(ring->cq_map, ring->cq_map_size);
+    }
+    if (ring->sq_map && ring->sq_map != MAP_FAILED) {
+        munmap(ring->sq_map, ring->sq_map_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+}
+
+// Whether the kernel behind a ring supports every operation we issue
+static int ring_supports_ops(int fd) {
+    static const int needed[] = { IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ,
+                                  IORING_OP_WRITE, IORING_OP_CLOSE };
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = calloc(1, size);
+    int supported = 0;
+    
+    if (probe && ring_register(fd, IORING_REGISTER_PROBE, probe, 256) == 0) {
+        supported = 1;
+        for (size_t i = 0; i < sizeof(needed) / sizeof(needed[0]); i++) {
+            if (needed[i] > probe->last_op || !(probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED)) {
+                supported = 0;
+            }
+        }
+    }
+    free(probe);
+    return supported;
+}
+
+// Create and map a ring
+static int ring_open(ring_t* ring) {
+    struct io_uring_params params;
+    
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    ring->fd = ring_setup(RING_ENTRIES, &params);
+    if (ring->fd < 0) {
+        return STEG_FILE_ERROR;
+    }
+    ring->entries = params.sq_entries;
+    
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_size > ring->sq_map_size) {
+            ring->sq_map_size = ring->cq_map_size;
+        }
+        ring->cq_map_size = ring->sq_map_size;
+    }
+    
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        ring_close(ring);
+        return STEG_FILE_ERROR;
+    }
+    ring->cq_map = ring->sq_map;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->cq_map == MAP_FAILED || ring->sqes == MAP_FAILED || !ring_supports_ops(ring->fd)) {
+        ring_close(ring);
+        return STEG_FILE_ERROR;
+    }
+    
+    unsigned char* sq = ring->sq_map;
+    unsigned char* cq = ring->cq_map;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return STEG_SUCCESS;
+}
+
+// Queue a submission; the caller keeps in_flight within the ring size
+static struct io_uring_sqe* ring_queue(ring_t* ring, int opcode, size_t index, int step) {
+    unsigned tail = *ring->sq_tail + ring->queued;
+    unsigned slot = tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[slot];
+    
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (unsigned char)opcode;
+    sqe->user_data = (unsigned long long)index << STEP_BITS | (unsigned)step;
+    ring->sq_array[slot] = slot;
+    ring->queued++;
+    ring->in_flight++;
+    return sqe;
+}
+
+// Submit everything queued and wait for at least one completion
+static int ring_submit_and_wait(ring_t* ring) {
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->queued, __ATOMIC_RELEASE);
+    
+    unsigned submit = ring->queued;
+    for (;;) {
+        int n = ring_enter(ring->fd, submit, 1, IORING_ENTER_GETEVENTS);
+        if (n >= 0) {
+            submit -= (unsigned)n < submit ? (unsigned)n : submit;
+            if (submit == 0) {
+                break;
+            }
+        } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return STEG_FILE_ERROR;
+        }
+    }
+    ring->queued = 0;
+    return STEG_SUCCESS;
+}
+
+// Queue the next step of a load once its open and statx have both completed
+static void load_advance(ring_t* ring, steg_file_t* files, file_state_t* states, size_t index,
+                         size_t max_size) {
+    steg_file_t* file = &files[index];
+    file_state_t* state = &states[index];
+    
+    if (state->waiting > 0) {
+        return;
+    }
+    if (!state->failed && file->size > 0 && file->size <= max_size && state->done < file->size) {
+        if (!file->data) {
+            file->data = malloc(file->size);
+            if (!file->data) {
+                state->failed = 1;
+            }
+        }
+        if (file->data) {
+            struct io_uring_sqe* sqe = ring_queue(ring, IORING_OP_READ, index, STEP_TRANSFER);
+            sqe->fd = state->fd;
+            sqe->addr = (unsigned long long)(uintptr_t)(file->data + state->done);
+            sqe->len = (unsigned)(file->size - state->done < 1u << 30 ? file->size - state->done : 1u << 30);
+            sqe->off = state->done;
+            return;
+        }
+    }
+    if (state->fd >= 0) {
+        struct io_uring_sqe* sqe = ring_queue(ring, IORING_OP_CLOSE, index, STEP_CLOSE);
+        sqe->fd = state->fd;
+        state->fd = -1;
+        return;
+    }
+    
+    // Nothing left in flight for this file
+    state->waiting = -1;
+}
+
+// Queue the next step of a store
+static void store_advance(ring_t* ring, steg_file_t* files, file_state_t* states, size_t index) {
+    steg_file_t* file = &files[index];
+    file_state_t* state = &states[index];
+    
+    if (!state->failed && state->fd >= 0 && state->done < file->size) {
+        struct io_uring_sqe* sqe = ring_queue(ring, IORING_OP_WRITE, index, STEP_TRANSFER);
+        sqe->fd = state->fd;
+        sqe->addr = (unsigned long long)(uintptr_t)(file->data + state->done);
+        sqe->len = (unsigned)(file->size - state->done < 1u << 30 ? file->size - state->done : 1u << 30);
+        sqe->off = state->done;
+        return;
+    }
+    if (state->fd >= 0) {
+        struct io_uring_sqe* sqe = ring_queue(ring, IORING_OP_CLOSE, index, STEP_CLOSE);
+        sqe->fd = state->fd;
+        state->fd = -1;
+        return;
+    }
+    state->waiting = -1;
+}
+
+// Apply one completion to its file and queue the file's next step
+static void ring_complete(ring_t* ring, steg_file_t* files, file_state_t* states, size_t max_size,
+                          int store, const struct io_uring_cqe* cqe) {
+    size_t index = (size_t)(cqe->user_data >> STEP_BITS);
+    int step = (int)(cqe->user_data & ((1u << STEP_BITS) - 1));
+    steg_file_t* file = &files[index];
+    file_state_t* state = &states[index];
+    int res = cqe->res;
+    
+    switch (step) {
+        case STEP_OPEN:
+            state->waiting--;
+            if (res < 0) {
+                state->failed = 1;
+            } else {
+                state->fd = res;
+            }
+            break;
+        case STEP_STATX:
+            state->waiting--;
+            if (res < 0 || !S_ISREG(state->stx.stx_mode)) {
+                state->failed = 1;
+            } else {
+                file->size = (size_t)state->stx.stx_size;
+            }
+            break;
+        case STEP_TRANSFER:
+            if (res == -EINTR || res == -EAGAIN) {
+                break;
+            }
+            if (res <= 0) {
+                // A read that hits the end early means the file shrank
+                state->failed = 1;
+            } else {
+                state->done += (size_t)res;
+            }
+            break;
+        default:
+            if (res < 0 && store) {
+                state->failed = 1;
+            }
+            break;
+    }
+    
+    if (store) {
+        store_advance(ring, files, states, index);
+    } else {
+        load_advance(ring, files, states, index, max_size);
+    }
+    
+    // Record the outcome once the file has nothing left in flight
+    if (state->waiting < 0) {
+        file->result = state->failed ? STEG_FILE_ERROR : STEG_SUCCESS;
+        if (state->failed && !store) {
+            free(file->data);
+            file->data = NULL;
+        }
+    }
+}
+
+// After io_uring_enter() failed: withdraw the entries the kernel never
+// consumed and wait for the rest, whose statx results and reads still
+// land in states and the load buffers. Descriptors opened meanwhile, or
+// whose close was withdrawn, are recorded so they can be closed. Fails
+// if the ring cannot be waited on
+static int ring_drain(ring_t* ring, file_state_t* states) {
+    // Without SQPOLL the kernel only consumes entries inside
+    // io_uring_enter(), so unconsumed ones can simply be taken back
+    unsigned consumed = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    for (unsigned i = consumed; i != *ring->sq_tail; i++) {
+        const struct io_uring_sqe* sqe = &ring->sqes[ring->sq_array[i & *ring->sq_mask]];
+        if (sqe->opcode == IORING_OP_CLOSE) {
+            states[sqe->user_data >> STEP_BITS].fd = sqe->fd;
+        }
+        ring->in_flight--;
+    }
+    __atomic_store_n(ring->sq_tail, consumed, __ATOMIC_RELEASE);
+    ring->queued = 0;
+    
+    while (ring->in_flight > 0) {
+        if (ring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+            errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return STEG_FILE_ERROR;
+        }
+        
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            const struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+            size_t index = (size_t)(cqe->user_data >> STEP_BITS);
+            if ((cqe->user_data & ((1u << STEP_BITS) - 1)) == STEP_OPEN && cqe->res >= 0) {
+                states[index].fd = cqe->res;
+            }
+            ring->in_flight--;
+            head++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return STEG_SUCCESS;
+}
+
+// Run a load or store of every file through one ring
+static int ring_run(steg_file_t* files, size_t count, size_t max_size, int store) {
+    ring_t ring;
+    
+    if (ring_open(&ring) != STEG_SUCCESS) {
+        return STEG_FILE_ERROR;
+    }
+    file_state_t* states = calloc(count ? count : 1, sizeof(file_state_t));
+    if (!states) {
+        ring_close(&ring);
+        return STEG_MEMORY_ERROR;
+    }
+    
+    size_t next = 0;
+    size_t finished = 0;
+    int result = STEG_SUCCESS;
+    
+    while (finished < count) {
+        // Start files while a new one's first submissions still fit
+        while (next < count && ring.in_flight + 2 <= ring.entries) {
+            steg_file_t* file = &files[next];
+            file_state_t* state = &states[next];
+            state->fd = -1;
+            file->result = STEG_FILE_ERROR;
+            if (store) {
+                struct io_uring_sqe* sqe = ring_queue(&ring, IORING_OP_OPENAT, next, STEP_OPEN);
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (unsigned long long)(uintptr_t)file->path;
+                sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+                sqe->len = STORE_MODE;
+                state->waiting = 1;
+            } else {
+                file->data = NULL;
+                file->size = 0;
+                struct io_uring_sqe* sqe = ring_queue(&ring, IORING_OP_OPENAT, next, STEP_OPEN);
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (unsigned long long)(uintptr_t)file->path;
+                sqe->open_flags = O_RDONLY | O_CLOEXEC;
+                sqe = ring_queue(&ring, IORING_OP_STATX, next, STEP_STATX);
+                sqe->fd = AT_FDCWD;
+                sqe->addr = (unsigned long long)(uintptr_t)file->path;
+                sqe->len = STATX_TYPE | STATX_SIZE;
+                sqe->off = (unsigned long long)(uintptr_t)&state->stx;
+                state->waiting = 2;
+            }
+            next++;
+        }
+        
+        if (ring_submit_and_wait(&ring) != STEG_SUCCESS) {
+            result = STEG_FILE_ERROR;
+            break;
+        }
+        
+        // Reap every completion that is ready
+        unsigned head = *ring.cq_head;
+        unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            const struct io_uring_cqe* cqe = &ring.cqes[head & *ring.cq_mask];
+            size_t index = (size_t)(cqe->user_data >> STEP_BITS);
+            ring.in_flight--;
+            ring_complete(&ring, files, states, max_size, store, cqe);
+            if (states[index].waiting < 0) {
+                finished++;
+            }
+            head++;
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+    
+    // The ring failed under us: wait out what the kernel still owns,
+    // then fail every file that did not finish and close what is open
+    if (result != STEG_SUCCESS) {
+        int drained = ring_drain(&ring, states) == STEG_SUCCESS;
+        for (size_t i = 0; i < count; i++) {
+            if (i < next) {
+                if (states[i].waiting < 0) {
+                    continue;
+                }
+                if (states[i].fd >= 0) {
+                    close(states[i].fd);
+                }
+                // Buffers the kernel may still write to are left alone
+                if (!store && drained) {
+                    free(files[i].data);
+                }
+            }
+            if (!store) {
+                files[i].data = NULL;
+            }
+            files[i].result = STEG_FILE_ERROR;
+        }
+        if (!drained) {
+            // Same for states, which statx may still fill in
+            ring_close(&ring);
+            return result;
+        }
+    }
+    
+    free(states);
+    ring_close(&ring);
+    return result;
+}
+
+#endif // __linux__
+
+// Backend that will actually serve a request for backend
+int steg_batch_io_resolve(int backend) {
+    if (backend != STEG_BATCH_IO_URING) {
+        return backend;
+    }
+#ifdef __linux__
+    static int available = -1;
+    if (available < 0) {
+        ring_t ring;
+        available = ring_open(&ring) == STEG_SUCCESS;
+        if (available) {
+            ring_close(&ring);
+        }
+    }
+    if (available) {
+        return STEG_BATCH_IO_URING;
+    }
+#endif
+    return STEG_BATCH_IO_PREAD;
+}
+
+// Load whole files into memory
+int steg_load_files(steg_file_t* files, size_t count, size_t max_size, int backend) {
+#ifdef __linux__
+    if (steg_batch_io_resolve(backend) == STEG_BATCH_IO_URING) {
+        return ring_run(files, count, max_size, 0);
+    }
+#endif
+    file_job_t job = { files, max_size };
+    steg_thread_pool_run(steg_thread_pool_shared(), count, load_file_task, &job);
+    return STEG_SUCCESS;
+}
+
+// Create or truncate files and store data in them
+int steg_store_files(steg_file_t* files, size_t count, int backend) {
+#ifdef __linux__
+    if (steg_batch_io_resolve(backend) == STEG_BATCH_IO_URING) {
+        return ring_run(files, count, 0, 1);
+    }
+#endif
+    file_job_t job = { files, 0 };
+    steg_thread_pool_run(steg_thread_pool_shared(), count, store_file_task, &job);
+    return STEG_SUCCESS;
+}
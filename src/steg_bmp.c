@@ -0,0 +1,1011 @@
+/**
+ * @file steg_bmp.c
+ * @brief LSB Steganography Tool - Row-Aware BMP Pixel Engine
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * Pixel layout parsing, the strip cursor over stdio streams, file
+ * descriptors and memory, and the embed/extract engine that runs the
+ * LSB kernels over the logical pixel bytes of each strip.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/steg_bmp.h"
+#include "../include/steg.h"
+#include "../include/steg_io.h"
+#include "../include/steg_kernels.h"
+#include "../include/steg_pipeline.h"
+#include "../include/thread_pool.h"
+#include <sys/stat.h>
+
+// Smallest stripe worth handing to another thread, in pixel bytes
+#define STEG_STRIPE_MIN_BYTES (64 * 1024)
+
+// Stripes per pool thread, so idle workers have something to steal
+#define STEG_STRIPES_PER_THREAD 4
+
+// Work a stripe does on its slice of a run
+#define STRIPE_EMBED 0
+#define STRIPE_PACK 1
+#define STRIPE_UNPACK 2
+#define STRIPE_EXTRACT 3
+
+// One pixel run cut into stripes for the thread pool
+typedef struct {
+    int op;                 // One of the STRIPE_* values
+    unsigned char* pixels;  // Pixel run, or 4-byte pixels for pack/unpack
+    unsigned char* data;    // Payload bytes, or packed channel bytes
+    size_t length;          // Payload bytes (embed/extract)
+    size_t units;           // Payload groups (embed/extract) or pixels (pack/unpack)
+    size_t per_stripe;      // Units per stripe
+    size_t stripes;         // Number of stripes
+    int bits;               // Payload bits per pixel byte
+    int alpha_index;        // Skipped byte of 4-byte pixels
+    const steg_engine_t* engine;
+} stripe_job_t;
+
+// Byte of a 32-bit pixel selected by a BI_BITFIELDS mask, or -1
+static int mask_byte(const unsigned char* mask) {
+    uint32_t value = (uint32_t)mask[0] | (uint32_t)mask[1] << 8 |
+                     (uint32_t)mask[2] << 16 | (uint32_t)mask[3] << 24;
+    
+    for (int b = 0; b < 4; b++) {
+        if (value == (uint32_t)0xFF << (8 * b)) {
+            return b;
+        }
+    }
+    return -1;
+}
+
+// Find the non-colour byte of a 32-bit pixel from its channel masks
+static int parse_alpha_index(const unsigned char* headers, size_t size, const bmp_info_header_t* info_header,
+                             uint32_t data_offset) {
+    // BI_RGB stores BGRX
+    if (info_header->compression != BMP_BI_BITFIELDS) {
+        return 3;
+    }
+    
+    // The R, G, B masks follow a 40-byte header and sit inside a V4/V5 one
+    size_t masks_end = sizeof(bmp_file_header_t) + BMP_INFO_HEADER_SIZE + 12;
+    if (size < masks_end || data_offset < masks_end) {
+        return -1;
+    }
+    
+    const unsigned char* masks = headers + sizeof(bmp_file_header_t) + BMP_INFO_HEADER_SIZE;
+    int red = mask_byte(masks);
+    int green = mask_byte(masks + 4);
+    int blue = mask_byte(masks + 8);
+    
+    // Only whole, distinct bytes can be treated as a channel stream
+    if (red < 0 || green < 0 || blue < 0 || red == green || red == blue || green == blue) {
+        return -1;
+    }
+    return 6 - red - green - blue;
+}
+
+// Parse the pixel layout from the BMP headers
+int steg_bmp_parse_layout(const unsigned char* headers, size_t size, uint64_t file_size,
+                          steg_bmp_layout_t* layout) {
+    bmp_file_header_t file_header;
+    bmp_info_header_t info_header;
+    
+    int validation_result = validate_bmp_buffer(headers, size);
+    if (validation_result != STEG_SUCCESS) {
+        return validation_result;
+    }
+    
+    memcpy(&file_header, headers, sizeof(bmp_file_header_t));
+    memcpy(&info_header, headers + sizeof(bmp_file_header_t), sizeof(bmp_info_header_t));
+    
+    if (info_header.width <= 0 || info_header.height == 0 ||
+        file_header.data_offset < sizeof(bmp_file_header_t) + (uint64_t)info_header.header_size ||
+        file_header.data_offset > file_size) {
+        return STEG_INVALID_BMP;
+    }
+    
+    int alpha_index = 3;
+    if (info_header.bits_per_pixel == 32) {
+        alpha_index = parse_alpha_index(headers, size, &info_header, file_header.data_offset);
+        if (alpha_index < 0) {
+            return STEG_INVALID_BMP;
+        }
+    }
+    
+    uint64_t height = info_header.height < 0 ? -(int64_t)info_header.height : info_header.height;
+    uint64_t pixel_size = info_header.bits_per_pixel / 8;
+    uint64_t row_raw = (uint64_t)info_header.width * pixel_size;
+    uint64_t row_stride = (row_raw + 3) & ~(uint64_t)3;
+    
+    // Count only rows the file actually holds; the last may lack its padding
+    uint64_t pixel_area = file_size - file_header.data_offset;
+    uint64_t rows = (pixel_area + (row_stride - row_raw)) / row_stride;
+    if (rows > height) {
+        rows = height;
+    }
+    
+    layout->data_offset = file_header.data_offset;
+    layout->bits_per_pixel = info_header.bits_per_pixel;
+    layout->pixel_size = (uint16_t)pixel_size;
+    layout->alpha_index = alpha_index;
+    layout->width = (size_t)info_header.width;
+    layout->row_bytes = (size_t)info_header.width * 3;
+    layout->row_stride = (size_t)row_stride;
+    layout->rows = (size_t)rows;
+    
+    return STEG_SUCCESS;
+}
+
+// Read and parse the pixel layout of a BMP stream
+int steg_bmp_read_layout(FILE* file, steg_bmp_layout_t* layout) {
+    unsigned char headers[BMP_LAYOUT_HEADER_SIZE];
+    struct stat file_stat;
+    
+    if (!file || !layout) {
+        return STEG_FILE_ERROR;
+    }
+    
+    long current_pos = ftell(file);
+    
+    rewind(file);
+    size_t header_len = fread(headers, 1, BMP_LAYOUT_HEADER_SIZE, file);
+    
+    // Get file size
+    uint64_t file_size;
+    if (fstat(fileno(file), &file_stat) == 0 && S_ISREG(file_stat.st_mode)) {
+        file_size = (uint64_t)file_stat.st_size;
+    } else {
+        fseek(file, 0, SEEK_END);
+        file_size = (uint64_t)ftell(file);
+    }
+    
+    if (current_pos >= 0) {
+        fseek(file, current_pos, SEEK_SET);
+    }
+    
+    return steg_bmp_parse_layout(headers, header_len, file_size, layout);
+}
+
+// Number of logical pixel bytes (colour channels, no padding) in the image
+size_t steg_bmp_pixel_bytes(const steg_bmp_layout_t* layout) {
+    return layout->row_bytes * layout->rows;
+}
+
+// Greatest common divisor, used to keep full strips group-aligned
+static size_t gcd(size_t a, size_t b) {
+    while (b != 0) {
+        size_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Run one stripe; payload group g always maps to pixel bytes [8g, 8g + 8)
+static void stripe_task(void* arg, size_t index) {
+    stripe_job_t* job = arg;
+    size_t first = index * job->per_stripe;
+    size_t count = job->units - first < job->per_stripe ? job->units - first : job->per_stripe;
+    
+    switch (job->op) {
+        case STRIPE_EMBED:
+        case STRIPE_EXTRACT: {
+            // The last stripe also takes the trailing partial group
+            size_t bits = (size_t)job->bits;
+            size_t n = index + 1 == job->stripes ? job->length - first * bits : count * bits;
+            if (job->op == STRIPE_EMBED) {
+                lsb_embed(job->engine->kernel, job->pixels + first * 8, job->data + first * bits, n, job->bits);
+            } else {
+                lsb_extract(job->engine->kernel, job->pixels + first * 8, job->data + first * bits, n, job->bits);
+            }
+            break;
+        }
+        case STRIPE_PACK:
+            job->engine->kernel->pack(job->pixels + first * 4, job->data + first * 3, count, job->alpha_index);
+            break;
+        default:
+            job->engine->kernel->unpack(job->data + first * 3, job->pixels + first * 4, count, job->alpha_index);
+            break;
+    }
+}
+
+// Cut a job into stripes of at least min_units and run them on the engine's pool
+static void run_stripes(stripe_job_t* job, size_t units, size_t min_units) {
+    steg_thread_pool_t* pool = job->engine->pool;
+    size_t threads = (size_t)steg_thread_pool_threads(pool);
+    size_t stripes = units / min_units;
+    
+    if (stripes > threads * STEG_STRIPES_PER_THREAD) {
+        stripes = threads * STEG_STRIPES_PER_THREAD;
+    }
+    if (stripes == 0) {
+        stripes = 1;
+    }
+    
+    job->units = units;
+    job->per_stripe = (units + stripes - 1) / stripes;
+    job->stripes = job->per_stripe ? (units + job->per_stripe - 1) / job->per_stripe : 1;
+    steg_thread_pool_run(pool, job->stripes, stripe_task, job);
+}
+
+// Embed a payload run, split across threads when it is large enough
+static void embed_run(const steg_engine_t* engine, unsigned char* pixels, const unsigned char* payload,
+                      size_t length, int bits) {
+    stripe_job_t job = { STRIPE_EMBED, pixels, (unsigned char*)payload, length, 0, 0, 0, bits, 0, engine };
+    run_stripes(&job, length / (size_t)bits, STEG_STRIPE_MIN_BYTES / 8);
+}
+
+// Extract a payload run of known length, split across threads
+static void extract_run(const steg_engine_t* engine, const unsigned char* pixels, unsigned char* payload,
+                        size_t length, int bits) {
+    stripe_job_t job = { STRIPE_EXTRACT, (unsigned char*)pixels, payload, length, 0, 0, 0, bits, 0, engine };
+    run_stripes(&job, length / (size_t)bits, STEG_STRIPE_MIN_BYTES / 8);
+}
+
+// Pack or unpack the 4-byte pixels of a strip, split across threads
+static void convert_channels(const steg_engine_t* engine, int op, unsigned char* pixels, unsigned char* channels,
+                             size_t count, int alpha_index) {
+    stripe_job_t job = { op, pixels, channels, 0, 0, 0, 0, 0, alpha_index, engine };
+    run_stripes(&job, count, STEG_STRIPE_MIN_BYTES / 4);
+}
+
+// Rows in a full strip: one block per thread, at least one row and the
+// whole payload header; a multiple of the row count that makes the
+// logical size a multiple of 8
+static size_t strip_rows_for(const steg_bmp_layout_t* layout, size_t block_size, const steg_engine_t* engine) {
+    size_t rows = block_size * (size_t)steg_thread_pool_threads(engine->pool) / layout->row_stride;
+    size_t header_rows = (STEG_PAYLOAD_HEADER_PIXELS + layout->row_bytes - 1) / layout->row_bytes;
+    size_t align = 8 / gcd(layout->row_bytes, 8);
+    if (rows < header_rows) {
+        rows = header_rows;
+    }
+    return (rows + align - 1) / align * align;
+}
+
+// Fill engine settings from the process-wide ones
+void steg_engine_defaults(steg_engine_t* engine) {
+    engine->kernel = lsb_active_kernel();
+    engine->pool = steg_thread_pool_shared();
+    engine->bits = steg_get_bits_per_channel();
+    engine->pipeline_depth = steg_get_pipeline_depth();
+}
+
+// Shared cursor setup: engine settings (the process's when engine is
+// NULL), strip size and buffers for gathered rows, in storage when the
+// caller provides it
+static int strips_init(steg_strips_t* strips, const steg_bmp_layout_t* layout, size_t block_size,
+                       const steg_engine_t* engine, int kind, unsigned char* storage) {
+    memset(strips, 0, sizeof(*strips));
+    strips->layout = *layout;
+    strips->kind = kind;
+    strips->fd = -1;
+    strips->out_fd = -1;
+    if (engine) {
+        strips->engine = *engine;
+    } else {
+        steg_engine_defaults(&strips->engine);
+    }
+    
+    if (layout->row_bytes == 0) {
+        return STEG_INVALID_BMP;
+    }
+    
+    size_t rows = strip_rows_for(layout, block_size, &strips->engine);
+    strips->strip_rows = rows;
+    
+    int padded = layout->row_stride != layout->row_bytes;
+    size_t raw_size = kind == STEG_STRIPS_MEMORY ? 0 : rows * layout->row_stride;
+    size_t pixel_size = padded ? rows * layout->row_bytes : 0;
+    
+    if (!storage && raw_size + pixel_size > 0) {
+        strips->buffer = malloc(raw_size + pixel_size);
+        if (!strips->buffer) {
+            return STEG_MEMORY_ERROR;
+        }
+    }
+    
+    unsigned char* base = storage ? storage : strips->buffer;
+    strips->raw = base;
+    strips->pixels = padded ? base + raw_size : NULL;
+    return STEG_SUCCESS;
+}
+
+// Open a strip cursor over a stdio stream
+int steg_strips_open_stream(steg_strips_t* strips, const steg_bmp_layout_t* layout,
+                            FILE* input, FILE* output, size_t block_size) {
+    int result = strips_init(strips, layout, block_size, NULL, STEG_STRIPS_STREAM, NULL);
+    strips->file = input;
+    strips->out = output;
+    if (output) {
+        long out_pos = ftell(output);
+        strips->out_base = out_pos < 0 ? 0 : out_pos - (long)layout->data_offset;
+    }
+    return result;
+}
+
+// Open a strip cursor over file descriptors
+int steg_strips_open_fd(steg_strips_t* strips, const steg_bmp_layout_t* layout,
+                        int fd, int out_fd, off_t out_base, size_t block_size) {
+    int result = strips_init(strips, layout, block_size, NULL, STEG_STRIPS_FD, NULL);
+    strips->fd = fd;
+    strips->out_fd = out_fd;
+    strips->out_base = (long)out_base;
+    return result;
+}
+
+// Open a strip cursor over an image held in memory
+int steg_strips_open_memory(steg_strips_t* strips, const steg_bmp_layout_t* layout,
+                            unsigned char* image, size_t block_size) {
+    int result = strips_init(strips, layout, block_size, NULL, STEG_STRIPS_MEMORY, NULL);
+    strips->image = image;
+    return result;
+}
+
+// Scratch bytes a memory strip cursor gathers padded rows into
+size_t steg_strips_memory_scratch(const steg_bmp_layout_t* layout, size_t block_size,
+                                  const steg_engine_t* engine) {
+    if (layout->row_bytes == 0 || layout->row_stride == layout->row_bytes) {
+        return 0;
+    }
+    return strip_rows_for(layout, block_size, engine) * layout->row_bytes;
+}
+
+// Open a strip cursor over an image held in memory, in caller scratch
+int steg_strips_open_memory_scratch(steg_strips_t* strips, const steg_bmp_layout_t* layout,
+                                    unsigned char* image, size_t block_size, const steg_engine_t* engine,
+                                    unsigned char* scratch) {
+    int result = strips_init(strips, layout, block_size, engine, STEG_STRIPS_MEMORY, scratch);
+    strips->image = image;
+    return result;
+}
+
+// File offset of the first byte of a row
+static long row_offset(const steg_strips_t* strips, size_t row) {
+    return (long)strips->layout.data_offset + (long)(row * strips->layout.row_stride);
+}
+
+// Pixel bytes of a row as stored, without padding
+static size_t row_raw_bytes(const steg_bmp_layout_t* layout) {
+    return layout->width * layout->pixel_size;
+}
+
+// Read the raw rows of the next strip, without gathering them
+static size_t strips_read(steg_strips_t* strips, size_t needed) {
+    const steg_bmp_layout_t* layout = &strips->layout;
+    size_t first_row = strips->next_row;
+    
+    strips->start = first_row * layout->row_bytes;
+    strips->length = 0;
+    strips->rows = 0;
+    
+    if (first_row >= layout->rows || needed == 0) {
+        return 0;
+    }
+    
+    // Only as many whole rows as the caller needs, up to a full strip.
+    // Callers with no length pass limits near SIZE_MAX, so the request
+    // is clamped to the pixel bytes left before it is rounded up
+    size_t remaining = (layout->rows - first_row) * layout->row_bytes;
+    if (needed > remaining) {
+        needed = remaining;
+    }
+    size_t rows = needed / layout->row_bytes + (needed % layout->row_bytes != 0);
+    if (rows > strips->strip_rows) {
+        rows = strips->strip_rows;
+    }
+    if (rows > layout->rows - first_row) {
+        rows = layout->rows - first_row;
+    }
+    
+    // Every row but the image's last carries its full padding
+    size_t wanted = rows * layout->row_stride;
+    size_t minimum = (rows - 1) * layout->row_stride + row_raw_bytes(layout);
+    size_t got;
+    long offset = row_offset(strips, first_row);
+    
+    switch (strips->kind) {
+        case STEG_STRIPS_STREAM:
+            if (fseek(strips->file, offset, SEEK_SET) != 0) {
+                strips->error = STEG_FILE_ERROR;
+                return 0;
+            }
+            got = fread(strips->raw, 1, wanted, strips->file);
+            break;
+        case STEG_STRIPS_FD: {
+            ssize_t n = steg_pread_all(strips->fd, strips->raw, wanted, (off_t)offset);
+            got = n < 0 ? 0 : (size_t)n;
+            break;
+        }
+        default:
+            strips->raw = strips->image + offset;
+            got = minimum;
+            if (first_row + rows < layout->rows) {
+                got = wanted;
+            }
+            break;
+    }
+    
+    if (got < minimum) {
+        strips->error = STEG_FILE_ERROR;
+        return 0;
+    }
+    
+    strips->rows = rows;
+    strips->length = rows * layout->row_bytes;
+    strips->raw_length = got < wanted ? got : wanted;
+    strips->next_row = first_row + rows;
+    return strips->length;
+}
+
+// Gather the raw rows into one contiguous run of pixel bytes; 32-bit
+// rows are never padded, so the whole strip is packed in one pass
+static void strips_gather(steg_strips_t* strips) {
+    const steg_bmp_layout_t* layout = &strips->layout;
+    
+    if (layout->pixel_size == 4) {
+        convert_channels(&strips->engine, STRIPE_PACK, strips->raw, strips->pixels, strips->rows * layout->width,
+                         layout->alpha_index);
+    } else if (layout->row_stride != layout->row_bytes) {
+        for (size_t r = 0; r < strips->rows; r++) {
+            memcpy(strips->pixels + r * layout->row_bytes, strips->raw + r * layout->row_stride,
+                   layout->row_bytes);
+        }
+    } else {
+        strips->pixels = strips->raw;
+    }
+}
+
+// Load the next strip
+size_t steg_strips_next(steg_strips_t* strips, size_t needed) {
+    size_t length = strips_read(strips, needed);
+    
+    if (length > 0) {
+        strips_gather(strips);
+    }
+    return length;
+}
+
+// Scatter the pixel bytes back between the padding (or the alpha bytes)
+static void strips_scatter(steg_strips_t* strips) {
+    const steg_bmp_layout_t* layout = &strips->layout;
+    
+    if (layout->pixel_size == 4) {
+        convert_channels(&strips->engine, STRIPE_UNPACK, strips->raw, strips->pixels, strips->rows * layout->width,
+                         layout->alpha_index);
+    } else if (layout->row_stride != layout->row_bytes) {
+        for (size_t r = 0; r < strips->rows; r++) {
+            memcpy(strips->raw + r * layout->row_stride, strips->pixels + r * layout->row_bytes,
+                   layout->row_bytes);
+        }
+    }
+}
+
+// Write the raw rows of the current strip back (or to the output)
+static int strips_write(steg_strips_t* strips) {
+    long offset = row_offset(strips, strips->next_row - strips->rows);
+    
+    switch (strips->kind) {
+        case STEG_STRIPS_STREAM: {
+            FILE* out = strips->out ? strips->out : strips->file;
+            if (!strips->out && fseek(out, offset, SEEK_SET) != 0) {
+                return STEG_FILE_ERROR;
+            }
+            if (fwrite(strips->raw, 1, strips->raw_length, out) != strips->raw_length) {
+                return STEG_FILE_ERROR;
+            }
+            return STEG_SUCCESS;
+        }
+        case STEG_STRIPS_FD:
+            return steg_pwrite_all(strips->out_fd, strips->raw, strips->raw_length,
+                                   (off_t)(strips->out_base + offset));
+        default:
+            return STEG_SUCCESS;
+    }
+}
+
+// Write the current strip back (or to the output)
+int steg_strips_store(steg_strips_t* strips) {
+    strips_scatter(strips);
+    return strips_write(strips);
+}
+
+// Restart the cursor at the first row
+void steg_strips_rewind(steg_strips_t* strips) {
+    strips->next_row = 0;
+    strips->start = 0;
+    strips->rows = 0;
+    strips->length = 0;
+}
+
+// File offset just past the last row loaded
+long steg_strips_end_offset(const steg_strips_t* strips) {
+    if (strips->next_row == 0) {
+        return (long)strips->layout.data_offset;
+    }
+    return row_offset(strips, strips->next_row - strips->rows) + (long)strips->raw_length;
+}
+
+// Release the cursor's buffers
+void steg_strips_close(steg_strips_t* strips) {
+    free(strips->buffer);
+    strips->buffer = NULL;
+    strips->raw = NULL;
+    strips->pixels = NULL;
+}
+
+// Payload bytes carried by a run of pixel bytes
+static size_t payload_in_run(size_t run, size_t payload_left, int bits) {
+    if (run >= lsb_pixels_for(payload_left, bits)) {
+        return payload_left;
+    }
+    // Not the last run: only count whole groups of 8 pixel bytes
+    return run / 8 * (size_t)bits;
+}
+
+// Pixels of a header row, up to the pixels still to cover
+static size_t header_row_pixels(const steg_bmp_layout_t* layout, size_t done) {
+    size_t left = STEG_HEADER_PIXEL_COUNT - done;
+    return left < layout->width ? left : layout->width;
+}
+
+// Keep the stored header pixels for steg_strips_patch_header(); the last
+// one may also carry payload bits, so they are saved after embedding
+static void save_prefix(steg_strips_t* strips) {
+    const steg_bmp_layout_t* layout = &strips->layout;
+    
+    for (size_t done = 0, row = 0; done < STEG_HEADER_PIXEL_COUNT && row < strips->rows; row++) {
+        size_t count = header_row_pixels(layout, done);
+        memcpy(strips->prefix + done * layout->pixel_size, strips->raw + row * layout->row_stride,
+               count * layout->pixel_size);
+        done += count;
+    }
+}
+
+// Encode the payload header for the current depth
+static void encode_header(unsigned char* encoded, size_t length, int bits) {
+    steg_payload_header_t header;
+    
+    header.version = STEG_PAYLOAD_VERSION;
+    header.bits_per_channel = (uint8_t)bits;
+    header.flags = 0;
+    header.length = length;
+    steg_encode_payload_header(&header, encoded);
+}
+
+// Payload source and progress of one steg_embed_strips() call
+typedef struct {
+    const unsigned char* payload;  // Payload bytes, or NULL to read payload_file
+    FILE* payload_file;
+    size_t length;                 // Payload length, or STEG_LENGTH_UNKNOWN
+    int known;
+    int bits;
+    unsigned char encoded[STEG_PAYLOAD_HEADER_SIZE];
+    size_t end;                    // Pixel bytes that carry anything
+    unsigned char* scratch;        // Payload bytes read from payload_file
+    size_t total;                  // Payload bytes embedded so far
+    int done;                      // payload_file has run dry
+} embed_state_t;
+
+// Embed the header and payload bytes that fall in the loaded strip
+static int embed_strip(embed_state_t* state, steg_strips_t* strips) {
+    size_t start = strips->start;
+    size_t pos = start + strips->length;
+    unsigned char* pixels = strips->pixels;
+    int bits = state->bits;
+    
+    // Payload header, always at 1 bit per pixel byte; the first strip
+    // holds all of it
+    if (start == 0) {
+        lsb_embed(strips->engine.kernel, pixels, state->encoded, STEG_PAYLOAD_HEADER_SIZE, 1);
+    }
+    
+    // Payload at the configured depth
+    size_t run_start = start > STEG_PAYLOAD_HEADER_PIXELS ? start : STEG_PAYLOAD_HEADER_PIXELS;
+    size_t run_end = pos < state->end ? pos : state->end;
+    if (run_end <= run_start) {
+        return STEG_SUCCESS;
+    }
+    unsigned char* run = pixels + (run_start - start);
+    
+    if (state->payload) {
+        size_t chunk = payload_in_run(run_end - run_start, state->length - state->total, bits);
+        embed_run(&strips->engine, run, state->payload + state->total, chunk, bits);
+        state->total += chunk;
+    } else {
+        size_t wanted = state->known ? payload_in_run(run_end - run_start, state->length - state->total, bits)
+                                     : lsb_payload_for(run_end - run_start, bits);
+        size_t got = fread(state->scratch, 1, wanted, state->payload_file);
+        if (got < wanted && (ferror(state->payload_file) || state->known)) {
+            return STEG_FILE_ERROR;
+        }
+        embed_run(&strips->engine, run, state->scratch, got, bits);
+        state->total += got;
+        state->done = got < wanted;
+    }
+    
+    return STEG_SUCCESS;
+}
+
+// Embed strip by strip on the calling thread
+static int embed_serial(embed_state_t* state, steg_strips_t* strips) {
+    size_t pos = 0;
+    
+    while (!state->done && pos < state->end) {
+        size_t n = steg_strips_next(strips, state->end - pos);
+        if (n == 0) {
+            return strips->error ? strips->error : STEG_FILE_ERROR;
+        }
+        pos = strips->start + n;
+        
+        int result = embed_strip(state, strips);
+        if (result == STEG_SUCCESS) {
+            result = steg_strips_store(strips);
+        }
+        if (result != STEG_SUCCESS) {
+            return result;
+        }
+        if (strips->start == 0) {
+            save_prefix(strips);
+        }
+    }
+    
+    return STEG_SUCCESS;
+}
+
+// Embedding spread over the read/process/write pipeline: every slot has
+// its own copy of the cursor, pointing into the slot's buffer
+typedef struct {
+    embed_state_t* state;
+    steg_strips_t* cursor;   // Caller's cursor, follows the processed strips
+    steg_strips_t* slots;
+    size_t next_row;         // First row the read stage loads next
+    size_t raw_size;         // Raw rows at the start of each slot buffer
+} embed_pipeline_t;
+
+// Read stage: load the raw rows of the next strip into a slot
+static int pipeline_read(void* ctx, steg_block_t* block) {
+    embed_pipeline_t* pipeline = ctx;
+    steg_strips_t* strips = &pipeline->slots[block->slot];
+    size_t pos = pipeline->next_row * strips->layout.row_bytes;
+    
+    if (pos >= pipeline->state->end) {
+        return STEG_SUCCESS;
+    }
+    
+    strips->raw = block->data;
+    strips->pixels = strips->layout.row_stride != strips->layout.row_bytes ? block->data + pipeline->raw_size
+                                                                           : NULL;
+    strips->next_row = pipeline->next_row;
+    size_t n = strips_read(strips, pipeline->state->end - pos);
+    if (n == 0) {
+        return strips->error ? strips->error : STEG_FILE_ERROR;
+    }
+    
+    pipeline->next_row = strips->next_row;
+    block->length = n;
+    return STEG_SUCCESS;
+}
+
+// Process stage: gather, embed and scatter a strip on the calling thread
+static int pipeline_process(void* ctx, steg_block_t* block) {
+    embed_pipeline_t* pipeline = ctx;
+    embed_state_t* state = pipeline->state;
+    steg_strips_t* strips = &pipeline->slots[block->slot];
+    steg_strips_t* cursor = pipeline->cursor;
+    
+    strips_gather(strips);
+    int result = embed_strip(state, strips);
+    if (result != STEG_SUCCESS) {
+        return result;
+    }
+    strips_scatter(strips);
+    
+    if (strips->start == 0) {
+        save_prefix(strips);
+        memcpy(cursor->prefix, strips->prefix, sizeof(cursor->prefix));
+    }
+    
+    // The caller's cursor ends where the last processed strip ends
+    cursor->next_row = strips->next_row;
+    cursor->start = strips->start;
+    cursor->rows = strips->rows;
+    cursor->length = strips->length;
+    cursor->raw_length = strips->raw_length;
+    
+    return state->done || strips->start + strips->length >= state->end ? STEG_PIPELINE_LAST : STEG_SUCCESS;
+}
+
+// Write stage: store the raw rows of a slot
+static int pipeline_write(void* ctx, steg_block_t* block) {
+    embed_pipeline_t* pipeline = ctx;
+    return strips_write(&pipeline->slots[block->slot]);
+}
+
+// Whether the pipeline can overlap I/O for this embed: it needs separate
+// source and destination streams and more than one strip of work
+static int pipeline_usable(const steg_strips_t* strips, size_t end) {
+    if (strips->engine.pipeline_depth < 2) {
+        return 0;
+    }
+    if (strips->kind == STEG_STRIPS_MEMORY ||
+        (strips->kind == STEG_STRIPS_STREAM && !strips->out) ||
+        (strips->kind == STEG_STRIPS_FD && strips->out_fd < 0)) {
+        return 0;
+    }
+    return end > strips->strip_rows * strips->layout.row_bytes;
+}
+
+// Embed with a reader and a writer thread around the calling thread
+static int embed_pipelined(embed_state_t* state, steg_strips_t* strips) {
+    const steg_bmp_layout_t* layout = &strips->layout;
+    size_t depth = (size_t)strips->engine.pipeline_depth;
+    embed_pipeline_t pipeline;
+    steg_pipeline_t spec;
+    
+    pipeline.state = state;
+    pipeline.cursor = strips;
+    pipeline.next_row = 0;
+    pipeline.raw_size = strips->strip_rows * layout->row_stride;
+    pipeline.slots = malloc(depth * sizeof(steg_strips_t));
+    if (!pipeline.slots) {
+        return STEG_MEMORY_ERROR;
+    }
+    for (size_t i = 0; i < depth; i++) {
+        pipeline.slots[i] = *strips;
+        pipeline.slots[i].buffer = NULL;
+    }
+    
+    spec.depth = depth;
+    spec.block_size = pipeline.raw_size +
+                      (layout->row_stride != layout->row_bytes ? strips->strip_rows * layout->row_bytes : 0);
+    spec.read = pipeline_read;
+    spec.process = pipeline_process;
+    spec.write = pipeline_write;
+    spec.ctx = &pipeline;
+    
+    int result = steg_pipeline_run(&spec);
+    free(pipeline.slots);
+    
+    // The reader may have run ahead: leave the source stream just past
+    // the last strip written, as the serial loop does
+    if (result == STEG_SUCCESS && strips->kind == STEG_STRIPS_STREAM &&
+        fseek(strips->file, steg_strips_end_offset(strips), SEEK_SET) != 0) {
+        result = STEG_FILE_ERROR;
+    }
+    
+    return result;
+}
+
+// Embed the payload header and payload through a strip cursor
+int steg_embed_strips(steg_strips_t* strips, const unsigned char* payload, FILE* payload_file,
+                      size_t length, size_t* embedded) {
+    embed_state_t state;
+    size_t pixel_bytes = steg_bmp_pixel_bytes(&strips->layout);
+    size_t capacity = steg_capacity_at(pixel_bytes, strips->engine.bits);
+    
+    if (embedded) {
+        *embedded = 0;
+    }
+    
+    memset(&state, 0, sizeof(state));
+    state.payload = payload;
+    state.payload_file = payload_file;
+    state.length = length;
+    state.known = length != STEG_LENGTH_UNKNOWN;
+    state.bits = strips->engine.bits;
+    
+    if (pixel_bytes < STEG_PAYLOAD_HEADER_PIXELS || (state.known && length > capacity)) {
+        return STEG_INSUFFICIENT_CAPACITY;
+    }
+    
+    encode_header(state.encoded, state.known ? length : 0, state.bits);
+    
+    // Pixel bytes that carry anything; an unknown length may use them all
+    state.end = state.known ? STEG_PAYLOAD_HEADER_PIXELS + lsb_pixels_for(length, state.bits) : pixel_bytes;
+    if (!payload) {
+        state.scratch = malloc(strips->strip_rows * strips->layout.row_bytes / 8 * (size_t)state.bits +
+                               (size_t)state.bits);
+        if (!state.scratch) {
+            return STEG_MEMORY_ERROR;
+        }
+    }
+    
+    int result = pipeline_usable(strips, state.end) ? embed_pipelined(&state, strips)
+                                                    : embed_serial(&state, strips);
+    
+    // An unknown-length payload that is still going has outgrown the image
+    if (result == STEG_SUCCESS && !state.known && !state.done) {
+        int c = fgetc(payload_file);
+        if (c != EOF) {
+            result = STEG_INSUFFICIENT_CAPACITY;
+        }
+    }
+    
+    free(state.scratch);
+    
+    if (embedded) {
+        *embedded = state.total;
+    }
+    
+    return result;
+}
+
+// Rewrite the payload header with its final length
+int steg_strips_patch_header(steg_strips_t* strips, size_t length) {
+    const steg_bmp_layout_t* layout = &strips->layout;
+    const lsb_kernel_t* kernel = strips->engine.kernel;
+    unsigned char encoded[STEG_PAYLOAD_HEADER_SIZE];
+    unsigned char pixels[sizeof(strips->prefix)];
+    unsigned char channels[STEG_HEADER_PIXEL_COUNT * 3];
+    
+    encode_header(encoded, length, strips->engine.bits);
+    memcpy(pixels, strips->prefix, sizeof(pixels));
+    if (layout->pixel_size == 4) {
+        kernel->pack(pixels, channels, STEG_HEADER_PIXEL_COUNT, layout->alpha_index);
+        lsb_embed(kernel, channels, encoded, STEG_PAYLOAD_HEADER_SIZE, 1);
+        kernel->unpack(channels, pixels, STEG_HEADER_PIXEL_COUNT, layout->alpha_index);
+    } else {
+        lsb_embed(kernel, pixels, encoded, STEG_PAYLOAD_HEADER_SIZE, 1);
+    }
+    
+    if (strips->kind == STEG_STRIPS_STREAM && strips->out && fflush(strips->out) != 0) {
+        return STEG_FILE_ERROR;
+    }
+    
+    // The header pixels may span several rows
+    for (size_t done = 0, row = 0; done < STEG_HEADER_PIXEL_COUNT; row++) {
+        size_t count = header_row_pixels(layout, done);
+        size_t span = count * layout->pixel_size;
+        long offset = row_offset(strips, row);
+        unsigned char* data = pixels + done * layout->pixel_size;
+        
+        switch (strips->kind) {
+            case STEG_STRIPS_STREAM: {
+                FILE* out = strips->out ? strips->out : strips->file;
+                long base = strips->out ? strips->out_base : 0;
+                if (fseek(out, base + offset, SEEK_SET) != 0 ||
+                    fwrite(data, 1, span, out) != span) {
+                    return STEG_FILE_ERROR;
+                }
+                break;
+            }
+            case STEG_STRIPS_FD:
+                if (steg_pwrite_all(strips->out_fd, data, span,
+                                    (off_t)(strips->out_base + offset)) != STEG_SUCCESS) {
+                    return STEG_FILE_ERROR;
+                }
+                break;
+            default:
+                memcpy(strips->image + offset, data, span);
+                break;
+        }
+        done += count;
+    }
+    
+    if (strips->kind == STEG_STRIPS_STREAM && strips->out && fseek(strips->out, 0, SEEK_END) != 0) {
+        return STEG_FILE_ERROR;
+    }
+    
+    return STEG_SUCCESS;
+}
+
+// Read the payload header through a strip cursor
+int steg_strips_read_header(steg_strips_t* strips, unsigned char* encoded) {
+    size_t n = steg_strips_next(strips, STEG_PAYLOAD_HEADER_PIXELS);
+    int result = STEG_SUCCESS;
+    
+    if (n < STEG_PAYLOAD_HEADER_PIXELS) {
+        result = strips->error ? strips->error : STEG_FILE_ERROR;
+    } else {
+        lsb_extract(strips->engine.kernel, strips->pixels, encoded, STEG_PAYLOAD_HEADER_SIZE, 1);
+    }
+    
+    steg_strips_rewind(strips);
+    return result;
+}
+
+// Extract the payload through a strip cursor
+int steg_extract_strips(steg_strips_t* strips, unsigned char* buffer, FILE* sink,
+                        size_t max_len, size_t* length) {
+    unsigned char encoded[STEG_PAYLOAD_HEADER_SIZE];
+    steg_payload_header_t header;
+    size_t region;
+    size_t limit;
+    int bits;
+    int scan;
+    
+    *length = 0;
+    
+    int header_result = steg_strips_read_header(strips, encoded);
+    if (header_result == STEG_SUCCESS) {
+        header_result = steg_decode_payload_header(encoded, &header);
+    } else if (header_result == STEG_FILE_ERROR && steg_bmp_pixel_bytes(&strips->layout) > 0) {
+        // Too small for a header, but a legacy payload may still fit
+        header_result = STEG_NO_PAYLOAD_HEADER;
+    }
+    
+    if (header_result == STEG_SUCCESS) {
+        // The header names the exact length, so no terminator scan is needed
+        region = STEG_PAYLOAD_HEADER_PIXELS;
+        limit = header.length < max_len ? (size_t)header.length : max_len;
+        bits = header.bits_per_channel;
+        scan = 0;
+    } else if (header_result == STEG_NO_PAYLOAD_HEADER) {
+        // Legacy layout: scan for the null terminator at the current depth
+        region = 0;
+        limit = max_len;
+        bits = strips->engine.bits;
+        scan = 1;
+    } else {
+        return header_result;
+    }
+    
+    if (limit == 0) {
+        return STEG_SUCCESS;
+    }
+    
+    unsigned char* scratch = NULL;
+    if (!buffer) {
+        scratch = malloc(strips->strip_rows * strips->layout.row_bytes / 8 * (size_t)bits + (size_t)bits);
+        if (!scratch) {
+            return STEG_MEMORY_ERROR;
+        }
+    }
+    
+    size_t pixels_needed = lsb_pixels_for(limit, bits);
+    size_t end = region + pixels_needed < pixels_needed ? SIZE_MAX : region + pixels_needed;
+    size_t done = 0;
+    size_t pos = 0;
+    int result = STEG_SUCCESS;
+    
+    while (done < limit) {
+        size_t n = steg_strips_next(strips, end - pos);
+        if (n == 0) {
+            result = strips->error ? strips->error : STEG_FILE_ERROR;
+            break;
+        }
+        size_t start = strips->start;
+        pos = start + n;
+        
+        size_t run_start = start > region ? start : region;
+        size_t run_end = pos < end ? pos : end;
+        if (run_end <= run_start) {
+            continue;
+        }
+        
+        size_t chunk = payload_in_run(run_end - run_start, limit - done, bits);
+        if (chunk == 0) {
+            result = STEG_FILE_ERROR;
+            break;
+        }
+        
+        const unsigned char* run = strips->pixels + (run_start - start);
+        unsigned char* out = buffer ? buffer + done : scratch;
+        size_t kept = chunk;
+        
+        if (scan) {
+            kept = lsb_extract_string(strips->engine.kernel, run, out, chunk, bits);
+            if (kept > chunk) {
+                kept = chunk;
+            }
+        } else {
+            extract_run(&strips->engine, run, out, chunk, bits);
+        }
+        
+        if (!buffer && fwrite(scratch, 1, kept, sink) != kept) {
+            result = STEG_FILE_ERROR;
+            break;
+        }
+        done += kept;
+        
+        // Stop at the null terminator
+        if (kept < chunk) {
+            break;
+        }
+    }
+    
+    free(scratch);
+    *length = done;
+    return result;
+}
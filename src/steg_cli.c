@@ -9,12 +9,27 @@
  * Uses the format handler system for extensible format support.
  */
 
+#define _GNU_SOURCE // memfd_create, to spool an image read from stdin
+
 #include "../include/steg.h"
 #include "../include/formats.h"
+#include "../include/steg_io.h"
+#include "../include/steg_bmp.h"
+#include "../include/steg_kernels.h"
+#include "../include/thread_pool.h"
+#include "../include/steg_batch_io.h"
+#include "../include/steg_ctx.h"
+#include "../include/stegd.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 static void print_help(void) {
     printf("LSB Steganography Tool v1.1 - CLI Version\n");
@@ -23,17 +38,46 @@ static void print_help(void) {
     
     printf("Modes:\n");
     printf("  -e, --embed <message>    Embed a message into an image\n");
-    printf("  -x, --extract            Extract a message from an image\n\n");
+    printf("  -x, --extract            Extract a message from an image\n");
+    printf("      --batch <manifest>   Run every job of a manifest in one process on\n");
+    printf("                           -t workers; each line is input, output, payload\n");
+    printf("                           and embed|extract, separated by tabs\n");
+    printf("      --batch-io=<backend> Batch I/O: stdio (per job), pread or uring (whole\n");
+    printf("                           files, many in flight; default: stdio)\n");
+    printf("      --bench-batch-io     Time the batch with every batch I/O backend\n");
+    printf("      --daemon <socket>    Send the -e, -x or -c request to a running stegd\n");
+    printf("                           instead of processing the image here\n\n");
     
     printf("Options:\n");
-    printf("  -i, --input <file>       Input image file (default: image.bmp)\n");
+    printf("  -i, --input <file>       Input image file, \"-\" for stdin (default: image.bmp);\n");
+    printf("                           the format is recognised by content, so any name\n");
+    printf("                           or none will do\n");
     printf("  -o, --output <file>      Output image file (default: output.bmp)\n");
     printf("  -m, --message <text>     Message to embed (for embed mode)\n");
-    printf("  -f, --file <file>        Read message from file (for embed mode)\n");
+    printf("  -f, --file <file>        Read message from file, \"-\" for stdin (for embed mode)\n");
+    printf("  -O, --payload-out <file> Write the raw extracted payload to a file, \"-\" for\n");
+    printf("                           stdout (BMP only, for extract mode)\n");
     printf("  -c, --capacity           Show image capacity without processing\n");
+    printf("  -b, --block-size <size>  I/O block size, e.g. 65536, 512K, 4M (default: 1M)\n");
+    printf("      --bits <n>           Payload bits per color channel, 1-4 (BMP only,\n");
+    printf("                           default: 1; extraction reads it from the image)\n");
+    printf("  -t, --threads <n>        Threads for pixel work, 0 for one per CPU (BMP only,\n");
+    printf("                           default: 1; output is identical for any count)\n");
+    printf("      --pipeline <n>       Strip buffers shared by the reader, embedder and\n");
+    printf("                           writer threads, 0 to embed serially (BMP only,\n");
+    printf("                           default: 4)\n");
+    printf("      --bench-threads[=<n>] Benchmark extraction at 1, 2, 4 ... n threads\n");
+    printf("                           (default: one per CPU; BMP only, extract mode)\n");
+    printf("      --io=<backend>       BMP I/O backend: stdio, mmap or pread (default: stdio)\n");
+    printf("      --populate           Prefault the mapping (mmap backend)\n");
+    printf("      --inplace-clone      Clone the input (reflink when possible) and patch\n");
+    printf("                           only the payload bytes (BMP only)\n");
     printf("  -v, --verbose            Verbose output\n");
     printf("  -h, --help               Show this help message\n\n");
     
+    printf("Environment:\n");
+    printf("  STEG_KERNEL=<name>       Force the LSB kernel: scalar, sse2, avx2, avx512\n\n");
+    
     printf("Supported Formats:\n");
     printf("  %s\n\n", get_supported_formats());
     
@@ -43,8 +87,27 @@ static void print_help(void) {
     printf("  %s -x -i secret.jpg\n", "steg_cli");
     printf("  %s -c -i photo.png\n", "steg_cli");
     printf("  %s -e -f message.txt -i image.bmp\n", "steg_cli");
+    printf("  tar c docs | %s -e -f - -i scan.bmp -o secret.bmp\n", "steg_cli");
+    printf("  %s -x -i secret.bmp -O docs.tar\n", "steg_cli");
+    printf("  %s --batch jobs.tsv -t 8\n", "steg_cli");
+    printf("  %s --batch jobs.tsv --batch-io=uring\n", "steg_cli");
+    printf("  %s --daemon /tmp/stegd.sock -e -m \"Secret\" -i photo.bmp -o secret.bmp\n", "steg_cli");
 }
 
+// Long-only options
+enum {
+    OPT_INPLACE_CLONE = 256,
+    OPT_IO,
+    OPT_POPULATE,
+    OPT_BITS,
+    OPT_BENCH_THREADS,
+    OPT_BATCH,
+    OPT_PIPELINE,
+    OPT_BATCH_IO,
+    OPT_BENCH_BATCH_IO,
+    OPT_DAEMON
+};
+
 static void print_cli_error(const char* message) {
     fprintf(stderr, "Error: %s\n", message);
 }
@@ -61,34 +124,1088 @@ static const char* get_error_message(int error_code) {
             return "Insufficient image capacity";
         case STEG_MEMORY_ERROR:
             return "Memory allocation failed";
+        case STEG_INVALID_ARGUMENT:
+            return "Invalid argument";
+        case STEG_NO_PAYLOAD_HEADER:
+            return "No payload header found";
         default:
             return "Unknown error";
     }
 }
 
-static int read_message_from_file(const char* filename, char* message, size_t max_len) {
-    FILE* file = fopen(filename, "r");
+static long get_file_size(FILE* file) {
+    long current_pos = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, current_pos, SEEK_SET);
+    return file_size;
+}
+
+// Open a payload file for reading; "-" is standard input
+static FILE* open_payload_file(const char* filename) {
+    return strcmp(filename, "-") == 0 ? stdin : fopen(filename, "rb");
+}
+
+// Payload length of a regular file, or STEG_LENGTH_UNKNOWN for pipes and ttys
+static size_t payload_file_length(FILE* file) {
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode)) {
+        return STEG_LENGTH_UNKNOWN;
+    }
+    
+    long pos = ftell(file);
+    return pos < 0 || pos > st.st_size ? STEG_LENGTH_UNKNOWN : (size_t)(st.st_size - pos);
+}
+
+// Read a whole message file into a NUL-terminated heap buffer; "-" is
+// standard input. length receives the byte count, which may include NULs
+static char* read_message_from_file(const char* filename, size_t* length_out) {
+    FILE* file = open_payload_file(filename);
     if (!file) {
+        return NULL;
+    }
+    
+    size_t capacity = 4096;
+    size_t length = 0;
+    char* message = malloc(capacity);
+    
+    while (message) {
+        length += fread(message + length, 1, capacity - length - 1, file);
+        if (length < capacity - 1) {
+            break;
+        }
+        
+        char* grown = realloc(message, capacity * 2);
+        if (!grown) {
+            free(message);
+            message = NULL;
+            break;
+        }
+        message = grown;
+        capacity *= 2;
+    }
+    
+    if (message && ferror(file)) {
+        free(message);
+        message = NULL;
+    }
+    if (message) {
+        message[length] = '\0';
+        *length_out = length;
+    }
+    
+    if (file != stdin) {
+        fclose(file);
+    }
+    return message;
+}
+
+// Buffer size for extracting the whole payload, sized from the image itself
+static size_t extract_buffer_size(format_handler_t* handler, FILE* input) {
+    steg_payload_header_t payload_header;
+    steg_bmp_layout_t layout;
+    
+    if (handler != &bmp_handler) {
+        long capacity = handler->get_capacity(input);
+        return capacity > 0 ? (size_t)capacity + 1 : 1;
+    }
+    
+    // Only the pixel bytes of each row count, never padding or trailing data
+    if (steg_bmp_read_layout(input, &layout) != STEG_SUCCESS) {
+        return 1;
+    }
+    size_t pixel_bytes = steg_bmp_pixel_bytes(&layout);
+    
+    if (read_payload_header(input, &payload_header) == STEG_SUCCESS) {
+        // Never trust the header beyond what the image can actually hold
+        size_t fits = steg_capacity_at(pixel_bytes, payload_header.bits_per_channel);
+        return (payload_header.length < fits ? (size_t)payload_header.length : fits) + 1;
+    }
+    
+    // Legacy layout: the message may run up to the end of the image
+    return lsb_payload_for(pixel_bytes, steg_get_bits_per_channel()) + 1;
+}
+
+// Parse a size with an optional K/M/G suffix (powers of 1024)
+static int parse_size(const char* text, size_t* size) {
+    char* end;
+    unsigned long long value = strtoull(text, &end, 10);
+    
+    if (end == text) {
         return 0;
     }
     
-    size_t bytes_read = fread(message, 1, max_len - 1, file);
-    message[bytes_read] = '\0';
+    switch (*end) {
+        case 'k': case 'K': value <<= 10; end++; break;
+        case 'm': case 'M': value <<= 20; end++; break;
+        case 'g': case 'G': value <<= 30; end++; break;
+        default: break;
+    }
     
-    fclose(file);
+    if (*end != '\0') {
+        return 0;
+    }
+    
+    *size = (size_t)value;
     return 1;
 }
 
+static double elapsed_seconds(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void print_throughput(long bytes, double seconds) {
+    double mb = bytes / (1024.0 * 1024.0);
+    if (seconds > 0) {
+        printf("Throughput: %.1f MB/s (%.2f MB in %.3f s)\n", mb / seconds, mb, seconds);
+    } else {
+        printf("Throughput: %.2f MB in < 1 us\n", mb);
+    }
+}
+
+// Extraction runs timed per thread count by --bench-threads (best is kept)
+#define BENCH_RUNS 3
+
+// Time in-memory extraction at 1, 2, 4, ... max_threads threads and
+// report throughput and speedup over a single thread
+static int run_thread_benchmark(FILE* input, int max_threads) {
+    steg_payload_header_t payload_header;
+    steg_bmp_layout_t layout;
+    
+    int result = read_payload_header(input, &payload_header);
+    if (result == STEG_SUCCESS) {
+        result = steg_bmp_read_layout(input, &layout);
+    }
+    if (result != STEG_SUCCESS) {
+        return result;
+    }
+    
+    // The header comes from the image; never size buffers beyond what it can hold
+    if (payload_header.length > steg_capacity_at(steg_bmp_pixel_bytes(&layout), payload_header.bits_per_channel)) {
+        print_cli_error("Payload header claims more data than the image holds");
+        return STEG_INVALID_BMP;
+    }
+    
+    // Load the image once so only the pixel work is timed
+    long image_size = get_file_size(input);
+    size_t length = (size_t)payload_header.length;
+    size_t buffer_size = length + 1;
+    unsigned char* image = image_size > 0 ? malloc((size_t)image_size) : NULL;
+    unsigned char* reference = malloc(buffer_size);
+    unsigned char* buffer = malloc(buffer_size);
+    
+    if (!image || !reference || !buffer) {
+        result = STEG_MEMORY_ERROR;
+    } else if (fseek(input, 0, SEEK_SET) != 0 ||
+               fread(image, 1, (size_t)image_size, input) != (size_t)image_size) {
+        result = STEG_FILE_ERROR;
+    }
+    
+    if (result == STEG_SUCCESS) {
+        printf("Thread scaling: %zu-byte payload at %u bits per channel, best of %d runs\n",
+               length, payload_header.bits_per_channel, BENCH_RUNS);
+        printf("%8s %12s %9s\n", "Threads", "MB/s", "Speedup");
+    }
+    
+    double single = 0;
+    for (int threads = 1; result == STEG_SUCCESS; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        steg_set_threads(threads);
+        
+        double best = 0;
+        for (int run = 0; run < BENCH_RUNS && result == STEG_SUCCESS; run++) {
+            size_t extracted = 0;
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            result = extract_payload_buffer(buffer, buffer_size, &extracted, image, (size_t)image_size);
+            double seconds = elapsed_seconds(&start);
+            
+            if (result == STEG_SUCCESS && extracted != length) {
+                result = STEG_FILE_ERROR;
+            }
+            if (run == 0 || seconds < best) {
+                best = seconds;
+            }
+        }
+        if (result != STEG_SUCCESS) {
+            break;
+        }
+        
+        // Every thread count must decode exactly the same bytes
+        if (threads == 1) {
+            memcpy(reference, buffer, length);
+            single = best;
+        } else if (memcmp(reference, buffer, length) != 0) {
+            print_cli_error("Parallel extraction does not match the single-threaded result");
+            result = STEG_FILE_ERROR;
+            break;
+        }
+        
+        double mb = length / (1024.0 * 1024.0);
+        printf("%8d %12.1f %8.2fx\n", threads, best > 0 ? mb / best : 0.0, best > 0 ? single / best : 1.0);
+        
+        if (threads >= max_threads) {
+            break;
+        }
+    }
+    
+    free(buffer);
+    free(reference);
+    free(image);
+    return result;
+}
+
+// One job of a --batch manifest
+typedef struct {
+    char* input;            // Image to read
+    char* output;           // Image to write (embed)
+    char* payload;          // Payload to embed, or file to extract into
+    int extract;            // 0 = embed, 1 = extract
+    int line;               // Manifest line number
+    format_handler_t* handler; // Resolved before the run, NULL if unsupported
+    int result;             // STEG_* code once the job has run
+    size_t payload_bytes;   // Payload bytes embedded or extracted
+    long image_bytes;       // Size of the input image
+    double seconds;         // Time spent on the job
+    steg_file_t* image;     // Loaded image (whole-file backends)
+    steg_file_t* message;   // Loaded payload of an embed job (whole-file backends)
+    steg_file_t* store;     // File the job stores (whole-file backends)
+} batch_job_t;
+
+// Jobs of a batch run and the state shared by its workers
+typedef struct {
+    batch_job_t* jobs;
+    size_t count;
+    size_t finished;        // Jobs reported so far
+    pthread_mutex_t lock;   // Guards finished and the status lines
+    steg_thread_pool_t* pool;
+    int quiet;              // No status line per job (benchmark runs)
+    steg_ctx_t** contexts;  // One per pool thread for in-memory jobs (entries may be NULL)
+    int context_count;
+} batch_t;
+
+// Jobs loaded, processed and stored together by the whole-file backends
+#define BATCH_WINDOW 256
+
+// Largest image or payload the whole-file backends load; bigger ones
+// are streamed through stdio as usual
+#define BATCH_MAX_LOADED (16 * 1024 * 1024)
+
+// Whole-file backends compared by --bench-batch-io
+static const int batch_bench_backends[] = { STEG_BATCH_IO_STDIO, STEG_BATCH_IO_PREAD, STEG_BATCH_IO_URING };
+
+// Release the strings and array of a parsed manifest
+static void free_batch_jobs(batch_job_t* jobs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(jobs[i].input);
+        free(jobs[i].output);
+        free(jobs[i].payload);
+    }
+    free(jobs);
+}
+
+// Parse a manifest: one "input<TAB>output<TAB>payload<TAB>mode" job per
+// line, mode being embed or extract; blank lines and # comments are skipped
+static int parse_batch_manifest(const char* filename, batch_job_t** jobs_out, size_t* count_out) {
+    FILE* manifest = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
+    if (!manifest) {
+        print_cli_error("Could not open batch manifest");
+        return STEG_FILE_ERROR;
+    }
+    
+    batch_job_t* jobs = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    char* line = NULL;
+    size_t line_size = 0;
+    int line_number = 0;
+    int result = STEG_SUCCESS;
+    
+    while (result == STEG_SUCCESS && getline(&line, &line_size, manifest) != -1) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') {
+            continue;
+        }
+        
+        char* fields[4];
+        int field_count = 0;
+        char* cursor = line;
+        while (field_count < 4) {
+            fields[field_count++] = cursor;
+            cursor = strchr(cursor, '\t');
+            if (!cursor) {
+                break;
+            }
+            *cursor++ = '\0';
+        }
+        
+        int extract = -1;
+        if (field_count == 4 && !cursor) {
+            if (strcmp(fields[3], "embed") == 0) {
+                extract = 0;
+            } else if (strcmp(fields[3], "extract") == 0) {
+                extract = 1;
+            }
+        }
+        if (extract < 0 || fields[0][0] == '\0' || fields[2][0] == '\0' ||
+            (!extract && fields[1][0] == '\0')) {
+            fprintf(stderr, "Error: %s:%d: expected input, output, payload and embed|extract "
+                    "separated by tabs\n", filename, line_number);
+            result = STEG_INVALID_ARGUMENT;
+            break;
+        }
+        
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            batch_job_t* grown = realloc(jobs, capacity * sizeof(batch_job_t));
+            if (!grown) {
+                result = STEG_MEMORY_ERROR;
+                break;
+            }
+            jobs = grown;
+        }
+        
+        batch_job_t* job = &jobs[count++];
+        memset(job, 0, sizeof(*job));
+        job->input = strdup(fields[0]);
+        job->output = strdup(fields[1]);
+        job->payload = strdup(fields[2]);
+        job->extract = extract;
+        job->line = line_number;
+        if (!job->input || !job->output || !job->payload) {
+            result = STEG_MEMORY_ERROR;
+        }
+    }
+    
+    if (result == STEG_SUCCESS && ferror(manifest)) {
+        result = STEG_FILE_ERROR;
+    }
+    free(line);
+    if (manifest != stdin) {
+        fclose(manifest);
+    }
+    
+    if (result != STEG_SUCCESS) {
+        free_batch_jobs(jobs, count);
+        return result;
+    }
+    *jobs_out = jobs;
+    *count_out = count;
+    return STEG_SUCCESS;
+}
+
+// Embed one batch job; BMP payloads are streamed, other formats read whole
+static int run_batch_embed(batch_job_t* job, format_handler_t* handler, FILE* input) {
+    char* message = NULL;
+    FILE* payload = NULL;
+    size_t length = 0;
+    
+    if (handler == &bmp_handler) {
+        payload = fopen(job->payload, "rb");
+        if (!payload) {
+            return STEG_FILE_ERROR;
+        }
+        length = payload_file_length(payload);
+    } else {
+        message = read_message_from_file(job->payload, &length);
+        if (!message) {
+            return STEG_FILE_ERROR;
+        }
+        
+        // The handler takes text and would stop at the first NUL
+        if (memchr(message, '\0', length)) {
+            free(message);
+            return STEG_INVALID_ARGUMENT;
+        }
+        long capacity = handler->get_capacity(input);
+        if (capacity < 0 || length > (size_t)capacity) {
+            free(message);
+            return STEG_INSUFFICIENT_CAPACITY;
+        }
+    }
+    
+    int result = STEG_FILE_ERROR;
+    FILE* output = fopen(job->output, "wb");
+    if (output) {
+        if (payload) {
+            result = embed_payload_stream(payload, length, input, output, &length);
+        } else {
+            result = handler->embed(input, output, message);
+        }
+        if (fclose(output) != 0 && result == STEG_SUCCESS) {
+            result = STEG_FILE_ERROR;
+        }
+    }
+    
+    if (payload) {
+        fclose(payload);
+    }
+    free(message);
+    job->payload_bytes = result == STEG_SUCCESS ? length : 0;
+    return result;
+}
+
+// Extract one batch job into its payload file
+static int run_batch_extract(batch_job_t* job, format_handler_t* handler, FILE* input) {
+    FILE* sink = fopen(job->payload, "wb");
+    if (!sink) {
+        return STEG_FILE_ERROR;
+    }
+    
+    int result;
+    size_t length = 0;
+    if (handler == &bmp_handler) {
+        result = extract_payload_stream(input, sink, &length);
+    } else {
+        size_t buffer_size = extract_buffer_size(handler, input);
+        char* message = malloc(buffer_size);
+        result = message ? handler->extract(input, message, buffer_size) : STEG_MEMORY_ERROR;
+        if (result == STEG_SUCCESS) {
+            length = strlen(message);
+            if (fwrite(message, 1, length, sink) != length) {
+                result = STEG_FILE_ERROR;
+            }
+        }
+        free(message);
+    }
+    
+    if (fclose(sink) != 0 && result == STEG_SUCCESS) {
+        result = STEG_FILE_ERROR;
+    }
+    job->payload_bytes = result == STEG_SUCCESS ? length : 0;
+    return result;
+}
+
+// Print the status line of a finished job
+static void report_batch_job(batch_t* batch, const batch_job_t* job) {
+    pthread_mutex_lock(&batch->lock);
+    size_t number = ++batch->finished;
+    if (batch->quiet) {
+        // Counted only
+    } else if (job->result == STEG_SUCCESS) {
+        printf("[%zu/%zu] ok     %-7s %s -> %s (%zu bytes, %.3f s)\n", number, batch->count,
+               job->extract ? "extract" : "embed", job->input,
+               job->extract ? job->payload : job->output, job->payload_bytes, job->seconds);
+    } else {
+        printf("[%zu/%zu] FAILED %-7s %s (line %d): %s\n", number, batch->count,
+               job->extract ? "extract" : "embed", job->input, job->line,
+               get_error_message(job->result));
+    }
+    if (!batch->quiet) {
+        fflush(stdout);
+    }
+    pthread_mutex_unlock(&batch->lock);
+}
+
+// Run one job through stdio streams and print its status line
+static void run_batch_job_stdio(batch_t* batch, batch_job_t* job) {
+    struct timespec start;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    format_handler_t* handler = job->handler;
+    FILE* input = handler ? fopen(job->input, "rb") : NULL;
+    
+    if (!handler) {
+        job->result = STEG_INVALID_BMP;
+    } else if (!input) {
+        job->result = STEG_FILE_ERROR;
+    } else if (!handler->validate(input)) {
+        job->result = STEG_INVALID_BMP;
+    } else {
+        job->image_bytes = get_file_size(input);
+        job->result = job->extract ? run_batch_extract(job, handler, input)
+                                   : run_batch_embed(job, handler, input);
+    }
+    if (input) {
+        fclose(input);
+    }
+    job->seconds = elapsed_seconds(&start);
+    
+    report_batch_job(batch, job);
+}
+
+// Worker body: run job index and print its status line
+static void run_batch_job(void* arg, size_t index) {
+    batch_t* batch = arg;
+    run_batch_job_stdio(batch, &batch->jobs[index]);
+}
+
+// One window of jobs for the whole-file backends
+typedef struct {
+    batch_t* batch;
+    size_t first;           // First job of the window
+    size_t count;           // Jobs in the window
+} batch_window_t;
+
+// Whether a job goes through the whole-file path: BMP images only, and
+// only while its image and payload are small enough to have been loaded
+static int batch_job_in_memory(const batch_job_t* job) {
+    if (!job->image) {
+        return 0;
+    }
+    if (job->image->result != STEG_SUCCESS) {
+        // Reported as a failed load
+        return 1;
+    }
+    if (!job->image->data) {
+        return 0;
+    }
+    return job->extract || job->message->result != STEG_SUCCESS || job->message->data ||
+           job->message->size == 0;
+}
+
+// Worker body of a window: embed or extract a loaded job in memory, or
+// stream it through stdio when it was not loaded
+static void run_batch_window_job(void* arg, size_t index) {
+    batch_window_t* window = arg;
+    batch_job_t* job = &window->batch->jobs[window->first + index];
+    struct timespec start;
+    
+    if (!batch_job_in_memory(job)) {
+        run_batch_job_stdio(window->batch, job);
+        return;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    steg_file_t* image = job->image;
+    job->image_bytes = (long)image->size;
+    
+    // This worker's context: scratch comes from its arena, not the heap.
+    // Without a pool the jobs run on the calling thread, as worker 0
+    int worker = steg_thread_pool_current_worker();
+    if (worker < 0) {
+        worker = 0;
+    }
+    steg_ctx_t* ctx = worker < window->batch->context_count ?
+                      window->batch->contexts[worker] : NULL;
+    
+    if (image->result != STEG_SUCCESS || (!job->extract && job->message->result != STEG_SUCCESS)) {
+        job->result = STEG_FILE_ERROR;
+    } else if (job->extract && ctx) {
+        // The arena is reused by the worker's next job; keep an exact copy
+        const unsigned char* extracted = NULL;
+        size_t length = 0;
+        job->result = steg_ctx_extract(ctx, &bmp_handler, image->data, image->size, &extracted, &length);
+        unsigned char* buffer = job->result == STEG_SUCCESS ? malloc(length ? length : 1) : NULL;
+        if (buffer) {
+            memcpy(buffer, extracted, length);
+        } else if (job->result == STEG_SUCCESS) {
+            job->result = STEG_MEMORY_ERROR;
+            length = 0;
+        }
+        job->store->data = buffer;
+        job->store->size = length;
+        job->payload_bytes = length;
+    } else if (job->extract) {
+        // A payload never exceeds half the pixel bytes (4 bits per byte)
+        size_t max_len = image->size / 2 + 1;
+        unsigned char* buffer = malloc(max_len);
+        size_t length = 0;
+        job->result = buffer ? extract_payload_buffer(buffer, max_len, &length, image->data, image->size)
+                             : STEG_MEMORY_ERROR;
+        job->store->data = buffer;
+        job->store->size = length;
+        job->payload_bytes = length;
+    } else {
+        static const unsigned char empty[1];
+        const unsigned char* payload = job->message->data ? job->message->data : empty;
+        size_t stored = 0;
+        job->result = ctx ? steg_ctx_embed(ctx, &bmp_handler, image->data, image->size, payload,
+                                           job->message->size, image->data, image->size, &stored)
+                          : embed_payload_buffer(payload, job->message->size, image->data, image->size);
+        job->store->data = image->data;
+        job->store->size = image->size;
+        job->payload_bytes = job->message->size;
+    }
+    if (job->result != STEG_SUCCESS) {
+        job->store->path = NULL;
+    }
+    job->seconds = elapsed_seconds(&start);
+}
+
+// Run the jobs of a batch window by window: load every BMP image and
+// payload of the window, process them in memory on the pool, then store
+// every result
+static int run_batch_windows(batch_t* batch, int io_backend) {
+    steg_file_t* loads = malloc(BATCH_WINDOW * 2 * sizeof(steg_file_t));
+    steg_file_t* stores = malloc(BATCH_WINDOW * sizeof(steg_file_t));
+    steg_file_t* pending = malloc(BATCH_WINDOW * sizeof(steg_file_t));
+    int result = loads && stores && pending ? STEG_SUCCESS : STEG_MEMORY_ERROR;
+    
+    // A context per pool thread, reused by every job that thread runs; a
+    // job whose context could not be created falls back to the heap
+    batch->context_count = steg_thread_pool_threads(batch->pool);
+    batch->contexts = calloc((size_t)batch->context_count, sizeof(steg_ctx_t*));
+    for (int i = 0; batch->contexts && i < batch->context_count; i++) {
+        batch->contexts[i] = steg_ctx_create(0);
+    }
+    if (!batch->contexts) {
+        batch->context_count = 0;
+    }
+    
+    for (size_t first = 0; result == STEG_SUCCESS && first < batch->count; first += BATCH_WINDOW) {
+        batch_window_t window = { batch, first, batch->count - first };
+        size_t load_count = 0;
+        if (window.count > BATCH_WINDOW) {
+            window.count = BATCH_WINDOW;
+        }
+        
+        // Queue the image and payload of every BMP job
+        for (size_t i = 0; i < window.count; i++) {
+            batch_job_t* job = &batch->jobs[first + i];
+            job->image = job->message = NULL;
+            job->store = &stores[i];
+            memset(job->store, 0, sizeof(steg_file_t));
+            if (job->handler != &bmp_handler) {
+                continue;
+            }
+            job->image = &loads[load_count];
+            loads[load_count++].path = job->input;
+            if (!job->extract) {
+                job->message = &loads[load_count];
+                loads[load_count++].path = job->payload;
+            }
+            job->store->path = job->extract ? job->payload : job->output;
+        }
+        
+        result = steg_load_files(loads, load_count, BATCH_MAX_LOADED, io_backend);
+        if (result != STEG_SUCCESS) {
+            // Files that finished before the failure still hold their data
+            for (size_t i = 0; i < load_count; i++) {
+                free(loads[i].data);
+            }
+            break;
+        }
+        steg_thread_pool_run(batch->pool, window.count, run_batch_window_job, &window);
+        
+        // Store the results of the jobs that ran in memory
+        size_t store_count = 0;
+        for (size_t i = 0; i < window.count; i++) {
+            batch_job_t* job = &batch->jobs[first + i];
+            if (batch_job_in_memory(job) && job->store->path) {
+                pending[store_count++] = *job->store;
+            }
+        }
+        result = steg_store_files(pending, store_count, io_backend);
+        
+        store_count = 0;
+        for (size_t i = 0; i < window.count; i++) {
+            batch_job_t* job = &batch->jobs[first + i];
+            if (!batch_job_in_memory(job)) {
+                continue;
+            }
+            if (job->store->path && pending[store_count++].result != STEG_SUCCESS) {
+                job->result = STEG_FILE_ERROR;
+            }
+            if (job->extract) {
+                free(job->store->data);
+            }
+            report_batch_job(batch, job);
+        }
+        
+        for (size_t i = 0; i < load_count; i++) {
+            free(loads[i].data);
+        }
+    }
+    
+    for (int i = 0; i < batch->context_count; i++) {
+        steg_ctx_destroy(batch->contexts[i]);
+    }
+    free(batch->contexts);
+    batch->contexts = NULL;
+    batch->context_count = 0;
+    
+    free(loads);
+    free(stores);
+    free(pending);
+    return result;
+}
+
+// Run every job of a batch with an I/O backend; returns the wall time
+static double execute_batch(batch_t* batch, int io_backend) {
+    struct timespec start;
+    
+    batch->finished = 0;
+    for (size_t i = 0; i < batch->count; i++) {
+        batch_job_t* job = &batch->jobs[i];
+        job->result = STEG_FILE_ERROR;
+        job->payload_bytes = 0;
+        job->image_bytes = 0;
+        job->seconds = 0;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (io_backend == STEG_BATCH_IO_STDIO) {
+        steg_thread_pool_run(batch->pool, batch->count, run_batch_job, batch);
+    } else if (run_batch_windows(batch, io_backend) != STEG_SUCCESS) {
+        print_cli_error("Batch I/O failed");
+    }
+    return elapsed_seconds(&start);
+}
+
+// Report how busy each worker of the pool was over a run
+static void print_worker_stats(const steg_thread_pool_t* pool, double seconds) {
+    steg_worker_stats_t stats[STEG_MAX_THREADS];
+    int workers = steg_thread_pool_stats(pool, stats, STEG_MAX_THREADS);
+    
+    for (int i = 0; i < workers; i++) {
+        printf("Worker %d: %llu tasks (%llu stolen), busy %.3f s (%.1f%%)\n", i, stats[i].tasks,
+               stats[i].stolen, stats[i].busy_seconds,
+               seconds > 0 ? 100.0 * stats[i].busy_seconds / seconds : 0.0);
+    }
+}
+
+// Fold a file into an FNV-1a digest; a missing file folds in nothing
+static uint64_t digest_file(uint64_t hash, const char* path) {
+    unsigned char block[65536];
+    size_t n;
+    FILE* file = fopen(path, "rb");
+    
+    if (!file) {
+        return hash;
+    }
+    while ((n = fread(block, 1, sizeof(block), file)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            hash = (hash ^ block[i]) * 1099511628211ULL;
+        }
+    }
+    fclose(file);
+    return hash;
+}
+
+// Digest of every file a batch wrote, to check that backends agree
+static uint64_t digest_batch_outputs(const batch_t* batch) {
+    uint64_t hash = 14695981039346656037ULL;
+    
+    for (size_t i = 0; i < batch->count; i++) {
+        const batch_job_t* job = &batch->jobs[i];
+        hash = digest_file(hash, job->extract ? job->payload : job->output);
+        hash = (hash ^ (uint64_t)(job->result + 128)) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Time a batch with every I/O backend and check they write the same files
+static int run_batch_benchmark(batch_t* batch) {
+    double stdio_seconds = 0;
+    uint64_t reference = 0;
+    int mismatch = 0;
+    
+    // Warm the page cache so every backend starts from the same state
+    batch->quiet = 1;
+    execute_batch(batch, STEG_BATCH_IO_STDIO);
+    
+    printf("%-10s %10s %10s %8s\n", "Backend", "Jobs/s", "MB/s", "Speedup");
+    for (size_t b = 0; b < sizeof(batch_bench_backends) / sizeof(batch_bench_backends[0]); b++) {
+        int backend = batch_bench_backends[b];
+        if (steg_batch_io_resolve(backend) != backend) {
+            printf("%-10s %10s\n", steg_batch_io_name(backend), "unavailable");
+            continue;
+        }
+        
+        double seconds = execute_batch(batch, backend);
+        long image_bytes = 0;
+        for (size_t i = 0; i < batch->count; i++) {
+            image_bytes += batch->jobs[i].image_bytes;
+        }
+        if (backend == STEG_BATCH_IO_STDIO) {
+            stdio_seconds = seconds;
+        }
+        
+        uint64_t digest = digest_batch_outputs(batch);
+        if (b == 0) {
+            reference = digest;
+        } else if (digest != reference) {
+            mismatch = 1;
+        }
+        
+        printf("%-10s %10.1f %10.1f %7.2fx\n", steg_batch_io_name(backend),
+               seconds > 0 ? batch->count / seconds : 0.0,
+               seconds > 0 ? image_bytes / (1024.0 * 1024.0) / seconds : 0.0,
+               seconds > 0 ? stdio_seconds / seconds : 1.0);
+    }
+    
+    if (mismatch) {
+        print_cli_error("Batch I/O backends wrote different output");
+        return 1;
+    }
+    printf("Output identical across backends\n");
+    return 0;
+}
+
+// Run every job of a manifest on a pool of workers and print totals
+static int run_batch(const char* manifest, int workers, int io_backend, int bench) {
+    batch_t batch;
+    
+    memset(&batch, 0, sizeof(batch));
+    if (parse_batch_manifest(manifest, &batch.jobs, &batch.count) != STEG_SUCCESS) {
+        return 1;
+    }
+    
+    // Handlers are looked up up front, not by the workers. The extension
+    // costs no read; files without a known one are sniffed instead
+    for (size_t i = 0; i < batch.count; i++) {
+        batch.jobs[i].handler = get_format_handler(batch.jobs[i].input);
+        if (!batch.jobs[i].handler) {
+            batch.jobs[i].handler = detect_format_handler(batch.jobs[i].input, NULL);
+        }
+    }
+    
+    // Jobs and the stripe tasks of large images share one work-stealing
+    // pool, so idle workers help finish the big images
+    lsb_active_kernel();
+    pthread_mutex_init(&batch.lock, NULL);
+    
+    batch.pool = workers > 1 ? steg_thread_pool_shared() : NULL;
+    steg_thread_pool_reset_stats(batch.pool);
+    printf("Batch: %zu jobs from %s on %d worker%s\n", batch.count, manifest,
+           steg_thread_pool_threads(batch.pool), steg_thread_pool_threads(batch.pool) == 1 ? "" : "s");
+    
+    if (bench) {
+        int status = run_batch_benchmark(&batch);
+        pthread_mutex_destroy(&batch.lock);
+        free_batch_jobs(batch.jobs, batch.count);
+        return status;
+    }
+    
+    int resolved = steg_batch_io_resolve(io_backend);
+    printf("Batch I/O: %s%s\n", steg_batch_io_name(resolved),
+           resolved != io_backend ? " (io_uring unavailable)" : "");
+    
+    double seconds = execute_batch(&batch, resolved);
+    
+    pthread_mutex_destroy(&batch.lock);
+    
+    size_t succeeded = 0;
+    size_t payload_bytes = 0;
+    long image_bytes = 0;
+    double busy = 0;
+    for (size_t i = 0; i < batch.count; i++) {
+        if (batch.jobs[i].result == STEG_SUCCESS) {
+            succeeded++;
+        }
+        payload_bytes += batch.jobs[i].payload_bytes;
+        image_bytes += batch.jobs[i].image_bytes;
+        busy += batch.jobs[i].seconds;
+    }
+    
+    printf("\nBatch summary: %zu ok, %zu failed\n", succeeded, batch.count - succeeded);
+    printf("Payload: %.2f MB, images: %.2f MB\n", payload_bytes / (1024.0 * 1024.0),
+           image_bytes / (1024.0 * 1024.0));
+    print_throughput(image_bytes, seconds);
+    if (seconds > 0) {
+        printf("Jobs: %.1f jobs/s, %.3f s of job time in %.3f s\n", batch.count / seconds, busy, seconds);
+    }
+    print_worker_stats(batch.pool, seconds);
+    
+    free_batch_jobs(batch.jobs, batch.count);
+    return succeeded == batch.count ? 0 : 1;
+}
+
+// Copy a memfd received from stegd into a file with a kernel copy
+static int store_daemon_output(int memfd, const char* output_file) {
+    FILE* input = fdopen(memfd, "rb");
+    if (!input) {
+        close(memfd);
+        return STEG_FILE_ERROR;
+    }
+    
+    FILE* output = fopen(output_file, "wb");
+    int result = output ? steg_copy_remaining(input, output) : STEG_FILE_ERROR;
+    if (output && fclose(output) != 0 && result == STEG_SUCCESS) {
+        result = STEG_FILE_ERROR;
+    }
+    fclose(input);
+    return result;
+}
+
+// Send one embed, extract or capacity request to a running stegd and
+// report its answer the way a local run would. The image goes over as
+// a file descriptor and a stego image comes back as a memfd, so neither
+// is copied through the socket
+static int run_daemon_request(const char* socket_path, int op, format_handler_t* handler,
+                              const char* input_file, const char* output_file, const char* message,
+                              const char* message_file, const char* payload_out, int verbose) {
+    steg_file_t payload_file;
+    stegd_request_t request;
+    stegd_response_t response;
+    unsigned char* data = NULL;
+    char* message_buffer = NULL;
+    int output_fd = -1;
+    size_t message_length = message ? strlen(message) : 0;
+    
+    memset(&payload_file, 0, sizeof(payload_file));
+    int image_fd = open(input_file, O_RDONLY | O_CLOEXEC);
+    if (image_fd < 0) {
+        print_cli_error("Could not open input file");
+        return 1;
+    }
+    
+    // A payload file is loaded whole, unless it comes from stdin
+    int payload_loaded = 1;
+    if (op == STEGD_OP_EMBED && message_file && strcmp(message_file, "-") == 0) {
+        message_buffer = read_message_from_file(message_file, &message_length);
+        message = message_buffer;
+        payload_loaded = message_buffer != NULL;
+    } else if (op == STEGD_OP_EMBED && message_file) {
+        payload_file.path = message_file;
+        steg_load_files(&payload_file, 1, STEGD_DEFAULT_MAX_IMAGE, STEG_BATCH_IO_PREAD);
+        payload_loaded = payload_file.result == STEG_SUCCESS && (payload_file.size == 0 || payload_file.data);
+    }
+    if (!payload_loaded) {
+        print_cli_error("Could not read message file");
+        free(payload_file.data);
+        close(image_fd);
+        return 1;
+    }
+    
+    memset(&request, 0, sizeof(request));
+    request.op = (uint8_t)op;
+    request.format = (uint8_t)stegd_format_for_name(handler->name);
+    const unsigned char* payload = payload_file.path ? payload_file.data : (const unsigned char*)message;
+    if (op == STEGD_OP_EMBED) {
+        request.payload_length = payload_file.path ? payload_file.size : message_length;
+    }
+    
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int fd = stegd_connect(socket_path);
+    int result = fd < 0 ? STEG_FILE_ERROR
+                        : stegd_call_fd(fd, &request, image_fd, NULL, payload, &response, &data,
+                                        op == STEGD_OP_EMBED ? &output_fd : NULL);
+    double seconds = elapsed_seconds(&start);
+    if (fd >= 0) {
+        close(fd);
+    }
+    close(image_fd);
+    free(payload_file.data);
+    free(message_buffer);
+    
+    if (result != STEG_SUCCESS) {
+        print_cli_error(fd < 0 ? "Could not connect to stegd" : "stegd request failed");
+        print_cli_error(get_error_message(result));
+        return 1;
+    }
+    if (response.status != STEG_SUCCESS) {
+        free(data);
+        print_cli_error(op == STEGD_OP_EMBED ? "Failed to embed message" :
+                        op == STEGD_OP_EXTRACT ? "Failed to extract message" :
+                        "Could not calculate capacity");
+        print_cli_error(get_error_message(response.status));
+        return 1;
+    }
+    
+    if (verbose) {
+        printf("Using stegd at %s (format %s)\n", socket_path, handler->name);
+        printf("Round trip: %.1f us\n", seconds * 1e6);
+    }
+    
+    if (op == STEGD_OP_CAPACITY) {
+        printf("Image: %s\n", input_file);
+        printf("Format: %s\n", handler->name);
+        printf("Capacity: %llu characters\n", (unsigned long long)response.value);
+    } else if (op == STEGD_OP_EMBED) {
+        if (output_fd < 0 || store_daemon_output(output_fd, output_file) != STEG_SUCCESS) {
+            free(data);
+            print_cli_error("Could not create output file");
+            return 1;
+        }
+        if (verbose) {
+            printf("✓ Message embedded successfully\n");
+            printf("✓ Output saved as '%s'\n", output_file);
+            printf("Output copied from stegd via: %s\n",
+                   steg_copy_method_name(steg_last_copy_method()));
+        }
+    } else if (payload_out) {
+        size_t length = (size_t)response.data_length;
+        int failed;
+        if (strcmp(payload_out, "-") == 0) {
+            failed = fwrite(data, 1, length, stdout) != length;
+        } else {
+            steg_file_t output = { payload_out, data, length, STEG_SUCCESS };
+            steg_store_files(&output, 1, STEG_BATCH_IO_PREAD);
+            failed = output.result != STEG_SUCCESS;
+        }
+        free(data);
+        if (failed) {
+            print_cli_error("Could not create payload output file");
+            return 1;
+        }
+        if (verbose) {
+            printf("Payload written: %zu bytes to %s\n", length, payload_out);
+        }
+    } else {
+        printf("Extracted message: \"%.*s\"\n", (int)response.data_length, data ? (char*)data : "");
+        free(data);
+    }
+    
+    return 0;
+}
+
+// Clone the input to the output path and rewrite only the payload bytes
+static int embed_inplace_clone(const char* input_file, const char* output_file, const char* message,
+                               size_t length) {
+    int result = steg_clone_file(input_file, output_file);
+    if (result != STEG_SUCCESS) {
+        return result;
+    }
+    
+    FILE* image = fopen(output_file, "r+b");
+    if (!image) {
+        return STEG_FILE_ERROR;
+    }
+    
+    result = embed_payload_patch((const unsigned char*)message, length, image);
+    if (fclose(image) != 0 && result == STEG_SUCCESS) {
+        result = STEG_FILE_ERROR;
+    }
+    
+    return result;
+}
+
+// Copy stdin into a memfd and name it by path, so a piped image can be
+// seeked, mapped and handed to stegd like any file
+static const char* spool_stdin(void) {
+    static char path[32];
+    unsigned char buffer[65536];
+    ssize_t length;
+    
+    int fd = memfd_create("steg-stdin", 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    
+    while ((length = read(STDIN_FILENO, buffer, sizeof(buffer))) != 0) {
+        if (length < 0 || write(fd, buffer, (size_t)length) != length) {
+            close(fd);
+            return NULL;
+        }
+    }
+    
+    // The memfd stays open for the life of the process
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    return path;
+}
+
 int main(int argc, char* argv[]) {
     int embed_mode = 0;
     int extract_mode = 0;
     int capacity_mode = 0;
     int verbose = 0;
+    int inplace_clone = 0;
+    int bench_threads = 0;
     
     char* input_file = "image.bmp";
     char* output_file = "output.bmp";
     char* message = NULL;
     char* message_file = NULL;
+    char* payload_out = NULL;
+    char* batch_manifest = NULL;
+    int batch_io = STEG_BATCH_IO_STDIO;
+    int bench_batch_io = 0;
+    char* daemon_socket = NULL;
     
     // Long options
     static struct option long_options[] = {
@@ -98,7 +1215,20 @@ int main(int argc, char* argv[]) {
         {"output", required_argument, 0, 'o'},
         {"message", required_argument, 0, 'm'},
         {"file", required_argument, 0, 'f'},
+        {"payload-out", required_argument, 0, 'O'},
         {"capacity", no_argument, 0, 'c'},
+        {"block-size", required_argument, 0, 'b'},
+        {"inplace-clone", no_argument, 0, OPT_INPLACE_CLONE},
+        {"io", required_argument, 0, OPT_IO},
+        {"populate", no_argument, 0, OPT_POPULATE},
+        {"bits", required_argument, 0, OPT_BITS},
+        {"threads", required_argument, 0, 't'},
+        {"bench-threads", optional_argument, 0, OPT_BENCH_THREADS},
+        {"batch", required_argument, 0, OPT_BATCH},
+        {"pipeline", required_argument, 0, OPT_PIPELINE},
+        {"batch-io", required_argument, 0, OPT_BATCH_IO},
+        {"bench-batch-io", no_argument, 0, OPT_BENCH_BATCH_IO},
+        {"daemon", required_argument, 0, OPT_DAEMON},
         {"verbose", no_argument, 0, 'v'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}
@@ -107,7 +1237,7 @@ int main(int argc, char* argv[]) {
     int option_index = 0;
     int c;
     
-    while ((c = getopt_long(argc, argv, "exi:o:m:f:cvh", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "exi:o:m:f:O:cb:t:vh", long_options, &option_index)) != -1) {
         switch (c) {
             case 'e':
                 embed_mode = 1;
@@ -127,9 +1257,89 @@ int main(int argc, char* argv[]) {
             case 'f':
                 message_file = optarg;
                 break;
+            case 'O':
+                payload_out = optarg;
+                break;
             case 'c':
                 capacity_mode = 1;
                 break;
+            case 'b': {
+                size_t block_size;
+                if (!parse_size(optarg, &block_size) ||
+                    steg_set_block_size(block_size) != STEG_SUCCESS) {
+                    print_cli_error("Invalid block size");
+                    return 1;
+                }
+                break;
+            }
+            case 't': {
+                char* end;
+                long threads = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || threads < 0 || threads > STEG_MAX_THREADS ||
+                    steg_set_threads((int)threads) != STEG_SUCCESS) {
+                    print_cli_error("Threads must be between 0 and 256");
+                    return 1;
+                }
+                break;
+            }
+            case OPT_BATCH_IO:
+                batch_io = steg_parse_batch_io(optarg);
+                if (batch_io < 0) {
+                    print_cli_error("Unknown batch I/O backend (use stdio, pread or uring)");
+                    return 1;
+                }
+                break;
+            case OPT_BENCH_BATCH_IO:
+                bench_batch_io = 1;
+                break;
+            case OPT_DAEMON:
+                daemon_socket = optarg;
+                break;
+            case OPT_PIPELINE: {
+                char* end;
+                long depth = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || depth < 0 || depth > STEG_MAX_PIPELINE_DEPTH ||
+                    steg_set_pipeline_depth((int)depth) != STEG_SUCCESS) {
+                    print_cli_error("Pipeline depth must be between 0 and 64");
+                    return 1;
+                }
+                break;
+            }
+            case OPT_BENCH_THREADS:
+                bench_threads = optarg ? atoi(optarg) : 0;
+                if (bench_threads < 0 || bench_threads > STEG_MAX_THREADS) {
+                    print_cli_error("Threads must be between 0 and 256");
+                    return 1;
+                }
+                if (bench_threads == 0) {
+                    // One per online CPU, as resolved by --threads 0
+                    int configured = steg_get_threads();
+                    steg_set_threads(0);
+                    bench_threads = steg_get_threads();
+                    steg_set_threads(configured);
+                }
+                break;
+            case OPT_BATCH:
+                batch_manifest = optarg;
+                break;
+            case OPT_INPLACE_CLONE:
+                inplace_clone = 1;
+                break;
+            case OPT_IO:
+                if (steg_set_io_backend(steg_parse_io_backend(optarg)) != STEG_SUCCESS) {
+                    print_cli_error("Unknown I/O backend (use stdio, mmap or pread)");
+                    return 1;
+                }
+                break;
+            case OPT_POPULATE:
+                steg_set_mmap_populate(1);
+                break;
+            case OPT_BITS:
+                if (steg_set_bits_per_channel(atoi(optarg)) != STEG_SUCCESS) {
+                    print_cli_error("Bits per channel must be between 1 and 4");
+                    return 1;
+                }
+                break;
             case 'v':
                 verbose = 1;
                 break;
@@ -144,6 +1354,19 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    // Batch mode runs its own jobs; -t sets the number of workers
+    if (batch_manifest) {
+        if (embed_mode || extract_mode || capacity_mode) {
+            print_cli_error("--batch cannot be combined with -e, -x or -c");
+            return 1;
+        }
+        return run_batch(batch_manifest, steg_get_threads(), batch_io, bench_batch_io);
+    }
+    if (batch_io != STEG_BATCH_IO_STDIO || bench_batch_io) {
+        print_cli_error("--batch-io and --bench-batch-io need --batch");
+        return 1;
+    }
+    
     // Validate arguments
     if (!embed_mode && !extract_mode && !capacity_mode) {
         print_cli_error("Must specify a mode: embed (-e), extract (-x), or capacity (-c)");
@@ -166,16 +1389,78 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    // Get format handler for input file
-    format_handler_t* handler = get_format_handler(input_file);
+    if (strcmp(input_file, "-") == 0) {
+        if (message_file && strcmp(message_file, "-") == 0) {
+            print_cli_error("Cannot read both the image (-i) and the message (-f) from stdin");
+            return 1;
+        }
+        const char* spooled = spool_stdin();
+        if (!spooled) {
+            print_cli_error("Could not read input image from stdin");
+            return 1;
+        }
+        input_file = (char*)spooled;
+    }
+    
+    // Get format handler for input file, from its signature when it has
+    // one the handlers know and from its extension otherwise
+    int sniffed = 0;
+    format_handler_t* handler = detect_format_handler(input_file, &sniffed);
     if (!handler) {
         print_cli_error("Unsupported file format. Supported formats:");
         fprintf(stderr, "  %s\n", get_supported_formats());
         return 1;
     }
     
+    if (inplace_clone && handler != &bmp_handler) {
+        print_cli_error("--inplace-clone is only supported for BMP images");
+        return 1;
+    }
+    
+    if (payload_out && handler != &bmp_handler) {
+        print_cli_error("--payload-out is only supported for BMP images");
+        return 1;
+    }
+    
+    // Keep stdout clean when the payload itself goes there
+    if (payload_out && strcmp(payload_out, "-") == 0) {
+        verbose = 0;
+    }
+    
+    if (bench_threads && (handler != &bmp_handler || !extract_mode)) {
+        print_cli_error("--bench-threads needs extract mode (-x) and a BMP image");
+        return 1;
+    }
+    
+    if (steg_get_bits_per_channel() != 1 && handler != &bmp_handler) {
+        print_cli_error("--bits is only supported for BMP images");
+        return 1;
+    }
+    
+    // The daemon does the work, with its own settings
+    if (daemon_socket) {
+        if (inplace_clone || bench_threads || steg_get_bits_per_channel() != 1) {
+            print_cli_error("--daemon cannot be combined with --inplace-clone, --bench-threads or --bits");
+            return 1;
+        }
+        int op = embed_mode ? STEGD_OP_EMBED : extract_mode ? STEGD_OP_EXTRACT : STEGD_OP_CAPACITY;
+        return run_daemon_request(daemon_socket, op, handler, input_file, output_file,
+                                  message, message_file, payload_out, verbose);
+    }
+    
     if (verbose) {
         printf("Using format handler: %s\n", handler->name);
+        if (handler == &bmp_handler) {
+            printf("Using I/O backend: %s\n", steg_io_backend_name(steg_get_io_backend()));
+            printf("Using LSB kernel: %s\n", lsb_active_kernel()->name);
+            printf("Bits per channel: %d\n", steg_get_bits_per_channel());
+            printf("Threads: %d\n", steg_get_threads());
+            if (steg_get_pipeline_depth() < 2) {
+                printf("Pipeline: off\n");
+            } else {
+                printf("Pipeline: %d strip buffers\n", steg_get_pipeline_depth());
+            }
+        }
     }
     
     // Open input file
@@ -185,8 +1470,8 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    // Validate file format
-    if (!handler->validate(input)) {
+    // Validate file format; a sniffed signature already was
+    if (!sniffed && !handler->validate(input)) {
         print_cli_error("Invalid file format");
         fclose(input);
         return 1;
@@ -211,11 +1496,27 @@ int main(int argc, char* argv[]) {
     
     // Handle embed mode
     if (embed_mode) {
-        char message_buffer[4096];
+        char* message_buffer = NULL;
+        FILE* payload = NULL;
+        size_t payload_length = 0;
+        size_t message_length = message ? strlen(message) : 0;
+        
+        // BMP file payloads are streamed straight into the pixel engine;
+        // everything else needs the whole message in memory
+        int stream_payload = message_file && handler == &bmp_handler &&
+                             steg_get_io_backend() == STEG_IO_STDIO && !inplace_clone;
         
-        // Get message from file if specified
-        if (message_file) {
-            if (!read_message_from_file(message_file, message_buffer, sizeof(message_buffer))) {
+        if (stream_payload) {
+            payload = open_payload_file(message_file);
+            if (!payload) {
+                print_cli_error("Could not read message file");
+                fclose(input);
+                return 1;
+            }
+            payload_length = payload_file_length(payload);
+        } else if (message_file) {
+            message_buffer = read_message_from_file(message_file, &message_length);
+            if (!message_buffer) {
                 print_cli_error("Could not read message file");
                 fclose(input);
                 return 1;
@@ -223,43 +1524,96 @@ int main(int argc, char* argv[]) {
             message = message_buffer;
         }
         
+        // Only the BMP engine takes a length; the other handlers take text
+        // and would silently stop at the first NUL
+        if (!stream_payload && handler != &bmp_handler && memchr(message, '\0', message_length)) {
+            print_cli_error("Message contains NUL bytes; binary payloads need a BMP image");
+            free(message_buffer);
+            fclose(input);
+            return 1;
+        }
+        
         if (verbose) {
-            printf("Embedding message: \"%s\"\n", message);
-            printf("Message length: %zu characters\n", strlen(message));
+            if (stream_payload) {
+                printf("Streaming payload from: %s\n", message_file);
+                if (payload_length != STEG_LENGTH_UNKNOWN) {
+                    printf("Payload length: %zu bytes\n", payload_length);
+                } else {
+                    printf("Payload length: unknown until end of input\n");
+                }
+            } else {
+                printf("Embedding message: \"%s\"\n", message);
+                printf("Message length: %zu characters\n", message_length);
+            }
         }
         
-        // Check capacity
+        // Check capacity; failures still go through the cleanup below
+        const char* failure = NULL;
         long capacity = handler->get_capacity(input);
+        size_t needed = stream_payload ? payload_length : message_length;
         if (capacity < 0) {
-            print_cli_error("Could not calculate capacity");
-            fclose(input);
-            return 1;
+            failure = "Could not calculate capacity";
+        } else if (needed != STEG_LENGTH_UNKNOWN && needed > (size_t)capacity) {
+            failure = "Message too long for image capacity";
         }
         
-        if (strlen(message) > (size_t)capacity) {
-            print_cli_error("Message too long for image capacity");
-            fclose(input);
-            return 1;
-        }
+        long image_size = get_file_size(input);
+        struct timespec start;
+        int result = STEG_SUCCESS;
+        clock_gettime(CLOCK_MONOTONIC, &start);
         
-        // Open output file
-        FILE* output = fopen(output_file, "wb");
-        if (!output) {
-            print_cli_error("Could not create output file");
+        if (failure) {
+            fclose(input);
+        } else if (inplace_clone) {
+            fclose(input);
+            
+            // Embed message into a clone of the input
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            result = embed_inplace_clone(input_file, output_file, message, message_length);
+        } else {
+            // Open output file
+            FILE* output = fopen(output_file, "wb");
+            if (!output) {
+                failure = "Could not create output file";
+            } else {
+                // Embed message
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                if (stream_payload) {
+                    result = embed_payload_stream(payload, payload_length, input, output, &payload_length);
+                } else if (handler == &bmp_handler) {
+                    result = embed_payload_io((const unsigned char*)message, message_length, input, output);
+                } else {
+                    result = handler->embed(input, output, message);
+                }
+                if (fclose(output) != 0 && result == STEG_SUCCESS) {
+                    result = STEG_FILE_ERROR;
+                }
+            }
+            
             fclose(input);
-            return 1;
         }
+        double seconds = elapsed_seconds(&start);
         
-        // Embed message
-        int result = handler->embed(input, output, message);
+        if (payload && payload != stdin) {
+            fclose(payload);
+        }
+        free(message_buffer);
         
-        fclose(input);
-        fclose(output);
+        if (failure) {
+            print_cli_error(failure);
+            return 1;
+        }
         
         if (result == STEG_SUCCESS) {
             if (verbose) {
                 printf("✓ Message embedded successfully\n");
+                if (stream_payload) {
+                    printf("Payload embedded: %zu bytes\n", payload_length);
+                }
                 printf("✓ Output saved as '%s'\n", output_file);
+                printf("Unchanged data copied via: %s\n",
+                       steg_copy_method_name(steg_last_copy_method()));
+                print_throughput(image_size, seconds);
             }
         } else {
             print_cli_error("Failed to embed message");
@@ -268,20 +1622,87 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    // Benchmark extraction scaling instead of extracting once
+    if (bench_threads) {
+        int result = run_thread_benchmark(input, bench_threads);
+        fclose(input);
+        if (result != STEG_SUCCESS) {
+            print_cli_error("Thread benchmark failed");
+            print_cli_error(get_error_message(result));
+            return 1;
+        }
+        return 0;
+    }
+    
     // Handle extract mode
     if (extract_mode) {
-        char extracted_message[4096];
+        if (verbose && handler == &bmp_handler) {
+            steg_payload_header_t payload_header;
+            if (read_payload_header(input, &payload_header) == STEG_SUCCESS) {
+                printf("Payload header: v%u, %llu bytes at %u bits per channel\n",
+                       payload_header.version, (unsigned long long)payload_header.length,
+                       payload_header.bits_per_channel);
+            } else {
+                printf("Payload header: none (legacy NUL-terminated layout)\n");
+            }
+        }
+        
+        char* extracted_message = NULL;
+        FILE* sink = NULL;
+        size_t extracted_length = 0;
+        
+        if (payload_out) {
+            sink = strcmp(payload_out, "-") == 0 ? stdout : fopen(payload_out, "wb");
+            if (!sink) {
+                print_cli_error("Could not create payload output file");
+                fclose(input);
+                return 1;
+            }
+        } else {
+            // Size the buffer once, from the payload header when there is one
+            size_t buffer_size = extract_buffer_size(handler, input);
+            extracted_message = malloc(buffer_size);
+            if (!extracted_message) {
+                print_cli_error(get_error_message(STEG_MEMORY_ERROR));
+                fclose(input);
+                return 1;
+            }
+            extracted_length = buffer_size;
+        }
         
-        int result = handler->extract(input, extracted_message, sizeof(extracted_message));
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        
+        int result;
+        if (sink) {
+            result = extract_payload_stream(input, sink, &extracted_length);
+            if (sink != stdout && fclose(sink) != 0 && result == STEG_SUCCESS) {
+                result = STEG_FILE_ERROR;
+            }
+        } else {
+            result = handler->extract(input, extracted_message, extracted_length);
+        }
+        double seconds = elapsed_seconds(&start);
+        
+        // Extraction stops early, so only count the bytes actually scanned
+        long scanned_bytes = ftell(input);
         
         fclose(input);
         
         if (result == STEG_SUCCESS) {
             if (verbose) {
                 printf("✓ Message extracted successfully\n");
+                if (sink) {
+                    printf("Payload written: %zu bytes to %s\n", extracted_length, payload_out);
+                }
+                print_throughput(scanned_bytes, seconds);
+            }
+            if (!sink) {
+                printf("Extracted message: \"%s\"\n", extracted_message);
             }
-            printf("Extracted message: \"%s\"\n", extracted_message);
+            free(extracted_message);
         } else {
+            free(extracted_message);
             print_cli_error("Failed to extract message");
             print_cli_error(get_error_message(result));
             return 1;
@@ -0,0 +1,361 @@
+/**
+ * @file steg_ctx.c
+ * @brief LSB Steganography Tool - Reusable Steganography Context
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * The arena is a list of blocks, newest first. Allocation bumps the
+ * newest block and only adds a block when it is full; a reset after
+ * growth frees the list and replaces it with one block of the combined
+ * size, so the arena settles at the size of the largest call.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/steg_ctx.h"
+#include "../include/steg.h"
+#include "../include/steg_bmp.h"
+#include <stdint.h>
+
+// Alignment of every arena allocation (one cache line)
+#define ARENA_ALIGN 64
+
+// One block of arena memory
+typedef struct arena_block {
+    struct arena_block* next;
+    size_t size;          // Usable bytes at data
+    size_t used;          // Bytes handed out
+    unsigned char* data;  // Aligned start of the usable bytes
+} arena_block_t;
+
+struct steg_ctx {
+    arena_block_t* blocks;       // Newest block first
+    size_t in_use;               // Bytes handed out since the last reset
+    steg_engine_t engine;        // Kernel, pool and depth every BMP call runs with
+    size_t block_size;           // Strip block size every BMP call runs with
+    steg_ctx_stats_t stats;
+};
+
+// Round size up to the arena alignment
+static size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// Put a new block of at least size bytes in front of the arena
+static arena_block_t* push_block(steg_ctx_t* ctx, size_t size) {
+    if (size > SIZE_MAX - sizeof(arena_block_t) - ARENA_ALIGN) {
+        return NULL;
+    }
+    arena_block_t* block = malloc(sizeof(arena_block_t) + ARENA_ALIGN + size);
+    if (!block) {
+        return NULL;
+    }
+    
+    uintptr_t start = (uintptr_t)(block + 1);
+    block->data = (unsigned char*)((start + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1));
+    block->size = size;
+    block->used = 0;
+    block->next = ctx->blocks;
+    ctx->blocks = block;
+    ctx->stats.allocations++;
+    ctx->stats.arena_size += size;
+    return block;
+}
+
+// Free every block of the arena
+static void free_blocks(steg_ctx_t* ctx) {
+    while (ctx->blocks) {
+        arena_block_t* next = ctx->blocks->next;
+        free(ctx->blocks);
+        ctx->blocks = next;
+    }
+    ctx->stats.arena_size = 0;
+}
+
+// Create a context
+steg_ctx_t* steg_ctx_create(size_t arena_size) {
+    steg_ctx_t* ctx = calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        return NULL;
+    }
+    
+    if (!push_block(ctx, align_up(arena_size ? arena_size : STEG_CTX_DEFAULT_ARENA))) {
+        free(ctx);
+        return NULL;
+    }
+    
+    // Copy the process-wide settings now, so calls neither look them up
+    // nor see them change
+    steg_engine_defaults(&ctx->engine);
+    ctx->block_size = steg_get_block_size();
+    return ctx;
+}
+
+// Free a context and its arena
+void steg_ctx_destroy(steg_ctx_t* ctx) {
+    if (!ctx) {
+        return;
+    }
+    free_blocks(ctx);
+    free(ctx);
+}
+
+// Take bytes from the arena
+void* steg_ctx_alloc(steg_ctx_t* ctx, size_t size) {
+    if (!ctx || size > SIZE_MAX - ARENA_ALIGN) {
+        return NULL;
+    }
+    size = align_up(size ? size : 1);
+    
+    arena_block_t* block = ctx->blocks;
+    if (!block || block->size - block->used < size) {
+        // Grow geometrically so a run of large calls settles quickly
+        size_t grow = ctx->stats.arena_size > size ? ctx->stats.arena_size : size;
+        block = push_block(ctx, grow);
+        if (!block) {
+            return NULL;
+        }
+    }
+    
+    void* data = block->data + block->used;
+    block->used += size;
+    ctx->in_use += size;
+    if (ctx->in_use > ctx->stats.arena_peak) {
+        ctx->stats.arena_peak = ctx->in_use;
+    }
+    return data;
+}
+
+// Release everything taken from the arena
+void steg_ctx_reset(steg_ctx_t* ctx) {
+    if (!ctx) {
+        return;
+    }
+    
+    // Coalesce a grown arena into one block that holds all of it
+    if (ctx->blocks && ctx->blocks->next) {
+        size_t total = ctx->stats.arena_size;
+        free_blocks(ctx);
+        push_block(ctx, total);
+    }
+    if (ctx->blocks) {
+        ctx->blocks->used = 0;
+    }
+    ctx->in_use = 0;
+}
+
+// LSB kernel resolved when the context was created
+const lsb_kernel_t* steg_ctx_kernel(const steg_ctx_t* ctx) {
+    return ctx ? ctx->engine.kernel : NULL;
+}
+
+// Thread pool resolved when the context was created
+steg_thread_pool_t* steg_ctx_pool(const steg_ctx_t* ctx) {
+    return ctx ? ctx->engine.pool : NULL;
+}
+
+// Start a call: empty the arena and count it
+static void begin_call(steg_ctx_t* ctx) {
+    steg_ctx_reset(ctx);
+    ctx->stats.calls++;
+}
+
+// Scratch for a memory strip cursor over layout, from the arena
+static int strips_scratch(steg_ctx_t* ctx, const steg_bmp_layout_t* layout, unsigned char** scratch) {
+    size_t size = steg_strips_memory_scratch(layout, ctx->block_size, &ctx->engine);
+    
+    *scratch = NULL;
+    if (size > 0 && !(*scratch = steg_ctx_alloc(ctx, size))) {
+        return STEG_MEMORY_ERROR;
+    }
+    return STEG_SUCCESS;
+}
+
+// Embed into a BMP with the headers parsed once
+static int bmp_embed(steg_ctx_t* ctx, const unsigned char* image, size_t image_size,
+                     const unsigned char* payload, size_t length,
+                     unsigned char* output, size_t output_capacity, size_t* output_size) {
+    steg_bmp_layout_t layout;
+    steg_strips_t strips;
+    unsigned char* scratch;
+    
+    int result = steg_bmp_parse_layout(image, image_size, image_size, &layout);
+    if (result != STEG_SUCCESS) {
+        return result;
+    }
+    if (output_capacity < image_size) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    if (length > steg_capacity_at(steg_bmp_pixel_bytes(&layout), ctx->engine.bits)) {
+        return STEG_INSUFFICIENT_CAPACITY;
+    }
+    
+    result = strips_scratch(ctx, &layout, &scratch);
+    if (result != STEG_SUCCESS) {
+        return result;
+    }
+    if (output != image) {
+        memcpy(output, image, image_size);
+    }
+    
+    result = steg_strips_open_memory_scratch(&strips, &layout, output, ctx->block_size, &ctx->engine, scratch);
+    if (result == STEG_SUCCESS) {
+        result = steg_embed_strips(&strips, payload ? payload : (const unsigned char*)"", NULL, length, NULL);
+    }
+    steg_strips_close(&strips);
+    
+    if (result == STEG_SUCCESS) {
+        *output_size = image_size;
+    }
+    return result;
+}
+
+// Extract from a BMP with the headers parsed once; the payload header,
+// when present, sizes the result exactly
+static int bmp_extract(steg_ctx_t* ctx, const unsigned char* image, size_t image_size,
+                       const unsigned char** payload, size_t* length) {
+    steg_bmp_layout_t layout;
+    steg_strips_t strips;
+    steg_payload_header_t header;
+    unsigned char encoded[STEG_PAYLOAD_HEADER_SIZE];
+    unsigned char* scratch;
+    
+    int result = steg_bmp_parse_layout(image, image_size, image_size, &layout);
+    if (result != STEG_SUCCESS) {
+        return result;
+    }
+    result = strips_scratch(ctx, &layout, &scratch);
+    if (result != STEG_SUCCESS) {
+        return result;
+    }
+    
+    // Extraction never stores, so the image is only read
+    result = steg_strips_open_memory_scratch(&strips, &layout, (unsigned char*)image, ctx->block_size,
+                                             &ctx->engine, scratch);
+    if (result == STEG_SUCCESS) {
+        // The most any depth can hold, unless the header says otherwise
+        size_t max_len = lsb_payload_for(steg_bmp_pixel_bytes(&layout), STEG_MAX_BITS_PER_CHANNEL);
+        if (steg_strips_read_header(&strips, encoded) == STEG_SUCCESS &&
+            steg_decode_payload_header(encoded, &header) == STEG_SUCCESS && header.length < max_len) {
+            max_len = (size_t)header.length;
+        }
+        
+        unsigned char* buffer = steg_ctx_alloc(ctx, max_len + 1);
+        if (!buffer) {
+            result = STEG_MEMORY_ERROR;
+        } else {
+            result = steg_extract_strips(&strips, buffer, NULL, max_len, length);
+            buffer[*length] = '\0';
+            *payload = buffer;
+        }
+    }
+    steg_strips_close(&strips);
+    return result;
+}
+
+// Message capacity of an image in memory
+int steg_ctx_capacity(steg_ctx_t* ctx, const format_handler_t* handler, const unsigned char* image,
+                      size_t image_size, size_t* capacity) {
+    if (!ctx || !handler || !image || !capacity) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    begin_call(ctx);
+    *capacity = 0;
+    
+    if (handler == &bmp_handler) {
+        steg_bmp_layout_t layout;
+        int result = steg_bmp_parse_layout(image, image_size, image_size, &layout);
+        if (result == STEG_SUCCESS) {
+            *capacity = steg_capacity_at(steg_bmp_pixel_bytes(&layout), ctx->engine.bits);
+        }
+        return result;
+    }
+    
+    long handler_capacity = handler->validate_buffer(image, image_size) ?
+                            handler->get_capacity_buffer(image, image_size) : -1;
+    if (handler_capacity < 0) {
+        return STEG_INVALID_BMP;
+    }
+    *capacity = (size_t)handler_capacity;
+    return STEG_SUCCESS;
+}
+
+// Embed a payload into an image in memory
+int steg_ctx_embed(steg_ctx_t* ctx, const format_handler_t* handler, const unsigned char* image,
+                   size_t image_size, const unsigned char* payload, size_t length,
+                   unsigned char* output, size_t output_capacity, size_t* output_size) {
+    if (!ctx || !handler || !image || (!payload && length > 0) || !output || !output_size) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    begin_call(ctx);
+    *output_size = 0;
+    
+    if (handler == &bmp_handler) {
+        return bmp_embed(ctx, image, image_size, payload, length, output, output_capacity, output_size);
+    }
+    
+    long capacity = handler->validate_buffer(image, image_size) ?
+                    handler->get_capacity_buffer(image, image_size) : -1;
+    if (capacity < 0) {
+        return STEG_INVALID_BMP;
+    }
+    
+    // The handlers take text: the message ends at its first NUL
+    if (length > 0 && memchr(payload, '\0', length)) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    if (length > (size_t)capacity) {
+        return STEG_INSUFFICIENT_CAPACITY;
+    }
+    
+    char* message = steg_ctx_alloc(ctx, length + 1);
+    if (!message) {
+        return STEG_MEMORY_ERROR;
+    }
+    if (length > 0) {
+        memcpy(message, payload, length);
+    }
+    message[length] = '\0';
+    return handler->embed_buffer(image, image_size, message, output, output_capacity, output_size);
+}
+
+// Extract a payload from an image in memory
+int steg_ctx_extract(steg_ctx_t* ctx, const format_handler_t* handler, const unsigned char* image,
+                     size_t image_size, const unsigned char** payload, size_t* length) {
+    if (!ctx || !handler || !image || !payload || !length) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    begin_call(ctx);
+    *payload = NULL;
+    *length = 0;
+    
+    if (handler == &bmp_handler) {
+        return bmp_extract(ctx, image, image_size, payload, length);
+    }
+    
+    if (!handler->validate_buffer(image, image_size)) {
+        return STEG_INVALID_BMP;
+    }
+    
+    // No handler hides more than one message byte in two image bytes
+    size_t max_len = image_size / 2 + 1;
+    char* buffer = steg_ctx_alloc(ctx, max_len);
+    if (!buffer) {
+        return STEG_MEMORY_ERROR;
+    }
+    int result = handler->extract_buffer(image, image_size, buffer, max_len);
+    if (result == STEG_SUCCESS) {
+        *length = strnlen(buffer, max_len - 1);
+        buffer[*length] = '\0';
+        *payload = (const unsigned char*)buffer;
+    }
+    return result;
+}
+
+// Read the counters of a context
+void steg_ctx_stats(const steg_ctx_t* ctx, steg_ctx_stats_t* stats) {
+    if (ctx && stats) {
+        *stats = ctx->stats;
+    }
+}
@@ -0,0 +1,1085 @@
+/**
+ * @file steg_http.c
+ * @brief LSB Steganography Tool - Local HTTP Service for the Web GUI
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * Serves web/web_gui.html and the sample images, and runs the embed,
+ * extract and capacity operations the GUI asks for on the real format
+ * handlers. The GUI posts the image (and message) as multipart form
+ * data to /api/embed, /api/extract or /api/capacity; the body is split
+ * into its parts while it arrives, and the answer is a stream of
+ * server-sent events:
+ *
+ *   progress  {"stage":"upload","done":N,"total":M} while the upload comes in,
+ *             {"stage":"embed"} (or extract, capacity) while it is processed,
+ *             {"stage":"download","done":N,"total":M} while the result goes out
+ *   result    {"status":0,"format":"BMP","capacity":N} or {...,"length":N}
+ *   data      Base64 slice of the stego image or extracted payload
+ *   error     {"status":S,"message":"..."}
+ *   done      End of the stream
+ *
+ * Each connection has its own thread for its blocking socket I/O, which
+ * is mostly waiting on the browser; the operation itself is handed to
+ * the shared work-stealing pool, as in stegd. Every response closes its
+ * connection.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/steg.h"
+#include "../include/steg_bmp.h"
+#include "../include/steg_multipart.h"
+#include "../include/formats.h"
+#include "../include/thread_pool.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <strings.h>
+#include <sys/sendfile.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Address and port listened on when none are given
+#define HTTP_DEFAULT_ADDRESS "127.0.0.1"
+#define HTTP_DEFAULT_PORT 8080
+
+// Largest request body accepted by default (256 MiB)
+#define HTTP_DEFAULT_MAX_UPLOAD (256 * 1024 * 1024)
+
+// Largest request line plus headers
+#define HTTP_MAX_HEAD 8192
+
+// Connections served at once; more are turned away with 503
+#define HTTP_MAX_CONNECTIONS 64
+
+// Pending connections queued by the kernel
+#define LISTEN_BACKLOG 128
+
+// Bytes taken from the socket per read of an upload
+#define HTTP_READ_CHUNK (256 * 1024)
+
+// Result bytes per data event (64 KiB once in Base64)
+#define HTTP_DATA_CHUNK (48 * 1024)
+
+// Seconds a connection may sit idle in a read or write
+#define HTTP_IO_TIMEOUT 30
+
+// Page the root redirects to
+#define HTTP_INDEX "/web/web_gui.html"
+
+// Directories below the root that GET may serve: the GUI and the samples it loads
+static const char* served_dirs[] = { "/web/", "/samples/" };
+
+// Operations, named after the stage reported while they run
+enum {
+    OP_EMBED,
+    OP_EXTRACT,
+    OP_CAPACITY
+};
+
+static const char* op_names[] = { "embed", "extract", "capacity" };
+
+// Which form field the bytes of the current part belong to
+enum {
+    PART_OTHER,
+    PART_IMAGE,
+    PART_MESSAGE
+};
+
+typedef struct server_state {
+    int listen_fd;
+    int signal_fd;                  // SIGINT and SIGTERM
+    const char* root;               // Directory the GUI and samples are served from
+    size_t max_upload;
+    int verbose;
+    steg_thread_pool_t* pool;
+    pthread_mutex_t lock;
+    pthread_cond_t idle;            // Signalled when a connection ends
+    int active;                     // Open connections, guarded by lock
+    unsigned long long served;      // Operations answered, guarded by lock
+} server_t;
+
+// One client connection and its request head
+typedef struct {
+    int fd;
+    server_t* server;
+    char head[HTTP_MAX_HEAD + 1];   // Request line and headers, then the first body bytes
+    size_t head_length;
+    size_t body_start;              // Offset of the body in head
+    char method[8];
+    char path[1024];
+    char content_type[256];
+    long long content_length;       // -1 when there is none
+    int chunked;                    // Body sent with a transfer coding
+    int expect_continue;            // Client waits for 100 Continue
+    int code;                       // Status sent, for the log
+} connection_t;
+
+// One operation: the uploaded parts, then the result
+typedef struct {
+    int op;
+    format_handler_t* handler;
+    size_t upload_size;             // Content-Length of the upload
+    int part;
+    char filename[STEG_MULTIPART_MAX_NAME];
+    unsigned char* image;
+    size_t image_size;
+    size_t image_capacity;
+    unsigned char* payload;         // Message bytes, kept NUL-terminated
+    size_t payload_size;
+    size_t payload_capacity;
+    int status;
+    uint64_t capacity;
+    unsigned char* data;            // Result; may point into image
+    size_t data_length;
+    pthread_mutex_t lock;
+    pthread_cond_t finished;
+    int done;                       // Set by the worker, guarded by lock
+} job_t;
+
+static void print_help(void) {
+    printf("LSB Steganography Tool v1.1 - Local HTTP Service\n");
+    printf("================================================\n\n");
+    printf("Usage: %s [OPTIONS]\n\n", "steg_http");
+    
+    printf("Options:\n");
+    printf("  -a, --address <ip>       Address to listen on (default: %s)\n", HTTP_DEFAULT_ADDRESS);
+    printf("  -p, --port <port>        Port to listen on (default: %d)\n", HTTP_DEFAULT_PORT);
+    printf("  -r, --root <dir>         Directory holding web/ and samples/ (default: .)\n");
+    printf("  -t, --threads <n>        Worker threads, 0 for one per CPU (default: 0)\n");
+    printf("      --max-upload <MiB>   Largest upload accepted (default: %d)\n",
+           HTTP_DEFAULT_MAX_UPLOAD / (1024 * 1024));
+    printf("      --bits <n>           Payload bits per color channel for BMP embeds,\n");
+    printf("                           1-4 (default: 1)\n");
+    printf("  -v, --verbose            Log every request to stderr\n");
+    printf("  -h, --help               Show this help message\n\n");
+    
+    printf("Endpoints:\n");
+    printf("  GET  /                   Redirect to the web GUI\n");
+    printf("  GET  /web/, /samples/    The GUI and the sample images; nothing else is served\n");
+    printf("  POST /api/embed          Fields image and message; streams the stego image\n");
+    printf("  POST /api/extract        Field image; streams the hidden message\n");
+    printf("  POST /api/capacity       Field image; reports the capacity in bytes\n\n");
+    
+    printf("Examples:\n");
+    printf("  %s -p 8080 -t 4          Then open http://127.0.0.1:8080/\n", "steg_http");
+}
+
+// Text shown in the GUI for an error code
+static const char* error_text(int status) {
+    switch (status) {
+        case STEG_FILE_ERROR:
+            return "File I/O operation failed";
+        case STEG_INVALID_BMP:
+            return "Invalid or unsupported image";
+        case STEG_INSUFFICIENT_CAPACITY:
+            return "Image too small to hold the message";
+        case STEG_MEMORY_ERROR:
+            return "Memory allocation failed";
+        case STEG_INVALID_ARGUMENT:
+            return "Invalid request";
+        case STEG_NO_PAYLOAD_HEADER:
+            return "No hidden message found in image";
+        default:
+            return "Unknown error occurred";
+    }
+}
+
+// Send every byte, retrying short writes; a client that hung up yields
+// an error rather than SIGPIPE
+static int send_all(int fd, const void* data, size_t length) {
+    const char* p = data;
+    
+    while (length > 0) {
+        ssize_t written = send(fd, p, length, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return STEG_FILE_ERROR;
+        }
+        p += written;
+        length -= (size_t)written;
+    }
+    return STEG_SUCCESS;
+}
+
+// Send a complete response with a short text body; extra holds further
+// header lines, each ending in CRLF
+static void send_status(connection_t* conn, int code, const char* reason, const char* extra, const char* text) {
+    char buffer[1024];
+    
+    int length = snprintf(buffer, sizeof(buffer),
+                          "HTTP/1.1 %d %s\r\n"
+                          "Content-Type: text/plain; charset=utf-8\r\n"
+                          "Content-Length: %zu\r\n"
+                          "%s"
+                          "Connection: close\r\n\r\n%s",
+                          code, reason, strlen(text), extra ? extra : "", text);
+    conn->code = code;
+    if (length > 0 && (size_t)length < sizeof(buffer)) {
+        send_all(conn->fd, buffer, (size_t)length);
+    }
+}
+
+// Send one server-sent event whose data is a formatted line
+static int send_event(connection_t* conn, const char* event, const char* format, ...) {
+    char buffer[512];
+    va_list args;
+    
+    int length = snprintf(buffer, sizeof(buffer), "event: %s\ndata: ", event);
+    va_start(args, format);
+    length += vsnprintf(buffer + length, sizeof(buffer) - (size_t)length, format, args);
+    va_end(args);
+    if ((size_t)length + 2 >= sizeof(buffer)) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    memcpy(buffer + length, "\n\n", 2);
+    return send_all(conn->fd, buffer, (size_t)length + 2);
+}
+
+// Report done of total bytes, once per percent
+static int send_progress(connection_t* conn, const char* stage, size_t done, size_t total, int* last_percent) {
+    int percent = total ? (int)((double)done * 100 / (double)total) : 100;
+    
+    if (percent == *last_percent) {
+        return STEG_SUCCESS;
+    }
+    *last_percent = percent;
+    return send_event(conn, "progress", "{\"stage\":\"%s\",\"done\":%zu,\"total\":%zu}", stage, done, total);
+}
+
+// Encode length bytes as Base64; out needs 4 bytes per 3 of input
+static size_t base64_encode(const unsigned char* in, size_t length, char* out) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    size_t i = 0;
+    
+    for (; i + 2 < length; i += 3) {
+        uint32_t v = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+        out[o++] = alphabet[v >> 18];
+        out[o++] = alphabet[(v >> 12) & 63];
+        out[o++] = alphabet[(v >> 6) & 63];
+        out[o++] = alphabet[v & 63];
+    }
+    if (i < length) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < length) {
+            v |= (uint32_t)in[i + 1] << 8;
+        }
+        out[o++] = alphabet[v >> 18];
+        out[o++] = alphabet[(v >> 12) & 63];
+        out[o++] = i + 1 < length ? alphabet[(v >> 6) & 63] : '=';
+        out[o++] = '=';
+    }
+    return o;
+}
+
+// Stream the result as data events, with download progress between them
+static int send_data(connection_t* conn, const unsigned char* data, size_t length) {
+    static const char prefix[] = "event: data\ndata: ";
+    char* buffer = malloc(sizeof(prefix) + (HTTP_DATA_CHUNK / 3) * 4 + 2);
+    int last_percent = -1;
+    int result = buffer ? STEG_SUCCESS : STEG_MEMORY_ERROR;
+    
+    for (size_t done = 0; result == STEG_SUCCESS && done < length; ) {
+        size_t slice = length - done < HTTP_DATA_CHUNK ? length - done : HTTP_DATA_CHUNK;
+        size_t used = sizeof(prefix) - 1;
+        
+        memcpy(buffer, prefix, used);
+        used += base64_encode(data + done, slice, buffer + used);
+        buffer[used++] = '\n';
+        buffer[used++] = '\n';
+        result = send_all(conn->fd, buffer, used);
+        done += slice;
+        if (result == STEG_SUCCESS) {
+            result = send_progress(conn, "download", done, length, &last_percent);
+        }
+    }
+    
+    free(buffer);
+    return result;
+}
+
+// Append bytes to a growing buffer, keeping room for a terminating NUL
+static int append_bytes(unsigned char** buffer, size_t* size, size_t* capacity,
+                        const unsigned char* data, size_t length) {
+    if (*size + length + 1 > *capacity) {
+        size_t wanted = *capacity ? *capacity * 2 : 4096;
+        while (wanted < *size + length + 1) {
+            wanted *= 2;
+        }
+        unsigned char* grown = realloc(*buffer, wanted);
+        if (!grown) {
+            return STEG_MEMORY_ERROR;
+        }
+        *buffer = grown;
+        *capacity = wanted;
+    }
+    
+    // part_begin passes no data just to allocate the buffer
+    if (length > 0) {
+        memcpy(*buffer + *size, data, length);
+    }
+    *size += length;
+    (*buffer)[*size] = '\0';
+    return STEG_SUCCESS;
+}
+
+// Multipart callback: a form field begins
+static int part_begin(void* ctx, const char* name, const char* filename) {
+    job_t* job = ctx;
+    
+    job->part = PART_OTHER;
+    if (strcmp(name, "image") == 0) {
+        if (job->image) {
+            return STEG_INVALID_ARGUMENT;
+        }
+        
+        // The image is never bigger than the upload, so it is read into
+        // one buffer without growing it
+        job->image_capacity = job->upload_size + 1;
+        job->image = malloc(job->image_capacity);
+        if (!job->image) {
+            return STEG_MEMORY_ERROR;
+        }
+        snprintf(job->filename, sizeof(job->filename), "%s", filename);
+        job->part = PART_IMAGE;
+    } else if (strcmp(name, "message") == 0) {
+        if (job->payload) {
+            return STEG_INVALID_ARGUMENT;
+        }
+        job->part = PART_MESSAGE;
+        return append_bytes(&job->payload, &job->payload_size, &job->payload_capacity, NULL, 0);
+    }
+    return STEG_SUCCESS;
+}
+
+// Multipart callback: more bytes of the current field
+static int part_data(void* ctx, const unsigned char* data, size_t length) {
+    job_t* job = ctx;
+    
+    if (job->part == PART_IMAGE) {
+        return append_bytes(&job->image, &job->image_size, &job->image_capacity, data, length);
+    }
+    if (job->part == PART_MESSAGE) {
+        return append_bytes(&job->payload, &job->payload_size, &job->payload_capacity, data, length);
+    }
+    return STEG_SUCCESS;
+}
+
+// Multipart callback: the current field is complete
+static int part_end(void* ctx) {
+    job_t* job = ctx;
+    
+    job->part = PART_OTHER;
+    return STEG_SUCCESS;
+}
+
+// Run a BMP operation on the in-memory engine
+static int serve_bmp(job_t* job) {
+    switch (job->op) {
+        case OP_CAPACITY: {
+            steg_bmp_layout_t layout;
+            int result = steg_bmp_parse_layout(job->image, job->image_size, job->image_size, &layout);
+            if (result == STEG_SUCCESS) {
+                job->capacity = steg_capacity_for(steg_bmp_pixel_bytes(&layout));
+            }
+            return result;
+        }
+        case OP_EMBED:
+            // Embed in place in the upload buffer
+            job->data = job->image;
+            job->data_length = job->image_size;
+            return embed_payload_buffer(job->payload, job->payload_size, job->image, job->image_size);
+        default: {
+            // A payload never exceeds half the pixel bytes (4 bits per byte)
+            size_t max_len = job->image_size / 2 + 1;
+            size_t length = 0;
+            unsigned char* buffer = malloc(max_len);
+            if (!buffer) {
+                return STEG_MEMORY_ERROR;
+            }
+            int result = extract_payload_buffer(buffer, max_len, &length, job->image, job->image_size);
+            if (result != STEG_SUCCESS) {
+                free(buffer);
+                return result;
+            }
+            job->data = buffer;
+            job->data_length = length;
+            return STEG_SUCCESS;
+        }
+    }
+}
+
+// Run a PNG or JPEG operation through its handler's buffer entry points
+static int serve_handler(job_t* job) {
+    format_handler_t* handler = job->handler;
+    const char* message = job->payload ? (const char*)job->payload : "";
+    
+    if (!handler->validate_buffer(job->image, job->image_size)) {
+        return STEG_INVALID_BMP;
+    }
+    long capacity = handler->get_capacity_buffer(job->image, job->image_size);
+    if (capacity < 0) {
+        return STEG_INVALID_BMP;
+    }
+    
+    switch (job->op) {
+        case OP_CAPACITY:
+            job->capacity = (uint64_t)capacity;
+            return STEG_SUCCESS;
+        case OP_EMBED: {
+            // The handlers take text: the message ends at its first NUL
+            if (memchr(message, '\0', job->payload_size)) {
+                return STEG_INVALID_ARGUMENT;
+            }
+            if (job->payload_size > (size_t)capacity) {
+                return STEG_INSUFFICIENT_CAPACITY;
+            }
+            
+            // In place in the upload buffer: the stego image is never larger
+            size_t stego_size = 0;
+            int result = handler->embed_buffer(job->image, job->image_size, message, job->image,
+                                               job->image_size, &stego_size);
+            if (result == STEG_SUCCESS) {
+                job->data = job->image;
+                job->data_length = stego_size;
+            }
+            return result;
+        }
+        default: {
+            char* extracted = NULL;
+            size_t length = 0;
+            int result = format_extract_alloc(handler, job->image, job->image_size, &extracted, &length);
+            if (result == STEG_SUCCESS) {
+                job->data = (unsigned char*)extracted;
+                job->data_length = length;
+            }
+            return result;
+        }
+    }
+}
+
+// Worker task: run one operation and wake its connection
+static void serve_job(void* arg, size_t index) {
+    job_t* job = arg;
+    
+    (void)index;
+    
+    job->status = job->handler == &bmp_handler ? serve_bmp(job) : serve_handler(job);
+    
+    pthread_mutex_lock(&job->lock);
+    job->done = 1;
+    pthread_cond_signal(&job->finished);
+    pthread_mutex_unlock(&job->lock);
+}
+
+// Hand an operation to the pool and wait for it
+static void run_job(server_t* server, job_t* job) {
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->finished, NULL);
+    
+    if (steg_thread_pool_submit(server->pool, serve_job, job) != STEG_SUCCESS) {
+        serve_job(job, 0);
+    }
+    
+    pthread_mutex_lock(&job->lock);
+    while (!job->done) {
+        pthread_cond_wait(&job->finished, &job->lock);
+    }
+    pthread_mutex_unlock(&job->lock);
+    
+    pthread_cond_destroy(&job->finished);
+    pthread_mutex_destroy(&job->lock);
+}
+
+// Read the rest of the upload into the multipart parser, reporting
+// progress as it comes in
+static int receive_upload(connection_t* conn, steg_multipart_t* parser) {
+    size_t total = (size_t)conn->content_length;
+    size_t received = conn->head_length - conn->body_start;
+    int last_percent = -1;
+    
+    // Body bytes that came in with the headers; anything past the
+    // declared length is not part of this request
+    if (received > total) {
+        received = total;
+    }
+    int result = steg_multipart_feed(parser, (const unsigned char*)conn->head + conn->body_start, received);
+    if (result == STEG_SUCCESS) {
+        result = send_progress(conn, "upload", received, total, &last_percent);
+    }
+    if (result != STEG_SUCCESS || received == total) {
+        return result;
+    }
+    
+    unsigned char* buffer = malloc(HTTP_READ_CHUNK);
+    if (!buffer) {
+        return STEG_MEMORY_ERROR;
+    }
+    
+    while (result == STEG_SUCCESS && received < total) {
+        size_t wanted = total - received < HTTP_READ_CHUNK ? total - received : HTTP_READ_CHUNK;
+        ssize_t got = recv(conn->fd, buffer, wanted, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            result = STEG_FILE_ERROR;
+            break;
+        }
+        
+        received += (size_t)got;
+        result = steg_multipart_feed(parser, buffer, (size_t)got);
+        if (result == STEG_SUCCESS) {
+            result = send_progress(conn, "upload", received, total, &last_percent);
+        }
+    }
+    
+    free(buffer);
+    return result;
+}
+
+// Answer POST /api/<op>: take the upload, run the operation on the
+// pool and stream the result
+static void serve_operation(connection_t* conn, int op) {
+    static const char stream_head[] = "HTTP/1.1 200 OK\r\n"
+                                      "Content-Type: text/event-stream\r\n"
+                                      "Cache-Control: no-store\r\n"
+                                      "Connection: close\r\n\r\n";
+    static const steg_multipart_callbacks_t callbacks = { part_begin, part_data, part_end };
+    server_t* server = conn->server;
+    steg_multipart_t parser;
+    const char* failure = NULL;
+    job_t job;
+    
+    if (conn->chunked || conn->content_length < 0) {
+        send_status(conn, 411, "Length Required", NULL, "Uploads need a Content-Length\n");
+        return;
+    }
+    if ((unsigned long long)conn->content_length > server->max_upload) {
+        send_status(conn, 413, "Payload Too Large", NULL, "Upload exceeds the server's limit\n");
+        return;
+    }
+    
+    memset(&job, 0, sizeof(job));
+    job.op = op;
+    job.upload_size = (size_t)conn->content_length;
+    if (steg_multipart_init(&parser, conn->content_type, &callbacks, &job) != STEG_SUCCESS) {
+        send_status(conn, 400, "Bad Request", NULL, "Expected a multipart/form-data upload\n");
+        return;
+    }
+    
+    // From here on the answer is an event stream; it starts before the
+    // upload is read so the upload's progress can go out while it arrives
+    if (conn->expect_continue && send_all(conn->fd, "HTTP/1.1 100 Continue\r\n\r\n", 25) != STEG_SUCCESS) {
+        return;
+    }
+    conn->code = 200;
+    if (send_all(conn->fd, stream_head, sizeof(stream_head) - 1) != STEG_SUCCESS) {
+        return;
+    }
+    
+    int result = receive_upload(conn, &parser);
+    if (result == STEG_SUCCESS) {
+        result = steg_multipart_finish(&parser);
+    }
+    if (result == STEG_SUCCESS && !job.image) {
+        result = STEG_INVALID_ARGUMENT;
+        failure = "No image in the upload";
+    }
+    // The upload's own bytes name its format; the file name is only a hint
+    if (result == STEG_SUCCESS &&
+        !(job.handler = sniff_format_handler(job.image, job.image_size < FORMAT_SNIFF_SIZE ?
+                                                        job.image_size : FORMAT_SNIFF_SIZE)) &&
+        !(job.handler = get_format_handler(job.filename))) {
+        result = STEG_INVALID_ARGUMENT;
+        failure = "Unsupported image format";
+    }
+    if (result == STEG_SUCCESS && op == OP_EMBED && !job.payload) {
+        result = STEG_INVALID_ARGUMENT;
+        failure = "No message to embed";
+    }
+    
+    if (result == STEG_SUCCESS) {
+        send_event(conn, "progress", "{\"stage\":\"%s\"}", op_names[op]);
+        run_job(server, &job);
+        result = job.status;
+    }
+    
+    if (result != STEG_SUCCESS) {
+        send_event(conn, "error", "{\"status\":%d,\"message\":\"%s\"}", result,
+                   failure ? failure : error_text(result));
+    } else if (op == OP_CAPACITY) {
+        send_event(conn, "result", "{\"status\":0,\"format\":\"%s\",\"capacity\":%llu}", job.handler->name,
+                   (unsigned long long)job.capacity);
+    } else if (send_event(conn, "result", "{\"status\":0,\"format\":\"%s\",\"length\":%zu}", job.handler->name,
+                          job.data_length) == STEG_SUCCESS) {
+        result = send_data(conn, job.data, job.data_length);
+    }
+    if (result == STEG_SUCCESS) {
+        send_event(conn, "done", "{}");
+    }
+    
+    pthread_mutex_lock(&server->lock);
+    server->served++;
+    pthread_mutex_unlock(&server->lock);
+    
+    if (job.data != job.image) {
+        free(job.data);
+    }
+    free(job.image);
+    free(job.payload);
+}
+
+// Content-Type of a static file, from its extension
+static const char* content_type_for(const char* path) {
+    static const char* types[][2] = {
+        { ".html", "text/html; charset=utf-8" },
+        { ".css", "text/css" },
+        { ".js", "text/javascript" },
+        { ".md", "text/plain; charset=utf-8" },
+        { ".bmp", "image/bmp" },
+        { ".png", "image/png" },
+        { ".jpg", "image/jpeg" },
+        { ".jpeg", "image/jpeg" }
+    };
+    const char* dot = strrchr(path, '.');
+    
+    for (size_t i = 0; dot && i < sizeof(types) / sizeof(types[0]); i++) {
+        if (strcasecmp(dot, types[i][0]) == 0) {
+            return types[i][1];
+        }
+    }
+    return "application/octet-stream";
+}
+
+// Whether a request path names a file GET may serve: plain paths inside
+// one of the served directories, with no dotfiles, escapes or backslashes
+static int path_is_servable(const char* path) {
+    int inside = 0;
+    
+    for (size_t i = 0; i < sizeof(served_dirs) / sizeof(served_dirs[0]); i++) {
+        if (strncmp(path, served_dirs[i], strlen(served_dirs[i])) == 0) {
+            inside = 1;
+        }
+    }
+    if (!inside || strstr(path, "/.") || strchr(path, '%') || strchr(path, '\\')) {
+        return 0;
+    }
+    return 1;
+}
+
+// Answer GET with a file from the served directories, copied to the
+// socket by the kernel
+static void serve_file(connection_t* conn) {
+    server_t* server = conn->server;
+    char full_path[4096];
+    char head[512];
+    struct stat st;
+    
+    if (!path_is_servable(conn->path) ||
+        (size_t)snprintf(full_path, sizeof(full_path), "%s%s", server->root, conn->path) >= sizeof(full_path)) {
+        send_status(conn, 404, "Not Found", NULL, "Not found\n");
+        return;
+    }
+    
+    int fd = open(full_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        send_status(conn, 404, "Not Found", NULL, "Not found\n");
+        return;
+    }
+    
+    int length = snprintf(head, sizeof(head),
+                          "HTTP/1.1 200 OK\r\n"
+                          "Content-Type: %s\r\n"
+                          "Content-Length: %lld\r\n"
+                          "Cache-Control: no-cache\r\n"
+                          "Connection: close\r\n\r\n",
+                          content_type_for(conn->path), (long long)st.st_size);
+    conn->code = 200;
+    if (send_all(conn->fd, head, (size_t)length) == STEG_SUCCESS) {
+        off_t offset = 0;
+        while (offset < st.st_size) {
+            ssize_t sent = sendfile(conn->fd, fd, &offset, (size_t)(st.st_size - offset));
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                break;
+            }
+        }
+    }
+    close(fd);
+}
+
+// Read up to the end of the request headers; body bytes read along with
+// them stay in the buffer
+static int read_head(connection_t* conn) {
+    while (conn->head_length < HTTP_MAX_HEAD) {
+        ssize_t got = recv(conn->fd, conn->head + conn->head_length, HTTP_MAX_HEAD - conn->head_length, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return STEG_FILE_ERROR;
+        }
+        conn->head_length += (size_t)got;
+        conn->head[conn->head_length] = '\0';
+        
+        // The headers hold no NUL, so strstr finds their end before any
+        // binary body bytes
+        char* end = strstr(conn->head, "\r\n\r\n");
+        if (end) {
+            conn->body_start = (size_t)(end + 4 - conn->head);
+            return STEG_SUCCESS;
+        }
+    }
+    return STEG_INVALID_ARGUMENT;
+}
+
+// Split the request line and pick out the headers the server acts on
+static int parse_head(connection_t* conn) {
+    char version[16];
+    char* line = strstr(conn->head, "\r\n");
+    char* end = conn->head + conn->body_start - 2;
+    
+    conn->content_length = -1;
+    *line = '\0';
+    if (sscanf(conn->head, "%7s %1023s %15s", conn->method, conn->path, version) != 3 ||
+        strncmp(version, "HTTP/1.", 7) != 0 || conn->path[0] != '/') {
+        return STEG_INVALID_ARGUMENT;
+    }
+    
+    // The query string plays no part in routing
+    char* query = strchr(conn->path, '?');
+    if (query) {
+        *query = '\0';
+    }
+    
+    for (line += 2; line < end; ) {
+        char* next = strstr(line, "\r\n");
+        *next = '\0';
+        
+        char* value = strchr(line, ':');
+        if (value) {
+            *value++ = '\0';
+            value += strspn(value, " \t");
+            if (strcasecmp(line, "Content-Length") == 0) {
+                char* digits_end;
+                errno = 0;
+                conn->content_length = strtoll(value, &digits_end, 10);
+                if (errno != 0 || digits_end == value || conn->content_length < 0) {
+                    return STEG_INVALID_ARGUMENT;
+                }
+            } else if (strcasecmp(line, "Content-Type") == 0) {
+                snprintf(conn->content_type, sizeof(conn->content_type), "%s", value);
+            } else if (strcasecmp(line, "Transfer-Encoding") == 0) {
+                conn->chunked = 1;
+            } else if (strcasecmp(line, "Expect") == 0) {
+                conn->expect_continue = strcasecmp(value, "100-continue") == 0;
+            }
+        }
+        line = next + 2;
+    }
+    return STEG_SUCCESS;
+}
+
+// Route a parsed request
+static void handle_request(connection_t* conn) {
+    int is_get = strcmp(conn->method, "GET") == 0;
+    int is_post = strcmp(conn->method, "POST") == 0;
+    
+    if (is_post && strcmp(conn->path, "/api/embed") == 0) {
+        serve_operation(conn, OP_EMBED);
+    } else if (is_post && strcmp(conn->path, "/api/extract") == 0) {
+        serve_operation(conn, OP_EXTRACT);
+    } else if (is_post && strcmp(conn->path, "/api/capacity") == 0) {
+        serve_operation(conn, OP_CAPACITY);
+    } else if (strncmp(conn->path, "/api/", 5) == 0) {
+        send_status(conn, is_post ? 404 : 405, is_post ? "Not Found" : "Method Not Allowed",
+                    is_post ? NULL : "Allow: POST\r\n", "Unknown operation\n");
+    } else if (!is_get) {
+        send_status(conn, 405, "Method Not Allowed", "Allow: GET\r\n", "Method not allowed\n");
+    } else if (strcmp(conn->path, "/") == 0) {
+        send_status(conn, 302, "Found", "Location: " HTTP_INDEX "\r\n", "See " HTTP_INDEX "\n");
+    } else {
+        serve_file(conn);
+    }
+}
+
+// Connection thread: answer one request, then close
+static void* connection_main(void* arg) {
+    connection_t* conn = arg;
+    server_t* server = conn->server;
+    char discard[4096];
+    
+    if (read_head(conn) == STEG_SUCCESS) {
+        if (parse_head(conn) == STEG_SUCCESS) {
+            handle_request(conn);
+        } else {
+            send_status(conn, 400, "Bad Request", NULL, "Malformed request\n");
+        }
+    } else if (conn->head_length >= HTTP_MAX_HEAD) {
+        send_status(conn, 431, "Request Header Fields Too Large", NULL, "Request headers too large\n");
+    }
+    
+    if (server->verbose && conn->code) {
+        fprintf(stderr, "steg_http: %s %s: %d\n", conn->method[0] ? conn->method : "-",
+                conn->path[0] ? conn->path : "-", conn->code);
+    }
+    
+    // Take whatever the client still sends before closing, so an upload
+    // refused part way does not turn into a reset that loses the answer
+    shutdown(conn->fd, SHUT_WR);
+    while (recv(conn->fd, discard, sizeof(discard), 0) > 0) {
+    }
+    close(conn->fd);
+    free(conn);
+    
+    pthread_mutex_lock(&server->lock);
+    server->active--;
+    pthread_cond_signal(&server->idle);
+    pthread_mutex_unlock(&server->lock);
+    return NULL;
+}
+
+// Accept one connection and start its thread
+static void accept_connection(server_t* server) {
+    static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\n"
+                               "Content-Length: 0\r\n"
+                               "Connection: close\r\n\r\n";
+    struct timeval timeout = { HTTP_IO_TIMEOUT, 0 };
+    pthread_attr_t attributes;
+    pthread_t thread;
+    
+    int fd = accept4(server->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    
+    connection_t* conn = NULL;
+    pthread_mutex_lock(&server->lock);
+    if (server->active < HTTP_MAX_CONNECTIONS && (conn = calloc(1, sizeof(*conn))) != NULL) {
+        server->active++;
+    }
+    pthread_mutex_unlock(&server->lock);
+    if (!conn) {
+        send_all(fd, busy, sizeof(busy) - 1);
+        close(fd);
+        return;
+    }
+    conn->fd = fd;
+    conn->server = server;
+    
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attributes, connection_main, conn) != 0) {
+        send_all(fd, busy, sizeof(busy) - 1);
+        close(fd);
+        free(conn);
+        pthread_mutex_lock(&server->lock);
+        server->active--;
+        pthread_mutex_unlock(&server->lock);
+    }
+    pthread_attr_destroy(&attributes);
+}
+
+// Listen on address:port over TCP
+static int open_listener(const char* address, int port) {
+    struct sockaddr_in local;
+    int on = 1;
+    
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, address, &local.sin_addr) != 1) {
+        fprintf(stderr, "Error: Invalid address %s\n", address);
+        return -1;
+    }
+    
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    if (bind(fd, (struct sockaddr*)&local, sizeof(local)) != 0 || listen(fd, LISTEN_BACKLOG) != 0) {
+        perror(address);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Accept connections until SIGINT or SIGTERM
+static void run_loop(server_t* server) {
+    struct pollfd fds[2] = {
+        { server->listen_fd, POLLIN, 0 },
+        { server->signal_fd, POLLIN, 0 }
+    };
+    
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            accept_connection(server);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* address = HTTP_DEFAULT_ADDRESS;
+    server_t server;
+    long port = HTTP_DEFAULT_PORT;
+    long workers = 0;
+    sigset_t signals;
+    
+    static struct option long_options[] = {
+        {"address", required_argument, 0, 'a'},
+        {"port", required_argument, 0, 'p'},
+        {"root", required_argument, 0, 'r'},
+        {"threads", required_argument, 0, 't'},
+        {"max-upload", required_argument, 0, 'M'},
+        {"bits", required_argument, 0, 'B'},
+        {"verbose", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    
+    memset(&server, 0, sizeof(server));
+    server.root = ".";
+    server.max_upload = HTTP_DEFAULT_MAX_UPLOAD;
+    
+    int c;
+    while ((c = getopt_long(argc, argv, "a:p:r:t:vh", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'a':
+                address = optarg;
+                break;
+            case 'p': {
+                char* end;
+                port = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || port < 1 || port > 65535) {
+                    fprintf(stderr, "Error: Port must be between 1 and 65535\n");
+                    return 1;
+                }
+                break;
+            }
+            case 'r':
+                server.root = optarg;
+                break;
+            case 't': {
+                char* end;
+                workers = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || workers < 0 || workers >= STEG_MAX_THREADS) {
+                    fprintf(stderr, "Error: Threads must be between 0 and %d\n", STEG_MAX_THREADS - 1);
+                    return 1;
+                }
+                break;
+            }
+            case 'M': {
+                char* end;
+                long mib = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || mib < 1 || (unsigned long)mib > SIZE_MAX / (1024 * 1024)) {
+                    fprintf(stderr, "Error: Invalid upload limit: %s\n", optarg);
+                    return 1;
+                }
+                server.max_upload = (size_t)mib * 1024 * 1024;
+                break;
+            }
+            case 'B':
+                if (steg_set_bits_per_channel(atoi(optarg)) != STEG_SUCCESS) {
+                    fprintf(stderr, "Error: Bits per channel must be between 1 and 4\n");
+                    return 1;
+                }
+                break;
+            case 'v':
+                server.verbose = 1;
+                break;
+            case 'h':
+                print_help();
+                return 0;
+            default:
+                print_help();
+                return 1;
+        }
+    }
+    
+    // Connection threads only submit to the pool, as its outside
+    // submitter; the workers come on top of that slot
+    steg_set_threads((int)workers);
+    workers = steg_get_threads();
+    if (workers >= STEG_MAX_THREADS) {
+        workers = STEG_MAX_THREADS - 1;
+    }
+    steg_set_threads((int)workers + 1);
+    
+    // Signals arrive through the loop, never on a worker or connection
+    // thread, so block them before any thread starts
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    
+    server.pool = steg_thread_pool_shared();
+    if (!server.pool) {
+        fprintf(stderr, "Error: Could not start the worker threads\n");
+        return 1;
+    }
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.idle, NULL);
+    
+    server.listen_fd = open_listener(address, (int)port);
+    server.signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+    if (server.listen_fd < 0 || server.signal_fd < 0) {
+        fprintf(stderr, "Error: Could not start listening\n");
+        return 1;
+    }
+    
+    printf("steg_http: serving %s on http://%s:%ld/ with %ld workers (%s)\n", server.root, address, port,
+           workers, get_supported_formats());
+    fflush(stdout);
+    
+    run_loop(&server);
+    
+    // Stop accepting, then let the connections in flight finish
+    close(server.listen_fd);
+    pthread_mutex_lock(&server.lock);
+    while (server.active > 0) {
+        pthread_cond_wait(&server.idle, &server.lock);
+    }
+    pthread_mutex_unlock(&server.lock);
+    close(server.signal_fd);
+    pthread_cond_destroy(&server.idle);
+    pthread_mutex_destroy(&server.lock);
+    
+    printf("steg_http: served %llu requests\n", server.served);
+    return 0;
+}
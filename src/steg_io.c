@@ -0,0 +1,602 @@
+/**
+ * @file steg_io.c
+ * @brief LSB Steganography Tool - I/O Helpers
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * Kernel-side passthrough copies for image data that the embedding
+ * engine does not modify, and the mmap/pread backends for BMP images.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/steg_io.h"
+#include "../include/steg.h"
+#include "../include/steg_bmp.h"
+#include "../include/steg_kernels.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
+
+// Method used by the last passthrough copy on this thread
+static __thread int last_copy_method = 0;
+
+// Selected BMP I/O backend and mmap options
+static int io_backend = STEG_IO_STDIO;
+static int mmap_populate = 0;
+
+// Copy remaining bytes through a user-space buffer
+static int copy_buffered(FILE* input, FILE* output) {
+    size_t block_size = steg_get_block_size();
+    unsigned char* block = malloc(block_size);
+    if (!block) {
+        return STEG_MEMORY_ERROR;
+    }
+    
+    size_t bytes_read;
+    int result = STEG_SUCCESS;
+    
+    while ((bytes_read = fread(block, 1, block_size, input)) > 0) {
+        if (fwrite(block, 1, bytes_read, output) != bytes_read) {
+            result = STEG_FILE_ERROR;
+            break;
+        }
+    }
+    
+    if (ferror(input)) {
+        result = STEG_FILE_ERROR;
+    }
+    
+    free(block);
+    last_copy_method = STEG_COPY_BUFFERED;
+    return result;
+}
+
+#ifdef __linux__
+// Copy [offset, offset + count) from in_fd to out_fd inside the kernel.
+// Returns the number of bytes copied, or -1 if neither syscall is usable.
+static off_t copy_in_kernel(int in_fd, int out_fd, off_t offset, off_t count) {
+    off_t copied = 0;
+    int use_sendfile = 0;
+    
+    while (copied < count) {
+        size_t chunk = (size_t)(count - copied);
+        ssize_t n;
+        
+        if (!use_sendfile) {
+            loff_t in_off = offset + copied;
+            n = copy_file_range(in_fd, &in_off, out_fd, NULL, chunk, 0);
+            if (n < 0 && copied == 0 &&
+                (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+                 errno == EOPNOTSUPP || errno == EBADF)) {
+                use_sendfile = 1;
+                continue;
+            }
+        } else {
+            off_t in_off = offset + copied;
+            n = sendfile(out_fd, in_fd, &in_off, chunk);
+            if (n < 0 && copied == 0 && (errno == EINVAL || errno == ENOSYS)) {
+                return -1;
+            }
+        }
+        
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return copied > 0 ? copied : -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        copied += n;
+    }
+    
+    last_copy_method = use_sendfile ? STEG_COPY_SENDFILE : STEG_COPY_RANGE;
+    return copied;
+}
+#endif
+
+// Copy the rest of the input stream to the output stream
+int steg_copy_remaining(FILE* input, FILE* output) {
+    if (!input || !output) {
+        return STEG_FILE_ERROR;
+    }
+    
+#ifdef __linux__
+    struct stat in_stat;
+    int in_fd = fileno(input);
+    int out_fd = fileno(output);
+    long offset = ftell(input);
+    
+    if (offset >= 0 && fflush(output) == 0 &&
+        fstat(in_fd, &in_stat) == 0 && S_ISREG(in_stat.st_mode)) {
+        off_t count = in_stat.st_size - offset;
+        if (count <= 0) {
+            return STEG_SUCCESS;
+        }
+        
+        off_t copied = copy_in_kernel(in_fd, out_fd, offset, count);
+        if (copied >= 0) {
+            // Resynchronise both streams with their file descriptors
+            fseek(input, offset + copied, SEEK_SET);
+            if (lseek(out_fd, 0, SEEK_CUR) >= 0) {
+                fseek(output, 0, SEEK_END);
+            }
+            if (copied < count) {
+                return copy_buffered(input, output);
+            }
+            return STEG_SUCCESS;
+        }
+    }
+#endif
+    
+    return copy_buffered(input, output);
+}
+
+// Copy part of one file to the current position of another
+int steg_copy_range(int in_fd, int out_fd, off_t offset, off_t count) {
+    off_t copied = 0;
+    
+#ifdef __linux__
+    copied = copy_in_kernel(in_fd, out_fd, offset, count);
+    if (copied < 0) {
+        copied = 0;
+    }
+#endif
+    if (copied == count) {
+        return STEG_SUCCESS;
+    }
+    
+    // Finish through a user-space buffer
+    size_t block_size = steg_get_block_size();
+    unsigned char* block = malloc(block_size);
+    if (!block) {
+        return STEG_MEMORY_ERROR;
+    }
+    
+    int result = STEG_SUCCESS;
+    while (copied < count && result == STEG_SUCCESS) {
+        size_t chunk = (size_t)(count - copied) < block_size ? (size_t)(count - copied) : block_size;
+        ssize_t n = steg_pread_all(in_fd, block, chunk, offset + copied);
+        if (n <= 0) {
+            result = STEG_FILE_ERROR;
+            break;
+        }
+        for (ssize_t done = 0; done < n && result == STEG_SUCCESS;) {
+            ssize_t written = write(out_fd, block + done, (size_t)(n - done));
+            if (written < 0 && errno != EINTR) {
+                result = STEG_FILE_ERROR;
+            } else if (written > 0) {
+                done += written;
+            }
+        }
+        copied += n;
+    }
+    
+    free(block);
+    last_copy_method = STEG_COPY_BUFFERED;
+    return result;
+}
+
+// Get the method used by the last copy or clone
+int steg_last_copy_method(void) {
+    return last_copy_method;
+}
+
+// Create dst as a copy of src, sharing extents where possible
+int steg_clone_file(const char* src, const char* dst) {
+    if (!src || !dst) {
+        return STEG_FILE_ERROR;
+    }
+    
+    struct stat src_stat;
+    struct stat dst_stat;
+    int src_fd = open(src, O_RDONLY);
+    if (src_fd < 0 || fstat(src_fd, &src_stat) != 0) {
+        if (src_fd >= 0) close(src_fd);
+        return STEG_FILE_ERROR;
+    }
+    
+    // Open without truncating so that src == dst is detected first
+    int dst_fd = open(dst, O_WRONLY | O_CREAT, src_stat.st_mode & 0777);
+    if (dst_fd < 0 || fstat(dst_fd, &dst_stat) != 0) {
+        if (dst_fd >= 0) close(dst_fd);
+        close(src_fd);
+        return STEG_FILE_ERROR;
+    }
+    
+    if (src_stat.st_dev == dst_stat.st_dev && src_stat.st_ino == dst_stat.st_ino) {
+        close(dst_fd);
+        close(src_fd);
+        return STEG_SUCCESS;
+    }
+    
+    int result = STEG_FILE_ERROR;
+    if (ftruncate(dst_fd, 0) == 0) {
+#ifdef __linux__
+        if (ioctl(dst_fd, FICLONE, src_fd) == 0) {
+            last_copy_method = STEG_COPY_REFLINK;
+            result = STEG_SUCCESS;
+        } else if (copy_in_kernel(src_fd, dst_fd, 0, src_stat.st_size) == src_stat.st_size) {
+            result = STEG_SUCCESS;
+        }
+#endif
+        if (result != STEG_SUCCESS) {
+            // Portable fallback: start over with stdio streams
+            FILE* input = fdopen(src_fd, "rb");
+            FILE* output = input ? fdopen(dst_fd, "wb") : NULL;
+            if (input && output && ftruncate(dst_fd, 0) == 0 &&
+                lseek(dst_fd, 0, SEEK_SET) == 0 && fseek(input, 0, SEEK_SET) == 0) {
+                result = copy_buffered(input, output);
+            }
+            if (output && fclose(output) != 0) {
+                result = STEG_FILE_ERROR;
+            } else if (!output) {
+                close(dst_fd);
+            }
+            if (input) {
+                fclose(input);
+            } else {
+                close(src_fd);
+            }
+            return result;
+        }
+    }
+    
+    close(dst_fd);
+    close(src_fd);
+    return result;
+}
+
+// Get a printable name for a copy method
+const char* steg_copy_method_name(int method) {
+    switch (method) {
+        case STEG_COPY_RANGE:
+            return "copy_file_range";
+        case STEG_COPY_SENDFILE:
+            return "sendfile";
+        case STEG_COPY_BUFFERED:
+            return "buffered copy";
+        case STEG_COPY_REFLINK:
+            return "reflink";
+        default:
+            return "none";
+    }
+}
+
+// Select the I/O backend used by the BMP handler
+int steg_set_io_backend(int backend) {
+    if (backend != STEG_IO_STDIO && backend != STEG_IO_MMAP && backend != STEG_IO_PREAD) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    io_backend = backend;
+    return STEG_SUCCESS;
+}
+
+// Get the I/O backend used by the BMP handler
+int steg_get_io_backend(void) {
+    return io_backend;
+}
+
+// Look up an I/O backend by name
+int steg_parse_io_backend(const char* name) {
+    if (!name) return -1;
+    if (strcmp(name, "stdio") == 0) return STEG_IO_STDIO;
+    if (strcmp(name, "mmap") == 0) return STEG_IO_MMAP;
+    if (strcmp(name, "pread") == 0) return STEG_IO_PREAD;
+    return -1;
+}
+
+// Get a printable name for an I/O backend
+const char* steg_io_backend_name(int backend) {
+    switch (backend) {
+        case STEG_IO_STDIO:
+            return "stdio";
+        case STEG_IO_MMAP:
+            return "mmap";
+        case STEG_IO_PREAD:
+            return "pread";
+        default:
+            return "unknown";
+    }
+}
+
+// Prefault mappings made by the mmap backend
+void steg_set_mmap_populate(int enabled) {
+    mmap_populate = enabled;
+}
+
+// Write all of data to fd at offset
+int steg_pwrite_all(int fd, const unsigned char* data, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t n = pwrite(fd, data, size, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return STEG_FILE_ERROR;
+        }
+        data += n;
+        size -= (size_t)n;
+        offset += n;
+    }
+    return STEG_SUCCESS;
+}
+
+// Read all of size bytes from fd at offset; returns bytes read or -1
+ssize_t steg_pread_all(int fd, unsigned char* data, size_t size, off_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, data + done, size - done, offset + (off_t)done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        done += (size_t)n;
+    }
+    return (ssize_t)done;
+}
+
+// Map the whole input file; writable mappings are private copy-on-write
+static unsigned char* map_input(FILE* input, size_t* size, int writable) {
+    struct stat in_stat;
+    int fd = fileno(input);
+    
+    if (fstat(fd, &in_stat) != 0 || !S_ISREG(in_stat.st_mode) || in_stat.st_size <= 0) {
+        return NULL;
+    }
+    
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (mmap_populate) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void* map = mmap(NULL, (size_t)in_stat.st_size, prot, flags, fd, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    
+    madvise(map, (size_t)in_stat.st_size, MADV_SEQUENTIAL);
+    *size = (size_t)in_stat.st_size;
+    return map;
+}
+
+// Embed a binary payload with the selected I/O backend
+int embed_payload_io(const unsigned char* payload, size_t length, FILE* input, FILE* output) {
+    if (!payload || !input || !output) {
+        return STEG_FILE_ERROR;
+    }
+    
+    switch (steg_get_io_backend()) {
+        case STEG_IO_MMAP:
+            return embed_payload_mmap(payload, length, input, output);
+        case STEG_IO_PREAD:
+            return embed_payload_pread(payload, length, input, output);
+        default:
+            rewind(input);
+            return embed_payload(payload, length, input, output);
+    }
+}
+
+// Embed a binary payload into a BMP image using a memory mapping
+int embed_payload_mmap(const unsigned char* payload, size_t length, FILE* input, FILE* output) {
+    if (!payload || !input || !output) {
+        return STEG_FILE_ERROR;
+    }
+    
+    size_t size;
+    unsigned char* image = map_input(input, &size, 1);
+    if (!image) {
+        return STEG_FILE_ERROR;
+    }
+    
+    int result = embed_payload_buffer(payload, length, image, size);
+    
+    // Write the output straight from the (partially copied) mapping
+    if (result == STEG_SUCCESS) {
+        int out_fd = fileno(output);
+        long out_offset = fflush(output) == 0 ? ftell(output) : -1;
+        
+        if (out_offset < 0) {
+            result = STEG_FILE_ERROR;
+        } else {
+            result = steg_pwrite_all(out_fd, image, size, out_offset);
+            fseek(output, out_offset + (long)size, SEEK_SET);
+        }
+    }
+    
+    munmap(image, size);
+    return result;
+}
+
+// Embed a message into a BMP image using a memory mapping
+int embed_message_mmap(const char* message, FILE* input, FILE* output) {
+    if (!message) {
+        return STEG_FILE_ERROR;
+    }
+    return embed_payload_mmap((const unsigned char*)message, strlen(message), input, output);
+}
+
+// Extract a hidden message from a memory-mapped BMP image
+int extract_message_mmap(char* buffer, size_t max_len, FILE* input) {
+    steg_bmp_layout_t layout;
+    steg_strips_t strips;
+    
+    if (!buffer || !input || max_len == 0) {
+        return STEG_FILE_ERROR;
+    }
+    
+    size_t size;
+    unsigned char* image = map_input(input, &size, 0);
+    if (!image) {
+        return STEG_FILE_ERROR;
+    }
+    
+    size_t length = 0;
+    int result = steg_bmp_parse_layout(image, size, size, &layout);
+    if (result == STEG_SUCCESS) {
+        result = steg_strips_open_memory(&strips, &layout, image, steg_get_block_size());
+        if (result == STEG_SUCCESS) {
+            result = steg_extract_strips(&strips, (unsigned char*)buffer, NULL, max_len - 1, &length);
+            
+            // Leave the stream after the last pixel row that was decoded
+            fseek(input, steg_strips_end_offset(&strips), SEEK_SET);
+        }
+        steg_strips_close(&strips);
+    }
+    
+    // Ensure null termination
+    buffer[length] = '\0';
+    
+    munmap(image, size);
+    return result;
+}
+
+// Copy [offset, end of file) from in_fd to out_fd with pread()/pwrite()
+static int copy_range_pread(int in_fd, int out_fd, off_t offset, off_t out_base, off_t* end) {
+    size_t block_size = steg_get_block_size();
+    unsigned char* block = malloc(block_size);
+    if (!block) {
+        return STEG_MEMORY_ERROR;
+    }
+    
+    int result = STEG_SUCCESS;
+    while (result == STEG_SUCCESS) {
+        ssize_t n = steg_pread_all(in_fd, block, block_size, offset);
+        if (n < 0) {
+            result = STEG_FILE_ERROR;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        result = steg_pwrite_all(out_fd, block, (size_t)n, out_base + offset);
+        offset += n;
+    }
+    
+    free(block);
+    *end = offset;
+    return result;
+}
+
+// Parse the pixel layout of a descriptor with positional reads
+static int read_layout_fd(int fd, steg_bmp_layout_t* layout) {
+    unsigned char header[BMP_LAYOUT_HEADER_SIZE];
+    struct stat in_stat;
+    
+    // Parse the headers and channel masks from a single positional read
+    if (fstat(fd, &in_stat) != 0) {
+        return STEG_FILE_ERROR;
+    }
+    ssize_t got = steg_pread_all(fd, header, BMP_LAYOUT_HEADER_SIZE, 0);
+    if (got < BMP_HEADER_SIZE) {
+        return STEG_FILE_ERROR;
+    }
+    
+    return steg_bmp_parse_layout(header, (size_t)got, (uint64_t)in_stat.st_size, layout);
+}
+
+// Embed a binary payload into a BMP image with pread()/pwrite()
+int embed_payload_pread(const unsigned char* payload, size_t length, FILE* input, FILE* output) {
+    steg_bmp_layout_t layout;
+    steg_strips_t strips;
+    
+    if (!payload || !input || !output) {
+        return STEG_FILE_ERROR;
+    }
+    
+    int in_fd = fileno(input);
+    int out_fd = fileno(output);
+    
+    int validation_result = read_layout_fd(in_fd, &layout);
+    if (validation_result != STEG_SUCCESS) {
+        return validation_result;
+    }
+    
+    if (length > steg_capacity_for(steg_bmp_pixel_bytes(&layout))) {
+        return STEG_INSUFFICIENT_CAPACITY;
+    }
+    
+    long out_base = fflush(output) == 0 ? ftell(output) : -1;
+    if (out_base < 0) {
+        return STEG_FILE_ERROR;
+    }
+    
+    // Headers (and anything else before the pixel array) go out unchanged,
+    // then only the rows carrying the payload, then the rest of the file
+    off_t end = 0;
+    int result = steg_strips_open_fd(&strips, &layout, in_fd, out_fd, out_base, steg_get_block_size());
+    if (result == STEG_SUCCESS) {
+        unsigned char* head = malloc(layout.data_offset);
+        if (!head) {
+            result = STEG_MEMORY_ERROR;
+        } else if (steg_pread_all(in_fd, head, layout.data_offset, 0) != (ssize_t)layout.data_offset) {
+            result = STEG_FILE_ERROR;
+        } else {
+            result = steg_pwrite_all(out_fd, head, layout.data_offset, out_base);
+        }
+        free(head);
+    }
+    if (result == STEG_SUCCESS) {
+        result = steg_embed_strips(&strips, payload, NULL, length, NULL);
+    }
+    if (result == STEG_SUCCESS) {
+        result = copy_range_pread(in_fd, out_fd, steg_strips_end_offset(&strips), out_base, &end);
+    }
+    steg_strips_close(&strips);
+    
+    fseek(output, out_base + (long)end, SEEK_SET);
+    return result;
+}
+
+// Embed a message into a BMP image with pread()/pwrite()
+int embed_message_pread(const char* message, FILE* input, FILE* output) {
+    if (!message) {
+        return STEG_FILE_ERROR;
+    }
+    return embed_payload_pread((const unsigned char*)message, strlen(message), input, output);
+}
+
+// Extract a hidden message from a BMP image with pread()
+int extract_message_pread(char* buffer, size_t max_len, FILE* input) {
+    steg_bmp_layout_t layout;
+    steg_strips_t strips;
+    
+    if (!buffer || !input || max_len == 0) {
+        return STEG_FILE_ERROR;
+    }
+    
+    int in_fd = fileno(input);
+    
+    int validation_result = read_layout_fd(in_fd, &layout);
+    if (validation_result != STEG_SUCCESS) {
+        return validation_result;
+    }
+    
+    size_t length = 0;
+    int result = steg_strips_open_fd(&strips, &layout, in_fd, -1, 0, steg_get_block_size());
+    if (result == STEG_SUCCESS) {
+        result = steg_extract_strips(&strips, (unsigned char*)buffer, NULL, max_len - 1, &length);
+        
+        // Leave the stream after the last pixel row that was read
+        fseek(input, steg_strips_end_offset(&strips), SEEK_SET);
+    }
+    steg_strips_close(&strips);
+    
+    // Ensure null termination
+    buffer[length] = '\0';
+    
+    return result;
+}
@@ -0,0 +1,634 @@
+/**
+ * @file steg_kernels.c
+ * @brief LSB Steganography Tool - Bit Embedding Kernels
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ * 
+ * LSB embed/extract kernels shared by every I/O backend. The scalar
+ * kernels are the reference implementation; on x86 the SSE2, AVX2 and
+ * AVX-512 kernels move several payload bytes per step. The widest
+ * kernel the CPU supports is selected at startup and can be forced
+ * with the STEG_KERNEL environment variable.
+ */
+
+#include "../include/steg_kernels.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define STEG_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+// SCALAR KERNELS
+// ============================================================================
+
+// LSB embed kernel: spread each payload byte over 8 pixel bytes, MSB first
+void lsb_embed_block_scalar(unsigned char* pixels, const unsigned char* payload, size_t payload_len) {
+    for (size_t i = 0; i < payload_len; i++) {
+        unsigned char current_char = payload[i];
+        unsigned char* p = pixels + i * 8;
+        
+        for (int bit_pos = 7; bit_pos >= 0; bit_pos--) {
+            // Modify LSB: pixel_byte = (pixel_byte & 0xFE) | bit
+            *p = (*p & 0xFE) | ((current_char >> bit_pos) & 1);
+            p++;
+        }
+    }
+}
+
+// Portable search for the first NUL byte; returns len if there is none
+static size_t find_nul_scalar(const unsigned char* data, size_t len) {
+    const unsigned char* nul = memchr(data, 0, len);
+    return nul ? (size_t)(nul - data) : len;
+}
+
+// LSB extract kernel: rebuild payload bytes from 8 pixel bytes each, MSB first
+void lsb_extract_block_scalar(const unsigned char* pixels, unsigned char* payload, size_t payload_len) {
+    for (size_t i = 0; i < payload_len; i++) {
+        const unsigned char* p = pixels + i * 8;
+        unsigned char extracted_char = 0;
+        
+        for (int bit_pos = 0; bit_pos < 8; bit_pos++) {
+            extracted_char = (extracted_char << 1) | (p[bit_pos] & 1);
+        }
+        payload[i] = extracted_char;
+    }
+}
+
+// Pack 4-byte pixels into their 3 colour channels, dropping byte skip
+void lsb_pack_channels_scalar(const unsigned char* pixels, unsigned char* channels, size_t count, int skip) {
+    for (size_t i = 0; i < count; i++) {
+        for (int b = 0; b < 4; b++) {
+            if (b != skip) {
+                *channels++ = pixels[i * 4 + (size_t)b];
+            }
+        }
+    }
+}
+
+// Write 3 colour channels back into 4-byte pixels, leaving byte skip alone
+void lsb_unpack_channels_scalar(const unsigned char* channels, unsigned char* pixels, size_t count, int skip) {
+    for (size_t i = 0; i < count; i++) {
+        for (int b = 0; b < 4; b++) {
+            if (b != skip) {
+                pixels[i * 4 + (size_t)b] = *channels++;
+            }
+        }
+    }
+}
+
+// ============================================================================
+// MULTI-BIT DEPTH KERNELS
+// ============================================================================
+
+// N payload bytes (8 * N bits) fill exactly 8 pixel bytes at N bits each.
+// Each depth gets its own instantiation so the shifts and masks are
+// compile-time constants and the inner loop fully unrolls.
+#define DEFINE_DEPTH_KERNELS(N)                                                     \
+static void lsb_embed_groups_##N(unsigned char* pixels, const unsigned char* payload, \
+                                 size_t groups) {                                   \
+    const unsigned char mask = (1u << (N)) - 1;                                     \
+    for (size_t g = 0; g < groups; g++) {                                           \
+        const unsigned char* in = payload + g * (N);                                \
+        unsigned char* p = pixels + g * 8;                                          \
+        uint32_t bits = 0;                                                          \
+        for (int b = 0; b < (N); b++) {                                             \
+            bits = (bits << 8) | in[b];                                             \
+        }                                                                           \
+        for (int k = 0; k < 8; k++) {                                               \
+            unsigned char value = (bits >> ((7 - k) * (N))) & mask;                 \
+            p[k] = (p[k] & (unsigned char)~mask) | value;                           \
+        }                                                                           \
+    }                                                                               \
+}                                                                                   \
+static void lsb_extract_groups_##N(const unsigned char* pixels, unsigned char* payload, \
+                                   size_t groups) {                                 \
+    const unsigned char mask = (1u << (N)) - 1;                                     \
+    for (size_t g = 0; g < groups; g++) {                                           \
+        const unsigned char* p = pixels + g * 8;                                    \
+        unsigned char* out = payload + g * (N);                                     \
+        uint32_t bits = 0;                                                          \
+        for (int k = 0; k < 8; k++) {                                               \
+            bits = (bits << (N)) | (p[k] & mask);                                   \
+        }                                                                           \
+        for (int b = (N) - 1; b >= 0; b--) {                                        \
+            out[b] = (unsigned char)bits;                                           \
+            bits >>= 8;                                                             \
+        }                                                                           \
+    }                                                                               \
+}
+
+DEFINE_DEPTH_KERNELS(2)
+DEFINE_DEPTH_KERNELS(3)
+DEFINE_DEPTH_KERNELS(4)
+
+typedef void (*groups_embed_func)(unsigned char*, const unsigned char*, size_t);
+typedef void (*groups_extract_func)(const unsigned char*, unsigned char*, size_t);
+
+// Depth kernels indexed by bits per channel (1 uses the SIMD dispatch)
+static const groups_embed_func depth_embed[LSB_MAX_BITS + 1] = {
+    NULL, NULL, lsb_embed_groups_2, lsb_embed_groups_3, lsb_embed_groups_4
+};
+static const groups_extract_func depth_extract[LSB_MAX_BITS + 1] = {
+    NULL, NULL, lsb_extract_groups_2, lsb_extract_groups_3, lsb_extract_groups_4
+};
+
+// ============================================================================
+// x86 SIMD KERNELS
+// ============================================================================
+
+#ifdef STEG_X86_KERNELS
+
+// SSE2 embed: 2 payload bytes -> 16 pixel bytes per step.
+// Each payload byte is broadcast over 8 lanes, ANDed with the per-lane
+// bit mask 0x80..0x01 and compared back to the mask, giving 0xFF for
+// set bits; the low bit of that is merged into the pixel LSBs.
+__attribute__((target("sse2")))
+void lsb_embed_block_sse2(unsigned char* pixels, const unsigned char* payload, size_t payload_len) {
+    const __m128i bit_mask = _mm_set_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80,
+                                          0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char)0x80);
+    const __m128i keep = _mm_set1_epi8((char)0xFE);
+    const __m128i one = _mm_set1_epi8(1);
+    size_t i = 0;
+    
+    for (; i + 2 <= payload_len; i += 2) {
+        __m128i bytes = _mm_unpacklo_epi64(_mm_set1_epi8((char)payload[i]),
+                                           _mm_set1_epi8((char)payload[i + 1]));
+        __m128i bits = _mm_cmpeq_epi8(_mm_and_si128(bytes, bit_mask), bit_mask);
+        __m128i* p = (__m128i*)(pixels + i * 8);
+        __m128i px = _mm_loadu_si128(p);
+        px = _mm_or_si128(_mm_and_si128(px, keep), _mm_and_si128(bits, one));
+        _mm_storeu_si128(p, px);
+    }
+    
+    lsb_embed_block_scalar(pixels + i * 8, payload + i, payload_len - i);
+}
+
+// AVX2 embed: 4 payload bytes -> 32 pixel bytes per step.
+// The 4 bytes are broadcast as a 32-bit word and vpshufb fans each one
+// out over 8 lanes before the same mask/compare/merge as SSE2.
+__attribute__((target("avx2")))
+void lsb_embed_block_avx2(unsigned char* pixels, const unsigned char* payload, size_t payload_len) {
+    const __m256i bit_mask = _mm256_set1_epi64x((long long)0x0102040810204080ULL);
+    const __m256i fan_out = _mm256_set_epi8(3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2,
+                                            1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i keep = _mm256_set1_epi8((char)0xFE);
+    const __m256i one = _mm256_set1_epi8(1);
+    size_t i = 0;
+    
+    for (; i + 4 <= payload_len; i += 4) {
+        int word;
+        memcpy(&word, payload + i, sizeof(word));
+        __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32(word), fan_out);
+        __m256i bits = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bit_mask), bit_mask);
+        __m256i* p = (__m256i*)(pixels + i * 8);
+        __m256i px = _mm256_loadu_si256(p);
+        px = _mm256_or_si256(_mm256_and_si256(px, keep), _mm256_and_si256(bits, one));
+        _mm256_storeu_si256(p, px);
+    }
+    
+    lsb_embed_block_sse2(pixels + i * 8, payload + i, payload_len - i);
+}
+
+// Bit-reversal table: movemask yields pixel 0 in bit 0, payload wants it in bit 7
+static const unsigned char reverse_bits[256] = {
+#define R2(n) n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define R4(n) R2(n), R2(n + 2 * 16), R2(n + 1 * 16), R2(n + 3 * 16)
+#define R6(n) R4(n), R4(n + 2 * 4), R4(n + 1 * 4), R4(n + 3 * 4)
+    R6(0), R6(2), R6(1), R6(3)
+#undef R6
+#undef R4
+#undef R2
+};
+
+// SSE2 extract: 16 pixel bytes -> 2 payload bytes per step.
+// A 16-bit shift by 7 moves every byte's LSB into its sign bit, pmovmskb
+// gathers the 16 sign bits and a table puts each byte's bits MSB first.
+__attribute__((target("sse2")))
+void lsb_extract_block_sse2(const unsigned char* pixels, unsigned char* payload, size_t payload_len) {
+    size_t i = 0;
+    
+    for (; i + 2 <= payload_len; i += 2) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(pixels + i * 8));
+        int mask = _mm_movemask_epi8(_mm_slli_epi16(px, 7));
+        payload[i] = reverse_bits[mask & 0xFF];
+        payload[i + 1] = reverse_bits[(mask >> 8) & 0xFF];
+    }
+    
+    lsb_extract_block_scalar(pixels + i * 8, payload + i, payload_len - i);
+}
+
+// AVX2 extract: 32 pixel bytes -> 4 payload bytes per step.
+// vpshufb reverses each group of 8 pixels first, so the 32-bit movemask
+// is already the 4 payload bytes in memory order.
+__attribute__((target("avx2")))
+void lsb_extract_block_avx2(const unsigned char* pixels, unsigned char* payload, size_t payload_len) {
+    const __m256i reverse = _mm256_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+                                            8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+    size_t i = 0;
+    
+    for (; i + 4 <= payload_len; i += 4) {
+        __m256i px = _mm256_loadu_si256((const __m256i*)(pixels + i * 8));
+        px = _mm256_shuffle_epi8(_mm256_slli_epi16(px, 7), reverse);
+        unsigned int word = (unsigned int)_mm256_movemask_epi8(px);
+        memcpy(payload + i, &word, sizeof(word));
+    }
+    
+    lsb_extract_block_sse2(pixels + i * 8, payload + i, payload_len - i);
+}
+
+// AVX-512 embed: 8 payload bytes -> 64 pixel bytes per step.
+// vpshufb fans the broadcast 64-bit word out within each 128-bit lane,
+// and the bit test produces a mask register selecting which lanes get
+// their LSB set.
+__attribute__((target("avx512f,avx512bw")))
+void lsb_embed_block_avx512(unsigned char* pixels, const unsigned char* payload, size_t payload_len) {
+    const __m512i bit_mask = _mm512_set1_epi64((long long)0x0102040810204080ULL);
+    const __m512i fan_out = _mm512_set_epi64(0x0707070707070707LL, 0x0606060606060606LL,
+                                             0x0505050505050505LL, 0x0404040404040404LL,
+                                             0x0303030303030303LL, 0x0202020202020202LL,
+                                             0x0101010101010101LL, 0x0000000000000000LL);
+    const __m512i keep = _mm512_set1_epi8((char)0xFE);
+    const __m512i one = _mm512_set1_epi8(1);
+    size_t i = 0;
+    
+    for (; i + 8 <= payload_len; i += 8) {
+        long long word;
+        memcpy(&word, payload + i, sizeof(word));
+        __m512i bytes = _mm512_shuffle_epi8(_mm512_set1_epi64(word), fan_out);
+        __mmask64 bits = _mm512_test_epi8_mask(bytes, bit_mask);
+        void* p = pixels + i * 8;
+        __m512i px = _mm512_and_si512(_mm512_loadu_si512(p), keep);
+        px = _mm512_or_si512(px, _mm512_maskz_mov_epi8(bits, one));
+        _mm512_storeu_si512(p, px);
+    }
+    
+    lsb_embed_block_avx2(pixels + i * 8, payload + i, payload_len - i);
+}
+
+// AVX-512 extract: 64 pixel bytes -> 8 payload bytes per step.
+__attribute__((target("avx512f,avx512bw")))
+void lsb_extract_block_avx512(const unsigned char* pixels, unsigned char* payload, size_t payload_len) {
+    const __m512i reverse = _mm512_set4_epi32(0x08090A0B, 0x0C0D0E0F, 0x00010203, 0x04050607);
+    size_t i = 0;
+    
+    for (; i + 8 <= payload_len; i += 8) {
+        __m512i px = _mm512_loadu_si512(pixels + i * 8);
+        px = _mm512_shuffle_epi8(_mm512_slli_epi16(px, 7), reverse);
+        unsigned long long word = _mm512_movepi8_mask(px);
+        memcpy(payload + i, &word, sizeof(word));
+    }
+    
+    lsb_extract_block_avx2(pixels + i * 8, payload + i, payload_len - i);
+}
+
+// Per-lane vpshufb controls for 4 pixels: pack picks the 3 channel bytes
+// of each pixel into bytes 0-11; unpack moves them back and zeroes the
+// skipped byte. keep has 0xFF in the skipped byte of each pixel.
+static void channel_shuffles(int skip, unsigned char pack[16], unsigned char unpack[16], unsigned char keep[16]) {
+    int out = 0;
+    
+    for (int p = 0; p < 4; p++) {
+        for (int b = 0; b < 4; b++) {
+            int in = p * 4 + b;
+            if (b == skip) {
+                unpack[in] = 0x80;
+                keep[in] = 0xFF;
+            } else {
+                pack[out] = (unsigned char)in;
+                unpack[in] = (unsigned char)out;
+                keep[in] = 0x00;
+                out++;
+            }
+        }
+    }
+    for (; out < 16; out++) {
+        pack[out] = 0x80;
+    }
+}
+
+// AVX2 pack: 8 pixels (32 bytes) -> 24 channel bytes per step.
+// vpshufb compacts each lane to 12 bytes, a dword permute joins the two
+// lanes and a masked store writes exactly 24 bytes.
+__attribute__((target("avx2")))
+void lsb_pack_channels_avx2(const unsigned char* pixels, unsigned char* channels, size_t count, int skip) {
+    unsigned char pack[16], unpack[16], keep[16];
+    channel_shuffles(skip, pack, unpack, keep);
+    
+    const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)pack));
+    const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    const __m256i store_mask = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+    size_t i = 0;
+    
+    for (; i + 8 <= count; i += 8) {
+        __m256i px = _mm256_loadu_si256((const __m256i*)(pixels + i * 4));
+        px = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(px, shuffle), join);
+        _mm256_maskstore_epi32((int*)(channels + i * 3), store_mask, px);
+    }
+    
+    lsb_pack_channels_scalar(pixels + i * 4, channels + i * 3, count - i, skip);
+}
+
+// AVX2 unpack: 24 channel bytes -> 8 pixels per step.
+// The skipped byte is restored from the pixels through a fixed mask.
+__attribute__((target("avx2")))
+void lsb_unpack_channels_avx2(const unsigned char* channels, unsigned char* pixels, size_t count, int skip) {
+    unsigned char pack[16], unpack[16], keep[16];
+    channel_shuffles(skip, pack, unpack, keep);
+    
+    const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)unpack));
+    const __m256i keep_mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)keep));
+    const __m256i split = _mm256_setr_epi32(0, 1, 2, 6, 3, 4, 5, 7);
+    const __m256i load_mask = _mm256_setr_epi32(-1, -1, -1, -1, -1, -1, 0, 0);
+    size_t i = 0;
+    
+    for (; i + 8 <= count; i += 8) {
+        __m256i ch = _mm256_maskload_epi32((const int*)(channels + i * 3), load_mask);
+        ch = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(ch, split), shuffle);
+        void* p = pixels + i * 4;
+        __m256i px = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)p), keep_mask);
+        _mm256_storeu_si256((__m256i*)p, _mm256_or_si256(px, ch));
+    }
+    
+    lsb_unpack_channels_scalar(channels + i * 3, pixels + i * 4, count - i, skip);
+}
+
+// AVX-512 pack: 16 pixels (64 bytes) -> 48 channel bytes per step.
+__attribute__((target("avx512f,avx512bw")))
+void lsb_pack_channels_avx512(const unsigned char* pixels, unsigned char* channels, size_t count, int skip) {
+    unsigned char pack[16], unpack[16], keep[16];
+    channel_shuffles(skip, pack, unpack, keep);
+    
+    const __m512i shuffle = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)pack));
+    const __m512i join = _mm512_setr_epi32(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 3, 7, 11, 15);
+    size_t i = 0;
+    
+    for (; i + 16 <= count; i += 16) {
+        __m512i px = _mm512_loadu_si512(pixels + i * 4);
+        px = _mm512_permutexvar_epi32(join, _mm512_shuffle_epi8(px, shuffle));
+        _mm512_mask_storeu_epi32(channels + i * 3, 0x0FFF, px);
+    }
+    
+    lsb_pack_channels_avx2(pixels + i * 4, channels + i * 3, count - i, skip);
+}
+
+// AVX-512 unpack: 48 channel bytes -> 16 pixels per step.
+// A byte mask register selects the channel bytes, so the skipped byte
+// is never written.
+__attribute__((target("avx512f,avx512bw")))
+void lsb_unpack_channels_avx512(const unsigned char* channels, unsigned char* pixels, size_t count, int skip) {
+    unsigned char pack[16], unpack[16], keep[16];
+    channel_shuffles(skip, pack, unpack, keep);
+    
+    const __m512i shuffle = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)unpack));
+    const __m512i split = _mm512_setr_epi32(0, 1, 2, 12, 3, 4, 5, 13, 6, 7, 8, 14, 9, 10, 11, 15);
+    const __mmask64 channel_mask = ~(0x1111111111111111ULL << skip);
+    size_t i = 0;
+    
+    for (; i + 16 <= count; i += 16) {
+        __m512i ch = _mm512_maskz_loadu_epi32(0x0FFF, channels + i * 3);
+        ch = _mm512_shuffle_epi8(_mm512_permutexvar_epi32(split, ch), shuffle);
+        _mm512_mask_storeu_epi8(pixels + i * 4, channel_mask, ch);
+    }
+    
+    lsb_unpack_channels_avx2(channels + i * 3, pixels + i * 4, count - i, skip);
+}
+
+// SSE2 search for the first NUL byte; returns len if there is none
+__attribute__((target("sse2")))
+static size_t find_nul_sse2(const unsigned char* data, size_t len) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+        if (mask) {
+            return i + (size_t)__builtin_ctz((unsigned int)mask);
+        }
+    }
+    
+    for (; i < len; i++) {
+        if (data[i] == 0) return i;
+    }
+    return len;
+}
+
+// AVX2 search for the first NUL byte. Kept VEX-encoded so the wide
+// kernels never mix in legacy SSE instructions (transition stalls).
+__attribute__((target("avx2")))
+static size_t find_nul_avx2(const unsigned char* data, size_t len) {
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+        if (mask) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    
+    for (; i < len; i++) {
+        if (data[i] == 0) return i;
+    }
+    return len;
+}
+
+#endif // STEG_X86_KERNELS
+
+// ============================================================================
+// RUNTIME DISPATCH
+// ============================================================================
+
+// Kernel table, narrowest first
+static const lsb_kernel_t kernels[] = {
+    { "scalar", lsb_embed_block_scalar, lsb_extract_block_scalar, find_nul_scalar,
+      lsb_pack_channels_scalar, lsb_unpack_channels_scalar },
+#ifdef STEG_X86_KERNELS
+    // SSE2 has no byte shuffle, so 32-bpp packing stays scalar there
+    { "sse2", lsb_embed_block_sse2, lsb_extract_block_sse2, find_nul_sse2,
+      lsb_pack_channels_scalar, lsb_unpack_channels_scalar },
+    { "avx2", lsb_embed_block_avx2, lsb_extract_block_avx2, find_nul_avx2,
+      lsb_pack_channels_avx2, lsb_unpack_channels_avx2 },
+    { "avx512", lsb_embed_block_avx512, lsb_extract_block_avx512, find_nul_avx2,
+      lsb_pack_channels_avx512, lsb_unpack_channels_avx512 },
+#endif
+};
+
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+// Kernel in use; NULL until the first selection
+static const lsb_kernel_t* active_kernel = NULL;
+
+// Check whether the running CPU can execute a kernel
+static int kernel_supported(const lsb_kernel_t* kernel) {
+#ifdef STEG_X86_KERNELS
+    __builtin_cpu_init();
+    if (strcmp(kernel->name, "sse2") == 0) {
+        return __builtin_cpu_supports("sse2");
+    }
+    if (strcmp(kernel->name, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (strcmp(kernel->name, "avx512") == 0) {
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    }
+#endif
+    return strcmp(kernel->name, "scalar") == 0;
+}
+
+// Select a kernel by name
+int lsb_set_kernel(const char* name) {
+    for (size_t i = 0; i < KERNEL_COUNT; i++) {
+        if (name && strcmp(kernels[i].name, name) == 0) {
+            if (!kernel_supported(&kernels[i])) {
+                return -1;
+            }
+            active_kernel = &kernels[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Pick the widest supported kernel, honouring STEG_KERNEL
+static void select_kernel(void) {
+    const char* forced = getenv("STEG_KERNEL");
+    
+    if (forced && *forced) {
+        if (lsb_set_kernel(forced) == 0) {
+            return;
+        }
+        fprintf(stderr, "Warning: STEG_KERNEL=%s is unknown or not supported by this CPU\n", forced);
+    }
+    
+    for (size_t i = KERNEL_COUNT; i > 0; i--) {
+        if (kernel_supported(&kernels[i - 1])) {
+            active_kernel = &kernels[i - 1];
+            return;
+        }
+    }
+}
+
+// Select the kernel once at program startup
+__attribute__((constructor))
+static void init_kernels(void) {
+    if (!active_kernel) {
+        select_kernel();
+    }
+}
+
+// Get the kernel selected for this process
+const lsb_kernel_t* lsb_active_kernel(void) {
+    if (!active_kernel) {
+        select_kernel();
+    }
+    return active_kernel;
+}
+
+// Embed with the selected kernel
+void lsb_embed_block(unsigned char* pixels, const unsigned char* payload, size_t payload_len) {
+    lsb_active_kernel()->embed(pixels, payload, payload_len);
+}
+
+// Extract with the selected kernel
+void lsb_extract_block(const unsigned char* pixels, unsigned char* payload, size_t payload_len) {
+    lsb_active_kernel()->extract(pixels, payload, payload_len);
+}
+
+// Pack 4-byte pixels with the selected kernel
+void lsb_pack_channels(const unsigned char* pixels, unsigned char* channels, size_t count, int skip) {
+    lsb_active_kernel()->pack(pixels, channels, count, skip);
+}
+
+// Unpack into 4-byte pixels with the selected kernel
+void lsb_unpack_channels(const unsigned char* channels, unsigned char* pixels, size_t count, int skip) {
+    lsb_active_kernel()->unpack(channels, pixels, count, skip);
+}
+
+// Pixel bytes needed to carry payload_len bytes at the given depth
+size_t lsb_pixels_for(size_t payload_len, int bits) {
+    return (payload_len * 8 + (size_t)bits - 1) / (size_t)bits;
+}
+
+// Payload bytes that fit completely in pixel_bytes at the given depth
+size_t lsb_payload_for(size_t pixel_bytes, int bits) {
+    return pixel_bytes / 8 * (size_t)bits + (pixel_bytes % 8) * (size_t)bits / 8;
+}
+
+// Embed payload bytes at 1-4 bits per pixel byte
+void lsb_embed(const lsb_kernel_t* kernel, unsigned char* pixels, const unsigned char* payload, size_t payload_len,
+               int bits) {
+    if (bits == 1) {
+        kernel->embed(pixels, payload, payload_len);
+        return;
+    }
+    
+    size_t groups = payload_len / (size_t)bits;
+    depth_embed[bits](pixels, payload, groups);
+    
+    // A trailing partial group goes through a zero-padded scratch group
+    size_t rest = payload_len - groups * (size_t)bits;
+    if (rest > 0) {
+        unsigned char group_payload[LSB_MAX_BITS] = { 0 };
+        unsigned char group_pixels[8];
+        size_t used = lsb_pixels_for(rest, bits);
+        
+        memcpy(group_payload, payload + groups * bits, rest);
+        memcpy(group_pixels, pixels + groups * 8, used);
+        depth_embed[bits](group_pixels, group_payload, 1);
+        memcpy(pixels + groups * 8, group_pixels, used);
+    }
+}
+
+// Extract payload bytes at 1-4 bits per pixel byte
+void lsb_extract(const lsb_kernel_t* kernel, const unsigned char* pixels, unsigned char* payload,
+                 size_t payload_len, int bits) {
+    if (bits == 1) {
+        kernel->extract(pixels, payload, payload_len);
+        return;
+    }
+    
+    size_t groups = payload_len / (size_t)bits;
+    depth_extract[bits](pixels, payload, groups);
+    
+    size_t rest = payload_len - groups * (size_t)bits;
+    if (rest > 0) {
+        unsigned char group_payload[LSB_MAX_BITS];
+        unsigned char group_pixels[8] = { 0 };
+        
+        memcpy(group_pixels, pixels + groups * 8, lsb_pixels_for(rest, bits));
+        depth_extract[bits](group_pixels, group_payload, 1);
+        memcpy(payload + groups * bits, group_payload, rest);
+    }
+}
+
+// Extract a NUL-terminated payload in short steps so it stops early
+size_t lsb_extract_string(const lsb_kernel_t* kernel, const unsigned char* pixels, unsigned char* payload,
+                          size_t payload_len, int bits) {
+    size_t max_step = LSB_STRING_STEP / (size_t)bits * (size_t)bits;  // Whole groups
+    size_t pos = 0;
+    
+    while (pos < payload_len) {
+        size_t step = payload_len - pos;
+        if (step > max_step) {
+            step = max_step;
+        }
+        
+        lsb_extract(kernel, pixels + pos / bits * 8, payload + pos, step, bits);
+        
+        size_t nul = kernel->find_nul(payload + pos, step);
+        if (nul < step) {
+            return pos + nul;
+        }
+        pos += step;
+    }
+    
+    return payload_len;
+}
@@ -0,0 +1,243 @@
+/**
+ * @file steg_multipart.c
+ * @brief LSB Steganography Tool - Streaming multipart/form-data Parser
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * A byte-driven state machine over the body. Part data is scanned for
+ * the CR that starts every delimiter with memchr, so the bulk of an
+ * upload is passed on in runs without a per-byte loop; only the bytes
+ * that might begin a delimiter are held back until it is clear whether
+ * they do.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/steg_multipart.h"
+#include "../include/steg.h"
+#include <ctype.h>
+#include <strings.h>
+
+// Where the parser is in the body
+enum {
+    MULTIPART_PREAMBLE,  // Before the first delimiter
+    MULTIPART_AFTER,     // After a delimiter: CRLF starts a part, "--" ends the body
+    MULTIPART_AFTER_CR,  // Saw the CR of the CRLF
+    MULTIPART_AFTER_DASH,// Saw the first dash of the closing "--"
+    MULTIPART_HEADERS,   // Reading the headers of a part
+    MULTIPART_BODY,      // Reading the data of a part
+    MULTIPART_END        // After the closing delimiter; the epilogue is ignored
+};
+
+// Characters RFC 2046 allows in a boundary
+static int boundary_char(int c) {
+    return isalnum(c) || strchr("'()+_,-./:=? ", c) != NULL;
+}
+
+// Copy the value of parameter key from a header line into out; quoted
+// values lose their quotes
+static void header_parameter(const char* line, const char* key, char* out, size_t out_size) {
+    size_t key_length = strlen(key);
+    const char* p = line;
+    
+    out[0] = '\0';
+    while ((p = strchr(p, ';')) != NULL) {
+        p++;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (strncasecmp(p, key, key_length) != 0 || p[key_length] != '=') {
+            continue;
+        }
+        
+        p += key_length + 1;
+        char end = ';';
+        if (*p == '"') {
+            end = '"';
+            p++;
+        }
+        size_t length = 0;
+        while (p[length] && p[length] != end && p[length] != '\r' && length + 1 < out_size) {
+            length++;
+        }
+        if (end == ';') {
+            while (length > 0 && (p[length - 1] == ' ' || p[length - 1] == '\t')) {
+                length--;
+            }
+        }
+        memcpy(out, p, length);
+        out[length] = '\0';
+        return;
+    }
+}
+
+// Set up a parser for a request body
+int steg_multipart_init(steg_multipart_t* parser, const char* content_type,
+                        const steg_multipart_callbacks_t* callbacks, void* ctx) {
+    char boundary[STEG_MULTIPART_MAX_BOUNDARY + 2];
+    
+    if (!parser || !content_type || !callbacks ||
+        strncasecmp(content_type, "multipart/form-data", 19) != 0) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    
+    // One byte of room past the limit tells an overlong boundary apart
+    header_parameter(content_type, "boundary", boundary, sizeof(boundary));
+    size_t length = strlen(boundary);
+    if (length == 0 || length > STEG_MULTIPART_MAX_BOUNDARY || boundary[length - 1] == ' ') {
+        return STEG_INVALID_ARGUMENT;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (!boundary_char((unsigned char)boundary[i])) {
+            return STEG_INVALID_ARGUMENT;
+        }
+    }
+    
+    memset(parser, 0, sizeof(*parser));
+    parser->callbacks = *callbacks;
+    parser->ctx = ctx;
+    memcpy(parser->delimiter, "\r\n--", 4);
+    memcpy(parser->delimiter + 4, boundary, length);
+    parser->delimiter_length = length + 4;
+    parser->state = MULTIPART_PREAMBLE;
+    
+    // The first delimiter may open the body, without a CRLF before it
+    parser->matched = 2;
+    return STEG_SUCCESS;
+}
+
+// Parse the headers of a part and announce it
+static int begin_part(steg_multipart_t* parser) {
+    char name[STEG_MULTIPART_MAX_NAME];
+    char filename[STEG_MULTIPART_MAX_NAME];
+    char* line = parser->headers;
+    
+    name[0] = '\0';
+    filename[0] = '\0';
+    parser->headers[parser->headers_length] = '\0';
+    
+    while (*line) {
+        char* next = strstr(line, "\r\n");
+        if (next) {
+            *next = '\0';
+        }
+        if (strncasecmp(line, "Content-Disposition:", 20) == 0) {
+            header_parameter(line, "name", name, sizeof(name));
+            header_parameter(line, "filename", filename, sizeof(filename));
+        }
+        if (!next) {
+            break;
+        }
+        line = next + 2;
+    }
+    
+    parser->headers_length = 0;
+    return parser->callbacks.part_begin(parser->ctx, name, filename);
+}
+
+// Feed the next bytes of the body
+int steg_multipart_feed(steg_multipart_t* parser, const unsigned char* data, size_t length) {
+    size_t pos = 0;
+    int result = STEG_SUCCESS;
+    
+    while (pos < length && result == STEG_SUCCESS) {
+        unsigned char c = data[pos];
+        
+        switch (parser->state) {
+            case MULTIPART_PREAMBLE:
+            case MULTIPART_BODY: {
+                int in_body = parser->state == MULTIPART_BODY;
+                
+                // Nothing held back: pass on everything up to the next CR
+                if (parser->matched == 0 && c != '\r') {
+                    const unsigned char* cr = memchr(data + pos, '\r', length - pos);
+                    size_t run = cr ? (size_t)(cr - (data + pos)) : length - pos;
+                    if (run > 0 && in_body) {
+                        result = parser->callbacks.part_data(parser->ctx, data + pos, run);
+                    }
+                    pos += run;
+                    break;
+                }
+                
+                if (c == (unsigned char)parser->delimiter[parser->matched]) {
+                    pos++;
+                    if (++parser->matched == parser->delimiter_length) {
+                        parser->matched = 0;
+                        parser->state = MULTIPART_AFTER;
+                        if (in_body) {
+                            result = parser->callbacks.part_end(parser->ctx);
+                        }
+                    }
+                    break;
+                }
+                
+                // The held-back bytes were data after all. The boundary
+                // has no CR in it, so no delimiter can start inside them;
+                // c itself is looked at again from the start. The virtual
+                // CRLF before the first delimiter is not real data
+                if (in_body) {
+                    result = parser->callbacks.part_data(parser->ctx, (const unsigned char*)parser->delimiter,
+                                                         parser->matched);
+                }
+                parser->matched = 0;
+                break;
+            }
+            case MULTIPART_AFTER:
+                pos++;
+                if (c == '\r') {
+                    parser->state = MULTIPART_AFTER_CR;
+                } else if (c == '-') {
+                    parser->state = MULTIPART_AFTER_DASH;
+                } else if (c != ' ' && c != '\t') {
+                    result = STEG_INVALID_ARGUMENT;
+                }
+                break;
+            case MULTIPART_AFTER_CR:
+                pos++;
+                parser->state = MULTIPART_HEADERS;
+                parser->headers_length = 0;
+                if (c != '\n') {
+                    result = STEG_INVALID_ARGUMENT;
+                }
+                break;
+            case MULTIPART_AFTER_DASH:
+                pos++;
+                parser->state = MULTIPART_END;
+                if (c != '-') {
+                    result = STEG_INVALID_ARGUMENT;
+                }
+                break;
+            case MULTIPART_HEADERS:
+                pos++;
+                
+                // Keep room for the terminating NUL
+                if (parser->headers_length + 1 >= sizeof(parser->headers)) {
+                    result = STEG_INVALID_ARGUMENT;
+                    break;
+                }
+                parser->headers[parser->headers_length++] = (char)c;
+                
+                // A part without headers ends them with its first CRLF
+                if (parser->headers_length == 2 && memcmp(parser->headers, "\r\n", 2) == 0) {
+                    parser->headers_length = 0;
+                } else if (parser->headers_length < 4 ||
+                           memcmp(parser->headers + parser->headers_length - 4, "\r\n\r\n", 4) != 0) {
+                    break;
+                }
+                parser->state = MULTIPART_BODY;
+                parser->matched = 0;
+                result = begin_part(parser);
+                break;
+            default:
+                pos = length;
+                break;
+        }
+    }
+    return result;
+}
+
+// Check that the body ended with its closing boundary
+int steg_multipart_finish(const steg_multipart_t* parser) {
+    return parser->state == MULTIPART_END ? STEG_SUCCESS : STEG_INVALID_ARGUMENT;
+}
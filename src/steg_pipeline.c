@@ -0,0 +1,370 @@
+/**
+ * @file steg_pipeline.c
+ * @brief LSB Steganography Tool - Read/Process/Write Block Pipeline
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * The ring is driven by three counters: blocks read, processed and
+ * written. Block n always lives in slot n % depth, so the reader may
+ * fill a slot once written has caught up to within depth blocks, the
+ * caller processes while processed < read and the writer stores while
+ * written < processed. One mutex and condition variable guard them.
+ *
+ * The reader and writer threads are kept between runs as a crew. A run
+ * takes an idle crew, or starts one when every crew is busy, and
+ * returns it afterwards, so a process makes only as many crews as it
+ * runs pipelines at the same time and no threads are created per run.
+ */
+
+#include "../include/steg_pipeline.h"
+#include "../include/steg.h"
+#include <pthread.h>
+
+// Shared state of one steg_pipeline_run() call
+typedef struct {
+    const steg_pipeline_t* spec;
+    steg_block_t* blocks;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;  // Broadcast whenever a counter or flag moves
+    size_t read;             // Blocks loaded
+    size_t processed;        // Blocks processed
+    size_t written;          // Blocks stored
+    int read_end;            // The read stage has seen the end of the stream
+    int process_end;         // No more blocks will be processed
+    int error;               // First error of any stage
+} pipeline_state_t;
+
+// A reader and a writer thread kept alive between runs
+typedef struct stage_crew {
+    pthread_t reader;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;   // Broadcast when a run is handed over, a stage finishes or on shutdown
+    pipeline_state_t* state;  // Run being served
+    unsigned long runs;       // Runs handed to the crew so far
+    int finished;             // Stages done with the current run
+    int shutdown;
+    struct stage_crew* next;  // Next idle crew
+} stage_crew_t;
+
+// Stage body and the crew it belongs to, for the crew's threads
+typedef struct {
+    stage_crew_t* crew;
+    void* (*body)(void*);
+} stage_start_t;
+
+static pthread_mutex_t crews_lock = PTHREAD_MUTEX_INITIALIZER;
+static stage_crew_t* idle_crews = NULL;
+
+// Record an error and wake every stage so they stop
+static void fail(pipeline_state_t* state, int error) {
+    if (state->error == STEG_SUCCESS) {
+        state->error = error;
+    }
+    pthread_cond_broadcast(&state->changed);
+}
+
+// Reader thread: fill free slots ahead of the caller
+static void* reader_main(void* arg) {
+    pipeline_state_t* state = arg;
+    const steg_pipeline_t* spec = state->spec;
+    
+    pthread_mutex_lock(&state->lock);
+    for (;;) {
+        while (state->error == STEG_SUCCESS && !state->process_end &&
+               state->read - state->written >= spec->depth) {
+            pthread_cond_wait(&state->changed, &state->lock);
+        }
+        if (state->error != STEG_SUCCESS || state->process_end) {
+            break;
+        }
+        
+        steg_block_t* block = &state->blocks[state->read % spec->depth];
+        block->sequence = state->read;
+        block->length = 0;
+        pthread_mutex_unlock(&state->lock);
+        
+        int result = spec->read(spec->ctx, block);
+        
+        pthread_mutex_lock(&state->lock);
+        if (result != STEG_SUCCESS) {
+            fail(state, result);
+            break;
+        }
+        if (block->length == 0) {
+            state->read_end = 1;
+            pthread_cond_broadcast(&state->changed);
+            break;
+        }
+        state->read++;
+        pthread_cond_broadcast(&state->changed);
+    }
+    pthread_mutex_unlock(&state->lock);
+    
+    return NULL;
+}
+
+// Writer thread: store processed blocks in order
+static void* writer_main(void* arg) {
+    pipeline_state_t* state = arg;
+    const steg_pipeline_t* spec = state->spec;
+    
+    pthread_mutex_lock(&state->lock);
+    for (;;) {
+        while (state->error == STEG_SUCCESS && !state->process_end &&
+               state->written == state->processed) {
+            pthread_cond_wait(&state->changed, &state->lock);
+        }
+        if (state->error != STEG_SUCCESS || state->written == state->processed) {
+            break;
+        }
+        
+        steg_block_t* block = &state->blocks[state->written % spec->depth];
+        pthread_mutex_unlock(&state->lock);
+        
+        int result = spec->write(spec->ctx, block);
+        
+        pthread_mutex_lock(&state->lock);
+        if (result != STEG_SUCCESS) {
+            fail(state, result);
+            break;
+        }
+        state->written++;
+        pthread_cond_broadcast(&state->changed);
+    }
+    pthread_mutex_unlock(&state->lock);
+    
+    return NULL;
+}
+
+// Crew thread: run the stage body on every run handed to the crew
+static void* crew_main(void* arg) {
+    stage_start_t start = *(stage_start_t*)arg;
+    stage_crew_t* crew = start.crew;
+    unsigned long served = 0;
+    
+    free(arg);
+    pthread_mutex_lock(&crew->lock);
+    for (;;) {
+        while (!crew->shutdown && crew->runs == served) {
+            pthread_cond_wait(&crew->changed, &crew->lock);
+        }
+        if (crew->shutdown) {
+            break;
+        }
+        served = crew->runs;
+        pipeline_state_t* state = crew->state;
+        pthread_mutex_unlock(&crew->lock);
+        
+        start.body(state);
+        
+        pthread_mutex_lock(&crew->lock);
+        crew->finished++;
+        pthread_cond_broadcast(&crew->changed);
+    }
+    pthread_mutex_unlock(&crew->lock);
+    
+    return NULL;
+}
+
+// Start one thread of a crew
+static int start_crew_thread(stage_crew_t* crew, pthread_t* thread, void* (*body)(void*)) {
+    stage_start_t* start = malloc(sizeof(*start));
+    if (!start) {
+        return 0;
+    }
+    start->crew = crew;
+    start->body = body;
+    if (pthread_create(thread, NULL, crew_main, start) != 0) {
+        free(start);
+        return 0;
+    }
+    return 1;
+}
+
+// Stop a crew's threads and free it
+static void destroy_crew(stage_crew_t* crew, int threads) {
+    pthread_mutex_lock(&crew->lock);
+    crew->shutdown = 1;
+    pthread_cond_broadcast(&crew->changed);
+    pthread_mutex_unlock(&crew->lock);
+    
+    if (threads > 0) {
+        pthread_join(crew->writer, NULL);
+    }
+    if (threads > 1) {
+        pthread_join(crew->reader, NULL);
+    }
+    pthread_cond_destroy(&crew->changed);
+    pthread_mutex_destroy(&crew->lock);
+    free(crew);
+}
+
+// Stop the idle crews at exit
+static void release_crews(void) {
+    pthread_mutex_lock(&crews_lock);
+    while (idle_crews) {
+        stage_crew_t* crew = idle_crews;
+        idle_crews = crew->next;
+        destroy_crew(crew, 2);
+    }
+    pthread_mutex_unlock(&crews_lock);
+}
+
+// Take an idle crew, or start a new one; NULL if its threads cannot start
+static stage_crew_t* acquire_crew(void) {
+    static int registered = 0;
+    
+    pthread_mutex_lock(&crews_lock);
+    stage_crew_t* crew = idle_crews;
+    if (crew) {
+        idle_crews = crew->next;
+    } else if (!registered) {
+        atexit(release_crews);
+        registered = 1;
+    }
+    pthread_mutex_unlock(&crews_lock);
+    if (crew) {
+        return crew;
+    }
+    
+    crew = calloc(1, sizeof(*crew));
+    if (!crew) {
+        return NULL;
+    }
+    pthread_mutex_init(&crew->lock, NULL);
+    pthread_cond_init(&crew->changed, NULL);
+    if (!start_crew_thread(crew, &crew->writer, writer_main)) {
+        destroy_crew(crew, 0);
+        return NULL;
+    }
+    if (!start_crew_thread(crew, &crew->reader, reader_main)) {
+        destroy_crew(crew, 1);
+        return NULL;
+    }
+    return crew;
+}
+
+// Put a crew back on the idle list
+static void release_crew(stage_crew_t* crew) {
+    pthread_mutex_lock(&crews_lock);
+    crew->next = idle_crews;
+    idle_crews = crew;
+    pthread_mutex_unlock(&crews_lock);
+}
+
+// Process blocks on the caller as the reader delivers them
+static void process_blocks(pipeline_state_t* state) {
+    const steg_pipeline_t* spec = state->spec;
+    
+    pthread_mutex_lock(&state->lock);
+    for (;;) {
+        while (state->error == STEG_SUCCESS && !state->read_end &&
+               state->processed == state->read) {
+            pthread_cond_wait(&state->changed, &state->lock);
+        }
+        if (state->error != STEG_SUCCESS || state->processed == state->read) {
+            break;
+        }
+        
+        steg_block_t* block = &state->blocks[state->processed % spec->depth];
+        pthread_mutex_unlock(&state->lock);
+        
+        int result = spec->process(spec->ctx, block);
+        
+        pthread_mutex_lock(&state->lock);
+        if (result != STEG_SUCCESS && result != STEG_PIPELINE_LAST) {
+            fail(state, result);
+            break;
+        }
+        state->processed++;
+        pthread_cond_broadcast(&state->changed);
+        if (result == STEG_PIPELINE_LAST) {
+            break;
+        }
+    }
+    state->process_end = 1;
+    pthread_cond_broadcast(&state->changed);
+    pthread_mutex_unlock(&state->lock);
+}
+
+// Run the stages in turn on the caller, one block at a time
+static int run_serial(const steg_pipeline_t* spec, steg_block_t* block) {
+    for (size_t sequence = 0;; sequence++) {
+        block->sequence = sequence;
+        block->length = 0;
+        
+        int result = spec->read(spec->ctx, block);
+        if (result != STEG_SUCCESS || block->length == 0) {
+            return result;
+        }
+        
+        int processed = spec->process(spec->ctx, block);
+        if (processed != STEG_SUCCESS && processed != STEG_PIPELINE_LAST) {
+            return processed;
+        }
+        
+        result = spec->write(spec->ctx, block);
+        if (result != STEG_SUCCESS || processed == STEG_PIPELINE_LAST) {
+            return result;
+        }
+    }
+}
+
+// Run every block of a stream through the pipeline
+int steg_pipeline_run(const steg_pipeline_t* pipeline) {
+    pipeline_state_t state;
+    size_t depth = pipeline->depth < 2 ? 1 : pipeline->depth;
+    
+    memset(&state, 0, sizeof(state));
+    state.spec = pipeline;
+    state.blocks = calloc(depth, sizeof(steg_block_t));
+    unsigned char* storage = malloc(depth * pipeline->block_size);
+    if (!state.blocks || !storage) {
+        free(state.blocks);
+        free(storage);
+        return STEG_MEMORY_ERROR;
+    }
+    for (size_t i = 0; i < depth; i++) {
+        state.blocks[i].data = storage + i * pipeline->block_size;
+        state.blocks[i].slot = i;
+    }
+    
+    stage_crew_t* crew = depth > 1 ? acquire_crew() : NULL;
+    int result;
+    if (!crew) {
+        result = run_serial(pipeline, &state.blocks[0]);
+    } else {
+        pthread_mutex_init(&state.lock, NULL);
+        pthread_cond_init(&state.changed, NULL);
+        
+        // Hand the run to the crew's reader and writer
+        pthread_mutex_lock(&crew->lock);
+        crew->state = &state;
+        crew->finished = 0;
+        crew->runs++;
+        pthread_cond_broadcast(&crew->changed);
+        pthread_mutex_unlock(&crew->lock);
+        
+        process_blocks(&state);
+        
+        // Both stages stop once processing has ended; wait until they
+        // are done with the state before it goes out of scope
+        pthread_mutex_lock(&crew->lock);
+        while (crew->finished < 2) {
+            pthread_cond_wait(&crew->changed, &crew->lock);
+        }
+        crew->state = NULL;
+        pthread_mutex_unlock(&crew->lock);
+        release_crew(crew);
+        result = state.error;
+        
+        pthread_cond_destroy(&state.changed);
+        pthread_mutex_destroy(&state.lock);
+    }
+    
+    free(storage);
+    free(state.blocks);
+    return result;
+}
@@ -0,0 +1,972 @@
+/**
+ * @file stegd.c
+ * @brief LSB Steganography Tool - stegd Daemon
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * Serves embed, extract and capacity requests over a Unix domain
+ * socket. One thread runs an epoll loop that accepts connections and
+ * reads requests without blocking; each complete request is handed to
+ * the shared work-stealing pool, and the worker passes the finished
+ * response back to the loop through an eventfd. The format handlers
+ * are looked up once at startup.
+ *
+ * BMP requests run on the in-memory engine, which embeds in place in
+ * the request buffer; PNG and JPEG requests go through their handlers
+ * on memory streams. An image passed as a sealed memfd is mapped
+ * rather than read, and a result asked for as a memfd is written into
+ * the memfd's own mapping, so neither crosses the socket. Any other
+ * image fd is read into a private buffer: the client could truncate a
+ * file the daemon had mapped, and the next access would raise SIGBUS.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/stegd.h"
+#include "../include/steg.h"
+#include "../include/steg_bmp.h"
+#include "../include/formats.h"
+#include "../include/thread_pool.h"
+#include "../include/steg_io.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Events taken from epoll per wakeup
+#define MAX_EVENTS 64
+
+// Pending connections queued by the kernel
+#define LISTEN_BACKLOG 128
+
+// Where a connection is in its request/response cycle
+enum {
+    CONN_HEADER,   // Reading a request header
+    CONN_BODY,     // Reading the image and payload
+    CONN_WORKING,  // On the pool; not watched by epoll
+    CONN_RESPONSE  // Sending the response
+};
+
+typedef struct daemon_state daemon_t;
+
+// One client connection
+typedef struct connection {
+    int fd;
+    int state;
+    int close_after;                           // Hang up once the response is out
+    unsigned char header[STEGD_RESPONSE_SIZE]; // Request header in, response header out
+    size_t header_done;                        // Header bytes read or sent
+    stegd_request_t request;
+    int image_fd;                              // Image passed with the header, or -1
+    int image_mapped;                          // The image fd is sealed and mapped, not copied
+    unsigned char* body;                       // Image unless passed as an fd, then payload, then a NUL
+    size_t body_size;
+    size_t body_done;
+    stegd_response_t response;
+    unsigned char* data;                       // Response data; may point into body
+    size_t data_done;
+    int output_fd;                             // memfd sent with the response, or -1
+    unsigned char* output_map;                 // Writable mapping of output_fd while serving
+    daemon_t* daemon;
+    struct connection* prev;                   // Open connections list
+    struct connection* next;
+    struct connection* next_done;              // Completion list of the workers
+} connection_t;
+
+struct daemon_state {
+    int epoll_fd;
+    int listen_fd;
+    int wake_fd;                                // eventfd the workers signal
+    int signal_fd;                              // SIGINT and SIGTERM
+    steg_thread_pool_t* pool;
+    format_handler_t* handlers[STEGD_FORMAT_COUNT];
+    int verbose;
+    pthread_mutex_t lock;
+    connection_t* done;                         // Finished requests, guarded by lock
+    connection_t* connections;                  // Loop thread only from here on
+    size_t working;
+    unsigned long long served;
+};
+
+// Extension looked up in the handler table for each protocol format
+static const char* format_extensions[STEGD_FORMAT_COUNT] = { NULL, ".bmp", ".png", ".jpg" };
+
+// epoll tags of the descriptors that are not connections
+static char listen_tag;
+static char wake_tag;
+static char signal_tag;
+
+static void print_help(void) {
+    printf("LSB Steganography Tool v1.1 - stegd Daemon\n");
+    printf("==========================================\n\n");
+    printf("Usage: %s [OPTIONS]\n\n", "stegd");
+    
+    printf("Options:\n");
+    printf("  -s, --socket <path>      Unix socket to listen on (default: %s)\n", STEGD_DEFAULT_SOCKET);
+    printf("  -t, --threads <n>        Worker threads, 0 for one per CPU (default: 0)\n");
+    printf("      --bits <n>           Payload bits per color channel for BMP embeds,\n");
+    printf("                           1-4 (default: 1)\n");
+    printf("  -v, --verbose            Log every request to stderr\n");
+    printf("  -h, --help               Show this help message\n\n");
+    
+    printf("Examples:\n");
+    printf("  %s -s /run/stegd.sock -t 8\n", "stegd");
+    printf("  steg_cli --daemon /run/stegd.sock -e -m \"Secret\" -i photo.bmp -o secret.bmp\n");
+}
+
+// Watch fd for events, tagged with ptr
+static int watch(daemon_t* daemon, int op, int fd, uint32_t events, void* ptr) {
+    struct epoll_event event;
+    
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.ptr = ptr;
+    return epoll_ctl(daemon->epoll_fd, op, fd, &event);
+}
+
+// Close a connection and free everything it holds
+static void close_connection(connection_t* conn) {
+    daemon_t* daemon = conn->daemon;
+    
+    if (conn->prev) {
+        conn->prev->next = conn->next;
+    } else {
+        daemon->connections = conn->next;
+    }
+    if (conn->next) {
+        conn->next->prev = conn->prev;
+    }
+    
+    close(conn->fd);
+    if (conn->image_fd >= 0) {
+        close(conn->image_fd);
+    }
+    if (conn->output_fd >= 0) {
+        close(conn->output_fd);
+    }
+    if (conn->data != conn->body) {
+        free(conn->data);
+    }
+    free(conn->body);
+    free(conn);
+}
+
+// Writable copy of the image to embed into: the mapping of a new memfd
+// when the client asked for one, a heap buffer otherwise
+static unsigned char* open_output(connection_t* conn, size_t size, const unsigned char* image) {
+    if (!(conn->request.flags & STEGD_FLAG_OUTPUT_FD)) {
+        conn->data = malloc(size);
+        if (conn->data) {
+            memcpy(conn->data, image, size);
+        }
+        return conn->data;
+    }
+    
+    int fd = memfd_create("stegd-output", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return NULL;
+    }
+    
+    // From a mapped image fd the kernel copies the pages, and the mapping
+    // then only faults in the few that the payload touches
+    int filled = conn->image_mapped &&
+                 steg_copy_range(conn->image_fd, fd, 0, (off_t)size) == STEG_SUCCESS;
+    
+    // The client shares the file position; hand the memfd over at its start
+    void* map = MAP_FAILED;
+    if (lseek(fd, 0, SEEK_SET) == 0 && ftruncate(fd, (off_t)size) == 0) {
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    if (!filled) {
+        memcpy(map, image, size);
+    }
+    
+    conn->output_fd = fd;
+    conn->output_map = map;
+    return map;
+}
+
+// Hand the response data over as a sealed memfd, moving it there first
+// when it was produced on the heap
+static int seal_output(connection_t* conn) {
+    size_t length = (size_t)conn->response.data_length;
+    
+    if (conn->output_fd < 0) {
+        int fd = memfd_create("stegd-output", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd < 0) {
+            return STEG_MEMORY_ERROR;
+        }
+        conn->output_fd = fd;
+        if (steg_pwrite_all(fd, conn->data, length, 0) != STEG_SUCCESS) {
+            return STEG_MEMORY_ERROR;
+        }
+        if (conn->data != conn->body) {
+            free(conn->data);
+        }
+        conn->data = NULL;
+    } else {
+        munmap(conn->output_map, length);
+        conn->output_map = NULL;
+    }
+    
+    // The client may map it and trust that it stays as sent
+    if (fcntl(conn->output_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+        return STEG_FILE_ERROR;
+    }
+    conn->response.flags |= STEGD_FLAG_OUTPUT_FD;
+    return STEG_SUCCESS;
+}
+
+// Drop whatever response data a failed request produced
+static void drop_output(connection_t* conn) {
+    if (conn->output_map) {
+        munmap(conn->output_map, (size_t)conn->response.data_length);
+        conn->output_map = NULL;
+    }
+    if (conn->output_fd >= 0) {
+        close(conn->output_fd);
+        conn->output_fd = -1;
+    }
+    if (conn->data != conn->body) {
+        free(conn->data);
+    }
+    conn->data = NULL;
+    conn->response.data_length = 0;
+    conn->response.flags = 0;
+}
+
+// Map an image passed as a file descriptor, or copy it when the client
+// could still resize it; length 0 takes the whole file
+static int map_image(connection_t* conn, uint64_t length, void** map, size_t* size) {
+    struct stat st;
+    int fd = conn->image_fd;
+    
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    if (length > (uint64_t)st.st_size) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    *size = length ? (size_t)length : (size_t)st.st_size;
+    if (*size == 0) {
+        return STEG_INVALID_BMP;
+    }
+    
+    // Only a memfd sealed against shrinking and growing is safe to map
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals >= 0 && (seals & (F_SEAL_SHRINK | F_SEAL_GROW)) == (F_SEAL_SHRINK | F_SEAL_GROW)) {
+        *map = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (*map == MAP_FAILED) {
+            *map = NULL;
+            return STEG_FILE_ERROR;
+        }
+        conn->image_mapped = 1;
+        return STEG_SUCCESS;
+    }
+    
+    *map = malloc(*size);
+    if (!*map) {
+        return STEG_MEMORY_ERROR;
+    }
+    if (steg_pread_all(fd, *map, *size, 0) != (ssize_t)*size) {
+        return STEG_FILE_ERROR;
+    }
+    return STEG_SUCCESS;
+}
+
+// Serve a BMP request on the in-memory engine
+static int serve_bmp(connection_t* conn, const unsigned char* image, size_t image_size,
+                     const unsigned char* payload, size_t payload_size) {
+    stegd_response_t* response = &conn->response;
+    
+    switch (conn->request.op) {
+        case STEGD_OP_CAPACITY: {
+            steg_bmp_layout_t layout;
+            int result = steg_bmp_parse_layout(image, image_size, image_size, &layout);
+            if (result == STEG_SUCCESS) {
+                response->value = steg_capacity_for(steg_bmp_pixel_bytes(&layout));
+            }
+            return result;
+        }
+        case STEGD_OP_EMBED: {
+            // Embed in place in the request buffer, unless the image is a
+            // read-only mapping or the result goes to a memfd
+            unsigned char* output = conn->body;
+            if (conn->request.flags & (STEGD_FLAG_IMAGE_FD | STEGD_FLAG_OUTPUT_FD)) {
+                output = open_output(conn, image_size, image);
+                if (!output) {
+                    return STEG_MEMORY_ERROR;
+                }
+            } else {
+                conn->data = output;
+            }
+            response->data_length = image_size;
+            return embed_payload_buffer(payload, payload_size, output, image_size);
+        }
+        default: {
+            // A payload never exceeds half the pixel bytes (4 bits per byte)
+            size_t max_len = image_size / 2 + 1;
+            size_t length = 0;
+            unsigned char* buffer = malloc(max_len);
+            if (!buffer) {
+                return STEG_MEMORY_ERROR;
+            }
+            int result = extract_payload_buffer(buffer, max_len, &length, image, image_size);
+            if (result != STEG_SUCCESS) {
+                free(buffer);
+                return result;
+            }
+            conn->data = buffer;
+            response->data_length = length;
+            return STEG_SUCCESS;
+        }
+    }
+}
+
+// Serve a PNG or JPEG request through its handler's buffer entry points
+static int serve_handler(connection_t* conn, format_handler_t* handler, const unsigned char* image,
+                         size_t image_size, const char* message, size_t message_size) {
+    stegd_response_t* response = &conn->response;
+    
+    if (!handler->validate_buffer(image, image_size)) {
+        return STEG_INVALID_BMP;
+    }
+    long capacity = handler->get_capacity_buffer(image, image_size);
+    if (capacity < 0) {
+        return STEG_INVALID_BMP;
+    }
+    
+    switch (conn->request.op) {
+        case STEGD_OP_CAPACITY:
+            response->value = (uint64_t)capacity;
+            return STEG_SUCCESS;
+        case STEGD_OP_EMBED: {
+            // The handlers take text: the message ends at its first NUL
+            if (memchr(message, '\0', message_size)) {
+                return STEG_INVALID_ARGUMENT;
+            }
+            if (message_size > (size_t)capacity) {
+                return STEG_INSUFFICIENT_CAPACITY;
+            }
+            
+            // The stego image is never larger than the input, so it is
+            // written in place over the request buffer when that is ours
+            size_t stego_size = 0;
+            int result;
+            if (conn->request.flags & (STEGD_FLAG_IMAGE_FD | STEGD_FLAG_OUTPUT_FD)) {
+                unsigned char* stego = NULL;
+                result = format_embed_alloc(handler, image, image_size, message, &stego, &stego_size);
+                conn->data = stego;
+            } else {
+                result = handler->embed_buffer(image, image_size, message, conn->body, image_size, &stego_size);
+                conn->data = conn->body;
+            }
+            response->data_length = result == STEG_SUCCESS ? stego_size : 0;
+            return result;
+        }
+        default: {
+            char* extracted = NULL;
+            size_t length = 0;
+            int result = format_extract_alloc(handler, image, image_size, &extracted, &length);
+            if (result == STEG_SUCCESS) {
+                conn->data = (unsigned char*)extracted;
+                response->data_length = length;
+            }
+            return result;
+        }
+    }
+}
+
+// Worker task: serve one complete request and hand it back to the loop
+static void serve_request(void* arg, size_t index) {
+    connection_t* conn = arg;
+    daemon_t* daemon = conn->daemon;
+    const stegd_request_t* request = &conn->request;
+    format_handler_t* handler = daemon->handlers[request->format];
+    const unsigned char* image = conn->body;
+    size_t image_size = (size_t)request->image_length;
+    const unsigned char* payload = conn->body + image_size;
+    size_t payload_size = (size_t)request->payload_length;
+    void* map = NULL;
+    uint64_t one = 1;
+    
+    (void)index;
+    
+    memset(&conn->response, 0, sizeof(conn->response));
+    conn->response.op = request->op;
+    conn->data = NULL;
+    
+    int result = STEG_SUCCESS;
+    if (conn->image_fd >= 0) {
+        // Only the payload came through the socket
+        payload = conn->body;
+        result = map_image(conn, request->image_length, &map, &image_size);
+        image = map;
+    }
+    
+    // An image sent without a format is known by its first bytes
+    if (result == STEG_SUCCESS && !handler) {
+        handler = sniff_format_handler(image, image_size < FORMAT_SNIFF_SIZE ? image_size : FORMAT_SNIFF_SIZE);
+        if (!handler) {
+            result = STEG_INVALID_BMP;
+        }
+    }
+    
+    if (result == STEG_SUCCESS && handler == &bmp_handler) {
+        result = serve_bmp(conn, image, image_size, payload, payload_size);
+    } else if (result == STEG_SUCCESS) {
+        result = serve_handler(conn, handler, image, image_size, (const char*)payload, payload_size);
+    }
+    if (result == STEG_SUCCESS && (request->flags & STEGD_FLAG_OUTPUT_FD) &&
+        conn->response.data_length > 0) {
+        result = seal_output(conn);
+    }
+    conn->response.status = result;
+    if (result != STEG_SUCCESS) {
+        drop_output(conn);
+    }
+    
+    if (conn->image_mapped) {
+        munmap(map, image_size);
+    } else {
+        free(map);
+    }
+    if (conn->image_fd >= 0) {
+        close(conn->image_fd);
+        conn->image_fd = -1;
+    }
+    conn->image_mapped = 0;
+    
+    if (daemon->verbose) {
+        fprintf(stderr, "stegd: %s %s, %zu + %zu bytes: %d\n", handler ? handler->name : "unknown",
+                request->op == STEGD_OP_EMBED ? "embed" :
+                request->op == STEGD_OP_EXTRACT ? "extract" : "capacity",
+                image_size, payload_size, conn->response.status);
+    }
+    
+    pthread_mutex_lock(&daemon->lock);
+    conn->next_done = daemon->done;
+    daemon->done = conn;
+    pthread_mutex_unlock(&daemon->lock);
+    
+    // Cannot fail short of 2^64 - 1 pending wakeups
+    ssize_t woken = write(daemon->wake_fd, &one, sizeof(one));
+    (void)woken;
+}
+
+// Send as much of the response as the socket takes; once it is all out,
+// wait for the next request
+static void send_response(connection_t* conn) {
+    daemon_t* daemon = conn->daemon;
+    size_t data_length = conn->output_fd >= 0 ? 0 : (size_t)conn->response.data_length;
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    
+    while (conn->header_done < STEGD_RESPONSE_SIZE || conn->data_done < data_length) {
+        struct iovec vectors[2];
+        struct msghdr message;
+        int count = 0;
+        
+        if (conn->header_done < STEGD_RESPONSE_SIZE) {
+            vectors[count].iov_base = conn->header + conn->header_done;
+            vectors[count].iov_len = STEGD_RESPONSE_SIZE - conn->header_done;
+            count++;
+        }
+        if (conn->data_done < data_length) {
+            vectors[count].iov_base = conn->data + conn->data_done;
+            vectors[count].iov_len = data_length - conn->data_done;
+            count++;
+        }
+        
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = vectors;
+        message.msg_iovlen = count;
+        
+        // The output memfd travels with the first byte of the header
+        if (conn->header_done == 0 && conn->output_fd >= 0) {
+            memset(&control, 0, sizeof(control));
+            message.msg_control = control.buffer;
+            message.msg_controllen = sizeof(control.buffer);
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(cmsg), &conn->output_fd, sizeof(int));
+        }
+        
+        ssize_t sent = sendmsg(conn->fd, &message, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (watch(daemon, EPOLL_CTL_MOD, conn->fd, EPOLLOUT, conn) != 0) {
+                close_connection(conn);
+            }
+            return;
+        }
+        if (sent < 0) {
+            close_connection(conn);
+            return;
+        }
+        
+        size_t header_part = STEGD_RESPONSE_SIZE - conn->header_done;
+        if ((size_t)sent < header_part) {
+            header_part = (size_t)sent;
+        }
+        conn->header_done += header_part;
+        conn->data_done += (size_t)sent - header_part;
+    }
+    
+    daemon->served++;
+    if (conn->close_after) {
+        close_connection(conn);
+        return;
+    }
+    
+    // The client holds its own reference to the memfd now
+    if (conn->output_fd >= 0) {
+        close(conn->output_fd);
+        conn->output_fd = -1;
+    }
+    if (conn->data != conn->body) {
+        free(conn->data);
+    }
+    free(conn->body);
+    conn->data = NULL;
+    conn->body = NULL;
+    conn->state = CONN_HEADER;
+    conn->header_done = 0;
+    if (watch(daemon, EPOLL_CTL_MOD, conn->fd, EPOLLIN, conn) != 0) {
+        close_connection(conn);
+    }
+}
+
+// Encode the response header and start sending it
+static void start_response(connection_t* conn) {
+    stegd_encode_response(&conn->response, conn->header);
+    conn->state = CONN_RESPONSE;
+    conn->header_done = 0;
+    conn->data_done = 0;
+    send_response(conn);
+}
+
+// Answer a request that cannot be served and hang up afterwards; its
+// body, if any, is never read
+static void refuse_request(connection_t* conn, int status) {
+    memset(&conn->response, 0, sizeof(conn->response));
+    conn->response.op = conn->request.op;
+    conn->response.status = status;
+    conn->close_after = 1;
+    start_response(conn);
+}
+
+// Check a request header and make room for its body
+static int accept_header(daemon_t* daemon, connection_t* conn) {
+    stegd_request_t* request = &conn->request;
+    
+    if (stegd_decode_request(conn->header, request) != STEG_SUCCESS ||
+        (request->flags & ~(STEGD_FLAG_IMAGE_FD | STEGD_FLAG_OUTPUT_FD)) != 0 ||
+        request->op < STEGD_OP_EMBED || request->op > STEGD_OP_CAPACITY ||
+        request->format >= STEGD_FORMAT_COUNT ||
+        (request->format != STEGD_FORMAT_AUTO && !daemon->handlers[request->format]) ||
+        (request->op != STEGD_OP_EMBED && request->payload_length != 0)) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    
+    // An image fd must come exactly when the header says so
+    int image_fd = (request->flags & STEGD_FLAG_IMAGE_FD) != 0;
+    if (image_fd != (conn->image_fd >= 0)) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    
+    // Mapped images are not bounded; what crosses the socket is
+    if (!image_fd && request->image_length == 0) {
+        return STEG_INVALID_BMP;
+    }
+    if ((!image_fd && request->image_length > STEGD_DEFAULT_MAX_IMAGE) ||
+        request->payload_length > STEGD_DEFAULT_MAX_IMAGE) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    
+    // Every payload bit needs at least one image byte
+    if (request->image_length != 0 && request->payload_length > request->image_length) {
+        return STEG_INSUFFICIENT_CAPACITY;
+    }
+    
+    conn->body_size = (size_t)request->payload_length + (image_fd ? 0 : (size_t)request->image_length);
+    conn->body_done = 0;
+    conn->body = malloc(conn->body_size + 1);
+    return conn->body ? STEG_SUCCESS : STEG_MEMORY_ERROR;
+}
+
+// Hand a complete request to the pool
+static void dispatch_request(daemon_t* daemon, connection_t* conn) {
+    // NUL-terminate the payload for the text-based handlers
+    conn->body[conn->body_size] = '\0';
+    
+    // Not watched while a worker owns it, so a hangup cannot free it
+    epoll_ctl(daemon->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    conn->state = CONN_WORKING;
+    daemon->working++;
+    if (steg_thread_pool_submit(daemon->pool, serve_request, conn) != STEG_SUCCESS) {
+        serve_request(conn, 0);
+    }
+}
+
+// Receive header bytes, keeping an image fd passed along with them
+static ssize_t receive_header(connection_t* conn, unsigned char* target, size_t wanted) {
+    struct iovec vector = { target, wanted };
+    struct msghdr message;
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+    
+    ssize_t got = recvmsg(conn->fd, &message, MSG_CMSG_CLOEXEC);
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); got >= 0 && cmsg;
+         cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        // Keep the first descriptor, close any others
+        int* fds = (int*)CMSG_DATA(cmsg);
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; i++) {
+            int fd;
+            memcpy(&fd, fds + i, sizeof(int));
+            if (conn->image_fd < 0) {
+                conn->image_fd = fd;
+            } else {
+                close(fd);
+            }
+        }
+    }
+    return got;
+}
+
+// Read whatever has arrived of the current request
+static void read_request(daemon_t* daemon, connection_t* conn) {
+    for (;;) {
+        unsigned char* target;
+        size_t wanted;
+        
+        if (conn->state == CONN_HEADER) {
+            target = conn->header + conn->header_done;
+            wanted = STEGD_REQUEST_SIZE - conn->header_done;
+        } else {
+            target = conn->body + conn->body_done;
+            wanted = conn->body_size - conn->body_done;
+        }
+        
+        ssize_t got = conn->state == CONN_HEADER ? receive_header(conn, target, wanted)
+                                                 : recv(conn->fd, target, wanted, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        if (got <= 0) {
+            // Hung up between requests, or cut one short
+            close_connection(conn);
+            return;
+        }
+        
+        if (conn->state == CONN_HEADER) {
+            conn->header_done += (size_t)got;
+            if (conn->header_done < STEGD_REQUEST_SIZE) {
+                continue;
+            }
+            int result = accept_header(daemon, conn);
+            if (result != STEG_SUCCESS) {
+                refuse_request(conn, result);
+                return;
+            }
+            conn->state = CONN_BODY;
+        } else {
+            conn->body_done += (size_t)got;
+        }
+        
+        if (conn->state == CONN_BODY && conn->body_done == conn->body_size) {
+            dispatch_request(daemon, conn);
+            return;
+        }
+    }
+}
+
+// Accept every pending connection
+static void accept_connections(daemon_t* daemon) {
+    for (;;) {
+        int fd = accept4(daemon->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;
+        }
+        
+        connection_t* conn = calloc(1, sizeof(*conn));
+        if (!conn) {
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+        conn->image_fd = -1;
+        conn->output_fd = -1;
+        conn->daemon = daemon;
+        conn->state = CONN_HEADER;
+        conn->next = daemon->connections;
+        if (conn->next) {
+            conn->next->prev = conn;
+        }
+        daemon->connections = conn;
+        
+        if (watch(daemon, EPOLL_CTL_ADD, fd, EPOLLIN, conn) != 0) {
+            close_connection(conn);
+        }
+    }
+}
+
+// Pick up the requests the workers have finished and answer them
+static void collect_responses(daemon_t* daemon) {
+    uint64_t count;
+    
+    // Reset the eventfd; when nothing was signalled the list is empty
+    ssize_t woken = read(daemon->wake_fd, &count, sizeof(count));
+    (void)woken;
+    
+    pthread_mutex_lock(&daemon->lock);
+    connection_t* done = daemon->done;
+    daemon->done = NULL;
+    pthread_mutex_unlock(&daemon->lock);
+    
+    while (done) {
+        connection_t* conn = done;
+        done = conn->next_done;
+        daemon->working--;
+        
+        if (watch(daemon, EPOLL_CTL_ADD, conn->fd, EPOLLIN, conn) != 0) {
+            close_connection(conn);
+            continue;
+        }
+        start_response(conn);
+    }
+}
+
+// Create, bind and listen on the Unix socket, replacing a stale one
+static int open_socket(const char* path) {
+    struct sockaddr_un address;
+    struct stat st;
+    
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: Socket path too long\n");
+        return -1;
+    }
+    
+    if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = stegd_connect(path);
+        if (probe >= 0) {
+            close(probe);
+            fprintf(stderr, "Error: Another stegd is listening on %s\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(fd, LISTEN_BACKLOG) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Serve until SIGINT or SIGTERM, then finish the requests in flight
+static void run_loop(daemon_t* daemon) {
+    struct epoll_event events[MAX_EVENTS];
+    int stopping = 0;
+    
+    while (!stopping || daemon->working > 0) {
+        int count = epoll_wait(daemon->epoll_fd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+        
+        for (int i = 0; i < count; i++) {
+            void* tag = events[i].data.ptr;
+            
+            if (tag == &listen_tag) {
+                accept_connections(daemon);
+            } else if (tag == &wake_tag) {
+                collect_responses(daemon);
+            } else if (tag == &signal_tag) {
+                struct signalfd_siginfo info;
+                if (read(daemon->signal_fd, &info, sizeof(info)) > 0) {
+                    // Stop accepting; connections already open are cut
+                    // once the requests on the pool are answered
+                    stopping = 1;
+                    epoll_ctl(daemon->epoll_fd, EPOLL_CTL_DEL, daemon->listen_fd, NULL);
+                }
+            } else {
+                // Only a connection's own event closes it, and epoll names
+                // each fd once per wait, so conn is still open here
+                connection_t* conn = tag;
+                if (conn->state == CONN_RESPONSE) {
+                    send_response(conn);
+                } else {
+                    read_request(daemon, conn);
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* socket_path = STEGD_DEFAULT_SOCKET;
+    daemon_t daemon;
+    long workers = 0;
+    sigset_t signals;
+    
+    static struct option long_options[] = {
+        {"socket", required_argument, 0, 's'},
+        {"threads", required_argument, 0, 't'},
+        {"bits", required_argument, 0, 'B'},
+        {"verbose", no_argument, 0, 'v'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    
+    memset(&daemon, 0, sizeof(daemon));
+    
+    int c;
+    while ((c = getopt_long(argc, argv, "s:t:vh", long_options, NULL)) != -1) {
+        switch (c) {
+            case 's':
+                socket_path = optarg;
+                break;
+            case 't': {
+                char* end;
+                workers = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || workers < 0 || workers >= STEG_MAX_THREADS) {
+                    fprintf(stderr, "Error: Threads must be between 0 and %d\n", STEG_MAX_THREADS - 1);
+                    return 1;
+                }
+                break;
+            }
+            case 'B':
+                if (steg_set_bits_per_channel(atoi(optarg)) != STEG_SUCCESS) {
+                    fprintf(stderr, "Error: Bits per channel must be between 1 and 4\n");
+                    return 1;
+                }
+                break;
+            case 'v':
+                daemon.verbose = 1;
+                break;
+            case 'h':
+                print_help();
+                return 0;
+            default:
+                print_help();
+                return 1;
+        }
+    }
+    
+    // Resolve the handlers once instead of per request
+    for (int format = 1; format < STEGD_FORMAT_COUNT; format++) {
+        daemon.handlers[format] = get_format_handler(format_extensions[format]);
+    }
+    
+    // The loop thread is the pool's outside submitter, worker 0; the
+    // workers come on top of it
+    steg_set_threads((int)workers);
+    workers = steg_get_threads();
+    if (workers >= STEG_MAX_THREADS) {
+        workers = STEG_MAX_THREADS - 1;
+    }
+    steg_set_threads((int)workers + 1);
+    
+    // Signals arrive through the loop, never on a worker, so block them
+    // before the pool starts
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    
+    daemon.pool = steg_thread_pool_shared();
+    if (!daemon.pool) {
+        fprintf(stderr, "Error: Could not start the worker threads\n");
+        return 1;
+    }
+    pthread_mutex_init(&daemon.lock, NULL);
+    
+    daemon.listen_fd = open_socket(socket_path);
+    daemon.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    daemon.wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    daemon.signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (daemon.listen_fd < 0 || daemon.epoll_fd < 0 || daemon.wake_fd < 0 || daemon.signal_fd < 0 ||
+        watch(&daemon, EPOLL_CTL_ADD, daemon.listen_fd, EPOLLIN, &listen_tag) != 0 ||
+        watch(&daemon, EPOLL_CTL_ADD, daemon.wake_fd, EPOLLIN, &wake_tag) != 0 ||
+        watch(&daemon, EPOLL_CTL_ADD, daemon.signal_fd, EPOLLIN, &signal_tag) != 0) {
+        if (daemon.listen_fd >= 0) {
+            unlink(socket_path);
+        }
+        fprintf(stderr, "Error: Could not set up the event loop\n");
+        return 1;
+    }
+    
+    printf("stegd: listening on %s with %ld workers (%s)\n", socket_path, workers, get_supported_formats());
+    fflush(stdout);
+    
+    run_loop(&daemon);
+    
+    while (daemon.connections) {
+        close_connection(daemon.connections);
+    }
+    close(daemon.listen_fd);
+    unlink(socket_path);
+    close(daemon.signal_fd);
+    close(daemon.wake_fd);
+    close(daemon.epoll_fd);
+    pthread_mutex_destroy(&daemon.lock);
+    
+    printf("stegd: served %llu requests\n", daemon.served);
+    return 0;
+}
@@ -0,0 +1,287 @@
+/**
+ * @file stegd_protocol.c
+ * @brief LSB Steganography Tool - stegd Daemon Protocol
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * Header encoding shared by the daemon and its clients, and the
+ * blocking client side of a request, with or without passing file
+ * descriptors.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/stegd.h"
+#include "../include/steg.h"
+#include <errno.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Store value as count little-endian bytes
+static void put_le(unsigned char* out, uint64_t value, int count) {
+    for (int i = 0; i < count; i++) {
+        out[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+// Load count little-endian bytes
+static uint64_t get_le(const unsigned char* in, int count) {
+    uint64_t value = 0;
+    for (int i = count - 1; i >= 0; i--) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+// Encode a request header
+void stegd_encode_request(const stegd_request_t* request, unsigned char* out) {
+    memcpy(out, STEGD_MAGIC, 4);
+    out[4] = STEGD_VERSION;
+    out[5] = request->op;
+    out[6] = request->format;
+    out[7] = request->flags;
+    put_le(out + 8, request->image_length, 8);
+    put_le(out + 16, request->payload_length, 8);
+}
+
+// Decode a request header
+int stegd_decode_request(const unsigned char* in, stegd_request_t* request) {
+    if (memcmp(in, STEGD_MAGIC, 4) != 0 || in[4] != STEGD_VERSION) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    
+    request->op = in[5];
+    request->format = in[6];
+    request->flags = in[7];
+    request->image_length = get_le(in + 8, 8);
+    request->payload_length = get_le(in + 16, 8);
+    return STEG_SUCCESS;
+}
+
+// Encode a response header
+void stegd_encode_response(const stegd_response_t* response, unsigned char* out) {
+    memcpy(out, STEGD_MAGIC, 4);
+    out[4] = STEGD_VERSION;
+    out[5] = response->op;
+    out[6] = response->flags;
+    out[7] = 0;
+    put_le(out + 8, (uint32_t)response->status, 4);
+    put_le(out + 12, response->value, 8);
+    put_le(out + 20, response->data_length, 8);
+}
+
+// Decode a response header
+int stegd_decode_response(const unsigned char* in, stegd_response_t* response) {
+    if (memcmp(in, STEGD_MAGIC, 4) != 0 || in[4] != STEGD_VERSION) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    
+    response->op = in[5];
+    response->flags = in[6];
+    response->status = (int32_t)(uint32_t)get_le(in + 8, 4);
+    response->value = get_le(in + 12, 8);
+    response->data_length = get_le(in + 20, 8);
+    return STEG_SUCCESS;
+}
+
+// Protocol format number of a format handler
+int stegd_format_for_name(const char* name) {
+    static const char* names[STEGD_FORMAT_COUNT] = { NULL, "BMP", "PNG", "JPEG" };
+    
+    for (int format = 1; name && format < STEGD_FORMAT_COUNT; format++) {
+        if (strcasecmp(name, names[format]) == 0) {
+            return format;
+        }
+    }
+    return 0;
+}
+
+// Connect to a stegd socket
+int stegd_connect(const char* path) {
+    struct sockaddr_un address;
+    
+    if (!path || strlen(path) >= sizeof(address.sun_path)) {
+        return -1;
+    }
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Send every byte of the vectors, retrying short writes; passed_fd, if
+// not -1, goes with the first bytes. A daemon that hung up yields an
+// error rather than SIGPIPE
+static int send_all(int fd, struct iovec* vectors, int count, int passed_fd) {
+    struct msghdr message;
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    
+    memset(&message, 0, sizeof(message));
+    if (passed_fd >= 0) {
+        memset(&control, 0, sizeof(control));
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &passed_fd, sizeof(int));
+    }
+    
+    while (count > 0) {
+        message.msg_iov = vectors;
+        message.msg_iovlen = count;
+        ssize_t written = sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return STEG_FILE_ERROR;
+        }
+        
+        // The descriptor went with the first bytes
+        message.msg_control = NULL;
+        message.msg_controllen = 0;
+        
+        // Drop the vectors that went out completely
+        while (count > 0 && (size_t)written >= vectors->iov_len) {
+            written -= (ssize_t)vectors->iov_len;
+            vectors++;
+            count--;
+        }
+        if (count > 0) {
+            vectors->iov_base = (char*)vectors->iov_base + written;
+            vectors->iov_len -= (size_t)written;
+        }
+    }
+    return STEG_SUCCESS;
+}
+
+// Read exactly length bytes; a descriptor passed along with them is
+// stored in received_fd when that is not NULL, and closed otherwise
+static int read_all(int fd, unsigned char* buffer, size_t length, int* received_fd) {
+    union {
+        struct cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    
+    while (length > 0) {
+        struct iovec vector = { buffer, length };
+        struct msghdr message;
+        
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &vector;
+        message.msg_iovlen = 1;
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+        
+        ssize_t got = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                int passed;
+                memcpy(&passed, CMSG_DATA(cmsg), sizeof(int));
+                if (received_fd && *received_fd < 0) {
+                    *received_fd = passed;
+                } else {
+                    close(passed);
+                }
+            }
+        }
+        
+        if (got <= 0) {
+            return STEG_FILE_ERROR;
+        }
+        buffer += got;
+        length -= (size_t)got;
+    }
+    return STEG_SUCCESS;
+}
+
+// Send one request and wait for its response
+int stegd_call(int fd, const stegd_request_t* request, const unsigned char* image,
+               const unsigned char* payload, stegd_response_t* response, unsigned char** data) {
+    return stegd_call_fd(fd, request, -1, image, payload, response, data, NULL);
+}
+
+// Send one request, passing and receiving file descriptors
+int stegd_call_fd(int fd, const stegd_request_t* request, int image_fd, const unsigned char* image,
+                  const unsigned char* payload, stegd_response_t* response, unsigned char** data,
+                  int* output_fd) {
+    unsigned char header[STEGD_RESPONSE_SIZE]; // Also holds the smaller request header
+    stegd_request_t sent_request = *request;
+    struct iovec vectors[3];
+    int received_fd = -1;
+    
+    *data = NULL;
+    if (output_fd) {
+        *output_fd = -1;
+    }
+    size_t image_bytes = image_fd >= 0 ? 0 : (size_t)request->image_length;
+    if (request->image_length > SIZE_MAX || request->payload_length > SIZE_MAX ||
+        (request->payload_length > 0 && !payload)) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    
+    sent_request.flags = (uint8_t)((image_fd >= 0 ? STEGD_FLAG_IMAGE_FD : 0) |
+                                   (output_fd ? STEGD_FLAG_OUTPUT_FD : 0));
+    stegd_encode_request(&sent_request, header);
+    vectors[0].iov_base = header;
+    vectors[0].iov_len = STEGD_REQUEST_SIZE;
+    vectors[1].iov_base = (void*)image;
+    vectors[1].iov_len = image_bytes;
+    vectors[2].iov_base = (void*)payload;
+    vectors[2].iov_len = (size_t)request->payload_length;
+    
+    // A request the daemon refuses up front is answered before it hangs
+    // up, so look for the response even when sending fails
+    int sent = send_all(fd, vectors, 3, image_fd);
+    int result = read_all(fd, header, STEGD_RESPONSE_SIZE, &received_fd);
+    if (result == STEG_SUCCESS) {
+        result = stegd_decode_response(header, response);
+    } else if (sent != STEG_SUCCESS) {
+        result = sent;
+    }
+    
+    // The data is either in the memfd that came with the header or follows it
+    if (result == STEG_SUCCESS && (response->flags & STEGD_FLAG_OUTPUT_FD)) {
+        if (received_fd < 0 || !output_fd) {
+            result = STEG_FILE_ERROR;
+        } else {
+            *output_fd = received_fd;
+            received_fd = -1;
+        }
+    } else if (result == STEG_SUCCESS && response->data_length > 0) {
+        *data = response->data_length <= SIZE_MAX ? malloc((size_t)response->data_length) : NULL;
+        result = *data ? read_all(fd, *data, (size_t)response->data_length, NULL) : STEG_MEMORY_ERROR;
+        if (result != STEG_SUCCESS) {
+            free(*data);
+            *data = NULL;
+        }
+    }
+    
+    if (received_fd >= 0) {
+        close(received_fd);
+    }
+    return result;
+}
@@ -0,0 +1,477 @@
+/**
+ * @file thread_pool.c
+ * @brief LSB Steganography Tool - Thread Pool
+ * @author Konstanty Litwinow Jr.
+ * @version 1.1
+ * @date 2025
+ *
+ * pthreads implementation of the work-stealing pool used by batch mode
+ * and the stripe-parallel embed and extract paths.
+ *
+ * Every worker owns a deque. A job pushes its tasks onto the bottom of
+ * the submitting worker's deque; the owner pops from the bottom while
+ * idle workers steal from the top. A worker waiting for its own job
+ * only takes tasks of that job, so it never disappears into an
+ * unrelated image while its stripes are being finished elsewhere.
+ * Once none are left to take it sleeps until the last one finishes.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../include/thread_pool.h"
+#include "../include/steg.h"
+#include <pthread.h>
+#include <time.h>
+
+// Initial number of task slots in each worker's deque
+#define DEQUE_INITIAL_CAPACITY 64
+
+// Tasks of one steg_thread_pool_run() call still to finish; detached
+// tasks from steg_thread_pool_submit() have no group
+typedef struct {
+    size_t pending;
+} task_group_t;
+
+// One queued call of a job's task body
+typedef struct {
+    steg_task_fn fn;
+    void* arg;
+    size_t index;
+    task_group_t* group;
+} steg_task_t;
+
+// A worker's deque and counters. Every thread from outside the pool
+// works as worker 0, so several may update its counters at once: they
+// are only touched atomically
+typedef struct {
+    pthread_mutex_t lock;
+    steg_task_t* tasks;        // Ring buffer
+    size_t capacity;
+    size_t head;               // Top of the deque, where thieves take from
+    size_t count;
+    unsigned long long tasks_run;
+    unsigned long long stolen;
+    unsigned long long busy_ns; // Time spent running tasks, in nanoseconds
+} worker_t;
+
+struct steg_thread_pool {
+    worker_t* workers;
+    pthread_t* thread_ids;
+    int threads;               // Threads per job, including the caller
+    int started;               // Worker threads actually running
+    pthread_mutex_t lock;
+    pthread_cond_t work;       // Signalled when tasks are queued or on shutdown
+    pthread_cond_t done;       // Signalled when the last task of a group finishes
+    size_t queued;             // Tasks sitting in any deque
+    int sleepers;              // Workers waiting on work
+    int shutdown;
+};
+
+// Pool and worker slot of the current thread, and its task nesting depth
+static __thread steg_thread_pool_t* current_pool = NULL;
+static __thread int current_worker = -1;
+static __thread int current_depth = 0;
+
+// Nanoseconds on the monotonic clock
+static unsigned long long now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+}
+
+// Append count tasks to the bottom of a deque
+static int push_tasks(worker_t* worker, steg_task_fn fn, void* arg, size_t count, task_group_t* group) {
+    pthread_mutex_lock(&worker->lock);
+    
+    if (worker->count + count > worker->capacity) {
+        size_t capacity = worker->capacity ? worker->capacity : DEQUE_INITIAL_CAPACITY;
+        while (capacity < worker->count + count) {
+            capacity *= 2;
+        }
+        steg_task_t* tasks = malloc(capacity * sizeof(steg_task_t));
+        if (!tasks) {
+            pthread_mutex_unlock(&worker->lock);
+            return STEG_MEMORY_ERROR;
+        }
+        
+        // Unwrap the ring into the new buffer
+        for (size_t i = 0; i < worker->count; i++) {
+            tasks[i] = worker->tasks[(worker->head + i) % worker->capacity];
+        }
+        free(worker->tasks);
+        worker->tasks = tasks;
+        worker->capacity = capacity;
+        worker->head = 0;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        steg_task_t* task = &worker->tasks[(worker->head + worker->count) % worker->capacity];
+        task->fn = fn;
+        task->arg = arg;
+        task->index = i;
+        task->group = group;
+        worker->count++;
+    }
+    
+    pthread_mutex_unlock(&worker->lock);
+    return STEG_SUCCESS;
+}
+
+// Take a task from the bottom (owner) or top (thief) of a deque,
+// optionally only when it belongs to group
+static int take_task(worker_t* worker, int from_top, const task_group_t* group, steg_task_t* task) {
+    int taken = 0;
+    
+    pthread_mutex_lock(&worker->lock);
+    if (worker->count > 0) {
+        size_t slot = from_top ? worker->head : (worker->head + worker->count - 1) % worker->capacity;
+        if (!group || worker->tasks[slot].group == group) {
+            *task = worker->tasks[slot];
+            if (from_top) {
+                worker->head = (worker->head + 1) % worker->capacity;
+            }
+            worker->count--;
+            taken = 1;
+        }
+    }
+    pthread_mutex_unlock(&worker->lock);
+    
+    return taken;
+}
+
+// Find a task: own deque first, then steal from the others in turn
+static int find_task(steg_thread_pool_t* pool, int self, const task_group_t* group,
+                     steg_task_t* task, int* stolen) {
+    if (take_task(&pool->workers[self], 0, group, task)) {
+        *stolen = 0;
+    } else {
+        int found = 0;
+        for (int i = 1; i < pool->threads && !found; i++) {
+            found = take_task(&pool->workers[(self + i) % pool->threads], 1, group, task);
+        }
+        if (!found) {
+            return 0;
+        }
+        *stolen = 1;
+    }
+    
+    __atomic_sub_fetch(&pool->queued, 1, __ATOMIC_ACQ_REL);
+    return 1;
+}
+
+// Run a task on worker self and account for it
+static void execute_task(steg_thread_pool_t* pool, int self, const steg_task_t* task, int stolen) {
+    worker_t* worker = &pool->workers[self];
+    
+    // Nested tasks run inside a timed one, so only the outermost is timed
+    unsigned long long start = current_depth == 0 ? now_ns() : 0;
+    current_depth++;
+    task->fn(task->arg, task->index);
+    current_depth--;
+    if (current_depth == 0) {
+        __atomic_add_fetch(&worker->busy_ns, now_ns() - start, __ATOMIC_RELAXED);
+    }
+    
+    __atomic_add_fetch(&worker->tasks_run, 1, __ATOMIC_RELAXED);
+    if (stolen) {
+        __atomic_add_fetch(&worker->stolen, 1, __ATOMIC_RELAXED);
+    }
+    
+    // The group lives on its waiter's stack: once pending reaches zero
+    // only the pool may be touched
+    if (task->group && __atomic_sub_fetch(&task->group->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_broadcast(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+// Worker thread: run and steal tasks, sleep when there are none
+static void* worker_main(void* data) {
+    steg_thread_pool_t* pool = data;
+    int self;
+    
+    pthread_mutex_lock(&pool->lock);
+    self = ++pool->started;
+    pthread_mutex_unlock(&pool->lock);
+    
+    current_pool = pool;
+    current_worker = self;
+    
+    for (;;) {
+        steg_task_t task;
+        int stolen;
+        
+        if (find_task(pool, self, NULL, &task, &stolen)) {
+            execute_task(pool, self, &task, stolen);
+            continue;
+        }
+        
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->shutdown && __atomic_load_n(&pool->queued, __ATOMIC_ACQUIRE) == 0) {
+            pool->sleepers++;
+            pthread_cond_wait(&pool->work, &pool->lock);
+            pool->sleepers--;
+        }
+        int shutdown = pool->shutdown;
+        pthread_mutex_unlock(&pool->lock);
+        
+        if (shutdown) {
+            break;
+        }
+    }
+    
+    return NULL;
+}
+
+// Create a thread pool
+steg_thread_pool_t* steg_thread_pool_create(int threads) {
+    if (threads < 1 || threads > STEG_MAX_THREADS) {
+        return NULL;
+    }
+    
+    steg_thread_pool_t* pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        return NULL;
+    }
+    
+    pool->threads = threads;
+    pool->workers = calloc((size_t)threads, sizeof(worker_t));
+    pool->thread_ids = calloc((size_t)threads, sizeof(pthread_t));
+    if (!pool->workers || !pool->thread_ids) {
+        free(pool->workers);
+        free(pool->thread_ids);
+        free(pool);
+        return NULL;
+    }
+    
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_init(&pool->workers[i].lock, NULL);
+    }
+    
+    // The caller is worker 0; start the rest
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&pool->thread_ids[i - 1], NULL, worker_main, pool) != 0) {
+            // Join only the threads that were created
+            pool->threads = i;
+            steg_thread_pool_destroy(pool);
+            return NULL;
+        }
+    }
+    
+    return pool;
+}
+
+// Stop the workers and free the pool
+void steg_thread_pool_destroy(steg_thread_pool_t* pool) {
+    if (!pool) {
+        return;
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    
+    for (int i = 0; i < pool->threads - 1; i++) {
+        pthread_join(pool->thread_ids[i], NULL);
+    }
+    
+    for (int i = 0; i < pool->threads; i++) {
+        pthread_mutex_destroy(&pool->workers[i].lock);
+        free(pool->workers[i].tasks);
+    }
+    pthread_cond_destroy(&pool->work);
+    pthread_cond_destroy(&pool->done);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->thread_ids);
+    free(pool->workers);
+    free(pool);
+}
+
+// Number of threads working on a job, including the caller
+int steg_thread_pool_threads(const steg_thread_pool_t* pool) {
+    return pool ? pool->threads : 1;
+}
+
+// Run fn(arg, index) for every index in [0, tasks) and wait
+void steg_thread_pool_run(steg_thread_pool_t* pool, size_t tasks, steg_task_fn fn, void* arg) {
+    task_group_t group;
+    
+    // Nothing to share: run inline without touching the deques
+    if (!pool || pool->threads == 1 || tasks <= 1) {
+        for (size_t i = 0; i < tasks; i++) {
+            fn(arg, i);
+        }
+        return;
+    }
+    
+    // A thread from outside the pool takes the caller's slot, worker 0
+    steg_thread_pool_t* outer_pool = current_pool;
+    int outer_worker = current_worker;
+    int external = current_pool != pool;
+    if (external) {
+        current_pool = pool;
+        current_worker = 0;
+    }
+    int self = current_worker;
+    
+    group.pending = tasks;
+    if (push_tasks(&pool->workers[self], fn, arg, tasks, &group) != STEG_SUCCESS) {
+        // No room to queue the job: run it here
+        for (size_t i = 0; i < tasks; i++) {
+            fn(arg, i);
+        }
+    } else {
+        __atomic_add_fetch(&pool->queued, tasks, __ATOMIC_ACQ_REL);
+        pthread_mutex_lock(&pool->lock);
+        if (pool->sleepers > 0) {
+            pthread_cond_broadcast(&pool->work);
+        }
+        pthread_mutex_unlock(&pool->lock);
+        
+        // Help until the job is done. A worker inside a task only takes
+        // tasks of this job; the outside caller may take anything
+        const task_group_t* filter = external ? NULL : &group;
+        while (__atomic_load_n(&group.pending, __ATOMIC_ACQUIRE) > 0) {
+            steg_task_t task;
+            int stolen;
+            if (find_task(pool, self, filter, &task, &stolen)) {
+                execute_task(pool, self, &task, stolen);
+                continue;
+            }
+            
+            // Every task of the job is queued up front, so none left to
+            // take means the rest are running: sleep until they finish
+            pthread_mutex_lock(&pool->lock);
+            while (__atomic_load_n(&group.pending, __ATOMIC_ACQUIRE) > 0) {
+                pthread_cond_wait(&pool->done, &pool->lock);
+            }
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+    
+    if (external) {
+        current_pool = outer_pool;
+        current_worker = outer_worker;
+    }
+}
+
+// Queue fn(arg, 0) for the workers and return at once
+int steg_thread_pool_submit(steg_thread_pool_t* pool, steg_task_fn fn, void* arg) {
+    if (!pool || pool->threads == 1 || !fn) {
+        return STEG_INVALID_ARGUMENT;
+    }
+    
+    // Queued on worker 0's deque, which the outside submitter owns; the
+    // workers find it there when they steal
+    int result = push_tasks(&pool->workers[0], fn, arg, 1, NULL);
+    if (result != STEG_SUCCESS) {
+        return result;
+    }
+    
+    __atomic_add_fetch(&pool->queued, 1, __ATOMIC_ACQ_REL);
+    pthread_mutex_lock(&pool->lock);
+    if (pool->sleepers > 0) {
+        pthread_cond_signal(&pool->work);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return STEG_SUCCESS;
+}
+
+// Copy the per-worker counters
+int steg_thread_pool_stats(const steg_thread_pool_t* pool, steg_worker_stats_t* stats, int max) {
+    int count = 0;
+    
+    for (; pool && count < pool->threads && count < max; count++) {
+        const worker_t* worker = &pool->workers[count];
+        stats[count].tasks = __atomic_load_n(&worker->tasks_run, __ATOMIC_RELAXED);
+        stats[count].stolen = __atomic_load_n(&worker->stolen, __ATOMIC_RELAXED);
+        stats[count].busy_seconds = __atomic_load_n(&worker->busy_ns, __ATOMIC_RELAXED) / 1e9;
+    }
+    return count;
+}
+
+// Zero the per-worker counters
+void steg_thread_pool_reset_stats(steg_thread_pool_t* pool) {
+    for (int i = 0; pool && i < pool->threads; i++) {
+        __atomic_store_n(&pool->workers[i].tasks_run, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&pool->workers[i].stolen, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&pool->workers[i].busy_ns, 0, __ATOMIC_RELAXED);
+    }
+}
+
+// Index of the worker the calling thread is running a task as
+int steg_thread_pool_current_worker(void) {
+    return current_worker;
+}
+
+// Pool shared by the engine, the thread count it was built for, and
+// the pools it replaced. Callers may still be running jobs on a
+// replaced pool, so those are only destroyed at exit
+typedef struct retired_pool {
+    steg_thread_pool_t* pool;
+    struct retired_pool* next;
+} retired_pool_t;
+
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static steg_thread_pool_t* shared_pool = NULL;
+static int shared_threads = 1;
+static retired_pool_t* retired_pools = NULL;
+
+// Release the shared pool and every pool it replaced at exit
+static void release_shared_pool(void) {
+    pthread_mutex_lock(&shared_lock);
+    steg_thread_pool_destroy(shared_pool);
+    shared_pool = NULL;
+    shared_threads = 1;
+    while (retired_pools) {
+        retired_pool_t* retired = retired_pools;
+        retired_pools = retired->next;
+        steg_thread_pool_destroy(retired->pool);
+        free(retired);
+    }
+    pthread_mutex_unlock(&shared_lock);
+}
+
+// Process-wide pool sized by steg_get_threads()
+steg_thread_pool_t* steg_thread_pool_shared(void) {
+    static int registered = 0;
+    int threads = steg_get_threads();
+    
+    if (threads <= 1) {
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&shared_lock);
+    if (!shared_pool || shared_threads != threads) {
+        steg_thread_pool_t* pool = steg_thread_pool_create(threads);
+        retired_pool_t* retired = shared_pool ? malloc(sizeof(*retired)) : NULL;
+        
+        if (pool && shared_pool && !retired) {
+            // Nowhere to park the old pool: keep using it
+            steg_thread_pool_destroy(pool);
+        } else if (pool) {
+            if (retired) {
+                retired->pool = shared_pool;
+                retired->next = retired_pools;
+                retired_pools = retired;
+            }
+            shared_pool = pool;
+            shared_threads = threads;
+        } else {
+            free(retired);
+        }
+        
+        if (!registered) {
+            atexit(release_shared_pool);
+            registered = 1;
+        }
+    }
+    steg_thread_pool_t* pool = shared_pool;
+    pthread_mutex_unlock(&shared_lock);
+    return pool;
+}